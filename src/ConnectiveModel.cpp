@@ -26,6 +26,7 @@
 #include "SearchStep.h"
 #include "ConnectiveModel.h"
 
+#include <boost/cast.hpp>
 #include <boost/regex.hpp>
 
 #include <iostream>
@@ -336,7 +337,7 @@ void ConnectiveModel::computeSentenceScores(const DocumentState &doc,uint sentno
 
 FeatureFunction::StateModifications *ConnectiveModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																			 Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const ConnectiveModelState *prevstate = dynamic_cast<const ConnectiveModelState *>(state);
+	const ConnectiveModelState *prevstate = boost::polymorphic_downcast<const ConnectiveModelState *>(state);
 	ConnectiveModelState *s = prevstate->clone();
 
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
@@ -355,8 +356,8 @@ FeatureFunction::StateModifications *ConnectiveModel::updateScore(const Document
 }
 
 FeatureFunction::State *ConnectiveModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	ConnectiveModelState *os = dynamic_cast<ConnectiveModelState *>(oldState);
-	ConnectiveModelState *ms = dynamic_cast<ConnectiveModelState *>(modif);
+	ConnectiveModelState *os = boost::polymorphic_downcast<ConnectiveModelState *>(oldState);
+	ConnectiveModelState *ms = boost::polymorphic_downcast<ConnectiveModelState *>(modif);
 	os->s2t.swap(ms->s2t);
 	os->t2s.swap(ms->t2s);
 	os->fin = ms->fin;
@@ -26,8 +26,9 @@
 #include "SearchStep.h"
 #include "ConsistencyQModelPhrase.h"
 
-#include <boost/lambda/lambda.hpp>
+#include <boost/cast.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/lambda/lambda.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <iostream>
@@ -183,26 +184,21 @@ void ConsistencyQModelPhrase::computeSentenceScores(const DocumentState &doc, ui
 
 FeatureFunction::StateModifications *ConsistencyQModelPhrase::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																				  Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const ConsistencyQModelPhraseState *prevstate = dynamic_cast<const ConsistencyQModelPhraseState *>(state);
+	const ConsistencyQModelPhraseState *prevstate = boost::polymorphic_downcast<const ConsistencyQModelPhraseState *>(state);
 	ConsistencyQModelPhraseState *s = prevstate->clone();
 
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
 	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		PhraseSegmentation::const_iterator from_it = it->from_it;
+		PhraseSegmentation::const_iterator to_it = it->to_it;
+	
+		for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
+			s->removePhrasePair(*pit);	  
+		}
 
-		// Do Nothing if it is a swap, since that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
- 
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
-		}	
+		BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
+			s->addPhrasePair(app);
+		}
 	}	
  
 	*sbegin = s->score();
@@ -215,8 +211,8 @@ FeatureFunction::StateModifications *ConsistencyQModelPhrase::updateScore(const
 }
 
 FeatureFunction::State *ConsistencyQModelPhrase::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	ConsistencyQModelPhraseState *os = dynamic_cast<ConsistencyQModelPhraseState *>(oldState);
-	ConsistencyQModelPhraseState *ms = dynamic_cast<ConsistencyQModelPhraseState *>(modif);
+	ConsistencyQModelPhraseState *os = boost::polymorphic_downcast<ConsistencyQModelPhraseState *>(oldState);
+	ConsistencyQModelPhraseState *ms = boost::polymorphic_downcast<ConsistencyQModelPhraseState *>(modif);
 
 	os->s2t.swap(ms->s2t);
 	os->t2s.swap(ms->t2s);
@@ -26,8 +26,9 @@
 #include "SearchStep.h"
 #include "ConsistencyQModelWord.h"
 
-#include <boost/lambda/lambda.hpp>
+#include <boost/cast.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/lambda/lambda.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <iostream>
@@ -196,25 +197,21 @@ void ConsistencyQModelWord::computeSentenceScores(const DocumentState &doc, uint
 
 FeatureFunction::StateModifications *ConsistencyQModelWord::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																				Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const ConsistencyQModelWordState *prevstate = dynamic_cast<const ConsistencyQModelWordState *>(state);
+	const ConsistencyQModelWordState *prevstate = boost::polymorphic_downcast<const ConsistencyQModelWordState *>(state);
 	ConsistencyQModelWordState *s = prevstate->clone();
 
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
 	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		PhraseSegmentation::const_iterator from_it = it->from_it;
+		PhraseSegmentation::const_iterator to_it = it->to_it;
+	
+		for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
+			s->removePhrasePair(*pit);	  
+		}
 
-		// Do Nothing if it is a swap,s ince that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
-		}	
+		BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
+			s->addPhrasePair(app);
+		}
 	}
 	
 	*sbegin = s->score();
@@ -227,8 +224,8 @@ FeatureFunction::StateModifications *ConsistencyQModelWord::updateScore(const Do
 }
 
 FeatureFunction::State *ConsistencyQModelWord::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	ConsistencyQModelWordState *os = dynamic_cast<ConsistencyQModelWordState *>(oldState);
-	ConsistencyQModelWordState *ms = dynamic_cast<ConsistencyQModelWordState *>(modif);
+	ConsistencyQModelWordState *os = boost::polymorphic_downcast<ConsistencyQModelWordState *>(oldState);
+	ConsistencyQModelWordState *ms = boost::polymorphic_downcast<ConsistencyQModelWordState *>(modif);
 
 	os->s2t.swap(ms->s2t);
 	os->t2s.swap(ms->t2s);
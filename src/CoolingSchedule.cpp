@@ -24,14 +24,17 @@
 
 #include "CoolingSchedule.h"
 #include "DecoderConfiguration.h"
+#include "ProposalCache.h"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <numeric>
+#include <sstream>
 
 #include <boost/lambda/lambda.hpp>
 
-CoolingSchedule *CoolingSchedule::createCoolingSchedule(const Parameters &params) {
+CoolingSchedule *CoolingSchedule::createCoolingSchedule(const Parameters &params, uint inputWords) {
 	std::string s_schedule = params.get<std::string>("schedule");
 
 	CoolingSchedule *schedule;
@@ -41,13 +44,86 @@ CoolingSchedule *CoolingSchedule::createCoolingSchedule(const Parameters &params
 	else if(s_schedule == "aarts-laarhoven")
 		schedule = new AartsLaarhovenSchedule(params);
 	else if(s_schedule == "hill-climbing")
-		schedule = new HillclimbingSchedule(params);
+		schedule = new HillclimbingSchedule(params, inputWords);
 	else
 		BOOST_THROW_EXCEPTION(ConfigurationException());
 
 	return schedule;
 }
 
+const uint HillclimbingSchedule::EXHAUSTION_REJECTIONS_PER_WORD;
+
+HillclimbingSchedule::HillclimbingSchedule(const Parameters &params, uint inputWords)
+		: logger_("HillclimbingSchedule"), rejectionCounter_(0), singletons_(0) {
+	std::string termination = params.get<std::string>("hill-climbing:termination", "rejections");
+	if(termination == "rejections")
+		exhaustion_ = false;
+	else if(termination == "exhaustion")
+		exhaustion_ = true;
+	else {
+		LOG(logger_, error, "Unknown hill-climbing termination criterion: " << termination);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	uint defaultMaxRejected = 1000;
+	if(exhaustion_)
+		defaultMaxRejected = std::max(defaultMaxRejected, EXHAUSTION_REJECTIONS_PER_WORD * inputWords);
+	maxRejected_ = params.get<uint>("hill-climbing:max-rejected", defaultMaxRejected);
+	minRejected_ = params.get<uint>("hill-climbing:min-rejected", 100);
+	unseenMass_ = params.get<Float>("hill-climbing:unseen-mass", .01);
+}
+
+bool HillclimbingSchedule::isDone() const {
+	if(rejectionCounter_ > maxRejected_)
+		return true;
+
+	if(!exhaustion_ || rejectionCounter_ < minRejected_)
+		return false;
+
+	return singletons_ < unseenMass_ * rejectionCounter_;
+}
+
+void HillclimbingSchedule::step(Float score, bool accept) {
+	if(accept) {
+		rejectionCounter_ = 0;
+		proposalCounts_.clear();
+		singletons_ = 0;
+	} else
+		rejectionCounter_++;
+}
+
+void HillclimbingSchedule::step(const SearchStep &searchStep, Float score, bool accept) {
+	if(exhaustion_)
+		step(ProposalCache::computeHash(searchStep), score, accept);
+	else
+		step(score, accept);
+}
+
+void HillclimbingSchedule::step(std::size_t proposalHash, Float score, bool accept) {
+	step(score, accept);
+
+	if(!exhaustion_ || accept)
+		return;
+
+	uint &count = proposalCounts_[proposalHash];
+	if(count == 0)
+		singletons_++;
+	else if(count == 1)
+		singletons_--;
+	count++;
+}
+
+const Float GeometricDecaySchedule::LOG_FINAL_TEMPERATURE = -30;
+
+// The schedule is never stretched, only compressed.
+void GeometricDecaySchedule::setRemainingSteps(Float steps) {
+	Float remaining = (LOG_FINAL_TEMPERATURE - logStartTemperature_) / logDecayFactor_ - step_;
+	if(steps >= remaining || steps <= 0)
+		stepSize_ = 1;
+	else
+		stepSize_ = remaining / steps;
+}
+
 AartsLaarhovenSchedule::AartsLaarhovenSchedule(const Parameters &params)
 	: logger_("AartsLaarhovenSchedule"),
 	  m1_(0), m2_(0), scoreDecrease_(.0), stepsInChain_(0),
@@ -76,9 +152,11 @@ bool AartsLaarhovenSchedule::isDone() const {
 	LOG(logger_, debug, "isDone: T = " << temperature_ <<
 		"; mu1 = " << mu1_ << "; Tlast = " << lastTemperature_);
 
-	if(logger_.loggable(debug))
-		std::copy(muBuffer_.begin(), muBuffer_.end(),
-			std::ostream_iterator<Float>(logger_.getLogStream(), " "));
+	if(logger_.loggable(debug)) {
+		std::ostringstream os;
+		std::copy(muBuffer_.begin(), muBuffer_.end(), std::ostream_iterator<Float>(os, " "));
+		LOG(logger_, debug, os.str());
+	}
 
 	Float q = temperature_ / mu1_ * ((muBuffer_.front() - muBuffer_.back()) / (muBuffer_.size() - 1)) / (lastTemperature_ - temperature_);
 	LOG(logger_, debug, "q = " << q);
@@ -127,9 +205,11 @@ void AartsLaarhovenSchedule::adaptInitialTemperature(Float score) {
 void AartsLaarhovenSchedule::startNextChain() {
 	using namespace boost::lambda;
 	LOG(logger_, debug, "chainScores:");
-	if(logger_.loggable(debug))
-		std::copy(chainCosts_.begin(), chainCosts_.end(),
-			std::ostream_iterator<Float>(logger_.getLogStream(), " "));
+	if(logger_.loggable(debug)) {
+		std::ostringstream os;
+		std::copy(chainCosts_.begin(), chainCosts_.end(), std::ostream_iterator<Float>(os, " "));
+		LOG(logger_, debug, os.str());
+	}
 
 	Float mu = std::accumulate(chainCosts_.begin(), chainCosts_.end(), static_cast<Float>(0)) / chainCosts_.size();
 	Float sigma_sq = std::accumulate(chainCosts_.begin(), chainCosts_.end(), static_cast<Float>(0), _1 + (_2 - mu) * (_2 - mu)) / chainCosts_.size();
@@ -27,6 +27,9 @@
 #include "DecoderConfiguration.h"
 
 #include <boost/circular_buffer.hpp>
+#include <boost/unordered_map.hpp>
+
+class SearchStep;
 
 class CoolingSchedule {
 public:
@@ -36,44 +39,70 @@ public:
 	virtual bool isDone() const = 0;
 	virtual void step(Float score, bool accept) = 0;
 
-	static CoolingSchedule *createCoolingSchedule(const Parameters &type);
+	// Schedules that need to look at the proposals themselves can override this.
+	virtual void step(const SearchStep &searchStep, Float score, bool accept) {
+		step(score, accept);
+	}
+
+	// Tells the schedule how many more steps can be taken before a time limit
+	// hits, so that it can compress itself to finish in time.
+	virtual void setRemainingSteps(Float steps) {}
+
+	// inputWords is the length of the document to be searched
+	static CoolingSchedule *createCoolingSchedule(const Parameters &type, uint inputWords);
 };
 
+// By default, hill climbing stops after hill-climbing:max-rejected consecutive
+// rejections. With hill-climbing:termination=exhaustion, it stops as soon as
+// the proposals rejected since the last acceptance cover most of the
+// neighbourhood of the current state. The probability mass of proposals that
+// haven't been seen yet is estimated with the Good-Turing estimator (the
+// proportion of proposals seen exactly once) and compared to
+// hill-climbing:unseen-mass. max-rejected then only serves as a safety limit.
+// Since the neighbourhood grows with the document, its default scales with
+// the number of input words.
 class HillclimbingSchedule : public CoolingSchedule {
 private:
+	static const uint EXHAUSTION_REJECTIONS_PER_WORD = 20;
+
+	Logger logger_;
+
 	uint maxRejected_;
 	uint rejectionCounter_;
+
+	bool exhaustion_;
+	uint minRejected_;
+	Float unseenMass_;
+	boost::unordered_map<std::size_t,uint> proposalCounts_;
+	uint singletons_;
 	
 public:
-	HillclimbingSchedule(const Parameters &params) : rejectionCounter_(0) {
-		maxRejected_ = params.get<uint>("hill-climbing:max-rejected", 1000);
-	}
+	HillclimbingSchedule(const Parameters &params, uint inputWords);
 
 	virtual Float getTemperature() const {
 		return 1e-10;
 	}
 	
-	virtual bool isDone() const {
-		return rejectionCounter_ > maxRejected_;
-	}
-	
-	virtual void step(Float score, bool accept) {
-		if(accept)
-			rejectionCounter_ = 0;
-		else
-			rejectionCounter_++;
-	}
+	virtual bool isDone() const;
+	virtual void step(Float score, bool accept);
+	virtual void step(const SearchStep &searchStep, Float score, bool accept);
+	// same as above for a proposal with the given hash
+	void step(std::size_t proposalHash, Float score, bool accept);
 };
 
 class GeometricDecaySchedule : public CoolingSchedule {
 private:
-	uint step_;
+	// number of decay steps taken so far; fractional when the schedule is compressed
+	Float step_;
+	Float stepSize_;
 	Float logStartTemperature_;
 	Float logDecayFactor_;
 	bool stepOnAcceptance_;
 
+	static const Float LOG_FINAL_TEMPERATURE;
+
 public:
-	GeometricDecaySchedule(const Parameters &params) : step_(0) {
+	GeometricDecaySchedule(const Parameters &params) : step_(0), stepSize_(1) {
 		logStartTemperature_ = log(params.get<Float>("geometric-decay:start-temperature"));
 		logDecayFactor_ = log(params.get<Float>("geometric-decay:decay-factor"));
 		stepOnAcceptance_ = params.get<bool>("geometric-decay:step-on-acceptance", false);
@@ -84,13 +113,15 @@ public:
 	}
 
 	virtual bool isDone() const {
-		return logStartTemperature_ + step_ * logDecayFactor_ < -30;
+		return logStartTemperature_ + step_ * logDecayFactor_ < LOG_FINAL_TEMPERATURE;
 	}
 	
 	virtual void step(Float score, bool accept) {
 		if(accept || !stepOnAcceptance_)
-			step_++;
+			step_ += stepSize_;
 	}
+
+	virtual void setRemainingSteps(Float steps);
 };
 
 class AartsLaarhovenSchedule : public CoolingSchedule {
@@ -0,0 +1,367 @@
+/*
+ *  CoverageBitmap.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_CoverageBitmap_h
+#define docent_CoverageBitmap_h
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <iostream>
+
+#include <boost/functional/hash.hpp>
+
+// A bitmap of source positions. It has the interface of the subset of
+// boost::dynamic_bitset used by the decoder, but stores bitmaps of up to
+// INLINE_BITS bits inline, so copying a phrase pair or a segmentation doesn't
+// allocate for all but the longest sentences. The bit layout within blocks
+// is the same as that of dynamic_bitset.
+class CoverageBitmap {
+public:
+	typedef unsigned long block_type;
+	typedef std::size_t size_type;
+
+	static const size_type npos = static_cast<size_type>(-1);
+	static const size_type BITS_PER_BLOCK = sizeof(block_type) * CHAR_BIT;
+	static const size_type INLINE_BLOCKS = 4;
+	static const size_type INLINE_BITS = INLINE_BLOCKS * BITS_PER_BLOCK;
+
+private:
+	size_type size_;
+	block_type *blocks_;
+	block_type inline_[INLINE_BLOCKS];
+
+	static size_type calcNumBlocks(size_type size) {
+		return (size + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+	}
+
+	static size_type blockIndex(size_type pos) {
+		return pos / BITS_PER_BLOCK;
+	}
+
+	static block_type bitMask(size_type pos) {
+		return block_type(1) << (pos % BITS_PER_BLOCK);
+	}
+
+	static size_type lowestBit(block_type b) {
+		return __builtin_ctzl(b);
+	}
+
+	static size_type highestBit(block_type b) {
+		return BITS_PER_BLOCK - 1 - __builtin_clzl(b);
+	}
+
+	void allocate(size_type size) {
+		size_ = size;
+		blocks_ = calcNumBlocks(size) > INLINE_BLOCKS ? new block_type[calcNumBlocks(size)] : inline_;
+	}
+
+	void release() {
+		if(blocks_ != inline_)
+			delete[] blocks_;
+	}
+
+	// clears the unused bits of the last block after operations that set them
+	void trim() {
+		size_type extra = size_ % BITS_PER_BLOCK;
+		if(extra != 0)
+			blocks_[num_blocks() - 1] &= (block_type(1) << extra) - 1;
+	}
+
+	size_type findFrom(size_type blk) const {
+		size_type nb = num_blocks();
+		for(; blk < nb; blk++)
+			if(blocks_[blk] != 0)
+				return blk * BITS_PER_BLOCK + lowestBit(blocks_[blk]);
+		return npos;
+	}
+
+public:
+	explicit CoverageBitmap(size_type size = 0) {
+		allocate(size);
+		std::fill(blocks_, blocks_ + num_blocks(), block_type(0));
+	}
+
+	CoverageBitmap(const CoverageBitmap &o) {
+		allocate(o.size_);
+		std::copy(o.blocks_, o.blocks_ + num_blocks(), blocks_);
+	}
+
+	~CoverageBitmap() {
+		release();
+	}
+
+	CoverageBitmap &operator=(const CoverageBitmap &o) {
+		if(&o == this)
+			return *this;
+		if(calcNumBlocks(o.size_) != num_blocks()) {
+			release();
+			allocate(o.size_);
+		} else
+			size_ = o.size_;
+		std::copy(o.blocks_, o.blocks_ + num_blocks(), blocks_);
+		return *this;
+	}
+
+	void swap(CoverageBitmap &o) {
+		CoverageBitmap tmp(*this);
+		*this = o;
+		o = tmp;
+	}
+
+	size_type size() const {
+		return size_;
+	}
+
+	size_type num_blocks() const {
+		return calcNumBlocks(size_);
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	void resize(size_type size, bool value = false) {
+		CoverageBitmap n(size);
+		size_type common = std::min(num_blocks(), n.num_blocks());
+		std::copy(blocks_, blocks_ + common, n.blocks_);
+		if(value) {
+			for(size_type i = size_; i < size; i++)
+				n.set(i);
+		}
+		n.trim();
+		swap(n);
+	}
+
+	bool test(size_type pos) const {
+		assert(pos < size_);
+		return (blocks_[blockIndex(pos)] & bitMask(pos)) != 0;
+	}
+
+	bool operator[](size_type pos) const {
+		return test(pos);
+	}
+
+	CoverageBitmap &set(size_type pos, bool value = true) {
+		assert(pos < size_);
+		if(value)
+			blocks_[blockIndex(pos)] |= bitMask(pos);
+		else
+			blocks_[blockIndex(pos)] &= ~bitMask(pos);
+		return *this;
+	}
+
+	CoverageBitmap &set() {
+		std::fill(blocks_, blocks_ + num_blocks(), ~block_type(0));
+		trim();
+		return *this;
+	}
+
+	CoverageBitmap &reset(size_type pos) {
+		return set(pos, false);
+	}
+
+	CoverageBitmap &reset() {
+		std::fill(blocks_, blocks_ + num_blocks(), block_type(0));
+		return *this;
+	}
+
+	CoverageBitmap &flip(size_type pos) {
+		assert(pos < size_);
+		blocks_[blockIndex(pos)] ^= bitMask(pos);
+		return *this;
+	}
+
+	CoverageBitmap &flip() {
+		for(size_type i = 0; i < num_blocks(); i++)
+			blocks_[i] = ~blocks_[i];
+		trim();
+		return *this;
+	}
+
+	size_type count() const {
+		size_type n = 0;
+		for(size_type i = 0; i < num_blocks(); i++)
+			n += __builtin_popcountl(blocks_[i]);
+		return n;
+	}
+
+	bool any() const {
+		for(size_type i = 0; i < num_blocks(); i++)
+			if(blocks_[i] != 0)
+				return true;
+		return false;
+	}
+
+	bool none() const {
+		return !any();
+	}
+
+	size_type find_first() const {
+		return findFrom(0);
+	}
+
+	size_type find_next(size_type pos) const {
+		if(pos == npos || ++pos >= size_)
+			return npos;
+		size_type blk = blockIndex(pos);
+		block_type rest = blocks_[blk] & ~(bitMask(pos) - 1);
+		if(rest != 0)
+			return blk * BITS_PER_BLOCK + lowestBit(rest);
+		return findFrom(blk + 1);
+	}
+
+	// not part of the dynamic_bitset interface
+	size_type find_last() const {
+		for(size_type blk = num_blocks(); blk > 0; blk--)
+			if(blocks_[blk - 1] != 0)
+				return (blk - 1) * BITS_PER_BLOCK + highestBit(blocks_[blk - 1]);
+		return npos;
+	}
+
+	bool is_subset_of(const CoverageBitmap &o) const {
+		assert(size_ == o.size_);
+		for(size_type i = 0; i < num_blocks(); i++)
+			if(blocks_[i] & ~o.blocks_[i])
+				return false;
+		return true;
+	}
+
+	bool intersects(const CoverageBitmap &o) const {
+		size_type nb = std::min(num_blocks(), o.num_blocks());
+		for(size_type i = 0; i < nb; i++)
+			if(blocks_[i] & o.blocks_[i])
+				return true;
+		return false;
+	}
+
+	CoverageBitmap &operator&=(const CoverageBitmap &o) {
+		assert(size_ == o.size_);
+		for(size_type i = 0; i < num_blocks(); i++)
+			blocks_[i] &= o.blocks_[i];
+		return *this;
+	}
+
+	CoverageBitmap &operator|=(const CoverageBitmap &o) {
+		assert(size_ == o.size_);
+		for(size_type i = 0; i < num_blocks(); i++)
+			blocks_[i] |= o.blocks_[i];
+		return *this;
+	}
+
+	CoverageBitmap &operator^=(const CoverageBitmap &o) {
+		assert(size_ == o.size_);
+		for(size_type i = 0; i < num_blocks(); i++)
+			blocks_[i] ^= o.blocks_[i];
+		return *this;
+	}
+
+	CoverageBitmap &operator-=(const CoverageBitmap &o) {
+		assert(size_ == o.size_);
+		for(size_type i = 0; i < num_blocks(); i++)
+			blocks_[i] &= ~o.blocks_[i];
+		return *this;
+	}
+
+	CoverageBitmap operator~() const {
+		CoverageBitmap r(*this);
+		return r.flip();
+	}
+
+	bool operator==(const CoverageBitmap &o) const {
+		return size_ == o.size_ && std::equal(blocks_, blocks_ + num_blocks(), o.blocks_);
+	}
+
+	bool operator!=(const CoverageBitmap &o) const {
+		return !(*this == o);
+	}
+
+	// orders by size, then by the numerical value of the bits
+	bool operator<(const CoverageBitmap &o) const {
+		if(size_ != o.size_)
+			return size_ < o.size_;
+		for(size_type i = num_blocks(); i > 0; i--)
+			if(blocks_[i - 1] != o.blocks_[i - 1])
+				return blocks_[i - 1] < o.blocks_[i - 1];
+		return false;
+	}
+
+	bool operator>(const CoverageBitmap &o) const {
+		return o < *this;
+	}
+
+	bool operator<=(const CoverageBitmap &o) const {
+		return !(o < *this);
+	}
+
+	bool operator>=(const CoverageBitmap &o) const {
+		return !(*this < o);
+	}
+
+	template<class BlockOutputIterator>
+	void copyBlocks(BlockOutputIterator out) const {
+		std::copy(blocks_, blocks_ + num_blocks(), out);
+	}
+
+	template<class BlockInputIterator>
+	void assignBlocks(BlockInputIterator first, BlockInputIterator last) {
+		size_type nb = std::min<size_type>(num_blocks(), std::distance(first, last));
+		std::copy(first, first + nb, blocks_);
+		trim();
+	}
+
+	friend std::size_t hash_value(const CoverageBitmap &bm) {
+		std::size_t seed = bm.size_;
+		boost::hash_range(seed, bm.blocks_, bm.blocks_ + bm.num_blocks());
+		return seed;
+	}
+};
+
+inline CoverageBitmap operator&(const CoverageBitmap &a, const CoverageBitmap &b) {
+	CoverageBitmap r(a);
+	return r &= b;
+}
+
+inline CoverageBitmap operator|(const CoverageBitmap &a, const CoverageBitmap &b) {
+	CoverageBitmap r(a);
+	return r |= b;
+}
+
+inline CoverageBitmap operator^(const CoverageBitmap &a, const CoverageBitmap &b) {
+	CoverageBitmap r(a);
+	return r ^= b;
+}
+
+inline CoverageBitmap operator-(const CoverageBitmap &a, const CoverageBitmap &b) {
+	CoverageBitmap r(a);
+	return r -= b;
+}
+
+// most significant bit first, like dynamic_bitset
+inline std::ostream &operator<<(std::ostream &os, const CoverageBitmap &bm) {
+	for(CoverageBitmap::size_type i = bm.size(); i > 0; i--)
+		os << (bm.test(i - 1) ? '1' : '0');
+	return os;
+}
+
+#endif
@@ -22,11 +22,15 @@
 
 #include "Docent.h"
 #include "DecoderConfiguration.h"
+#include "FeatureFunction.h"
+#include "FeaturePipeline.h"
 #include "PhraseTable.h"
 #include "Random.h"
 #include "SearchAlgorithm.h"
 #include "StateGenerator.h"
 
+#include <algorithm>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <map>
@@ -35,6 +39,7 @@
 
 #include <boost/dynamic_bitset.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <DOM/SAX2DOM/SAX2DOM.hpp>
 #include <SAX/helpers/CatchErrorHandler.hpp>
@@ -99,7 +104,8 @@ Arabica::DOM::Document<std::string> ConfigurationFile::getXMLDocument() const {
 }
 
 DecoderConfiguration::DecoderConfiguration(const ConfigurationFile &file) :
-		logger_("DecoderConfiguration"), random_(Random::create()) {
+		logger_("DecoderConfiguration"), random_(randomImplementation_), phraseTableScoreIndex_(0), nscores_(0), sparse_(false),
+		performanceCounters_(false), measureCascade_(true), cascadeRequests_(0), featurePipeline_(NULL) {
 	uint step = 0;
 	for(Arabica::DOM::Node<std::string> n = file.getXMLDocument().getDocumentElement().getFirstChild();
 			n != 0; n = n.getNextSibling()) {
@@ -138,10 +144,104 @@ error:
 }
 
 DecoderConfiguration::~DecoderConfiguration() {
+	delete featurePipeline_;
 	delete stateGenerator_;
 	delete search_;
 }
 
+namespace {
+	// how often the feature cascade is re-sorted by measured cost
+	const uint CASCADE_REORDER_INTERVAL = 1000;
+	// number of cascade requests after which the order is fixed
+	const uint CASCADE_CALIBRATION_REQUESTS = 10 * CASCADE_REORDER_INTERVAL;
+	// one in this many updateScore calls per feature is timed during calibration
+	const uint UPDATE_COST_SAMPLE_INTERVAL = 16;
+
+	struct CompareUpdateCost : public std::binary_function<uint,uint,bool> {
+		const std::vector<double> &time;
+		const std::vector<unsigned long> &calls;
+
+		CompareUpdateCost(const std::vector<double> &t, const std::vector<unsigned long> &c) : time(t), calls(c) {}
+
+		double average(uint i) const {
+			return calls[i] == 0 ? .0 : time[i] / calls[i];
+		}
+
+		bool operator()(uint a, uint b) const {
+			return average(a) < average(b);
+		}
+	};
+}
+
+DecoderConfiguration::UpdateCostSamples_ &DecoderConfiguration::getUpdateCostSamples() const {
+	UpdateCostSamples_ *samples = updateCostSamples_.get();
+	if(samples == NULL) {
+		samples = new UpdateCostSamples_;
+		samples->time.resize(featureFunctions_.size());
+		samples->calls.resize(featureFunctions_.size());
+		samples->tick.resize(featureFunctions_.size());
+		samples->calibrating = measureCascade_;
+		updateCostSamples_.reset(samples);
+	}
+	return *samples;
+}
+
+bool DecoderConfiguration::sampleUpdateCost(uint i) const {
+	UpdateCostSamples_ &samples = getUpdateCostSamples();
+	if(!samples.calibrating || ++samples.tick[i] < UPDATE_COST_SAMPLE_INTERVAL)
+		return false;
+	samples.tick[i] = 0;
+	return true;
+}
+
+void DecoderConfiguration::recordUpdateCost(uint i, double seconds, uint calls) const {
+	UpdateCostSamples_ &samples = getUpdateCostSamples();
+	samples.time[i] += seconds;
+	samples.calls[i] += calls;
+}
+
+boost::shared_ptr<const std::vector<uint> > DecoderConfiguration::getFeatureCascade() const {
+	UpdateCostSamples_ &samples = getUpdateCostSamples();
+	if(samples.fixedCascade)
+		return samples.fixedCascade;
+
+	boost::mutex::scoped_lock lock(cascadeMutex_);
+
+	if(samples.calibrating) {
+		updateTime_.resize(featureFunctions_.size());
+		updateCalls_.resize(featureFunctions_.size());
+		for(uint i = 0; i < featureFunctions_.size(); i++) {
+			updateTime_[i] += samples.time[i];
+			updateCalls_[i] += samples.calls[i];
+		}
+		std::fill(samples.time.begin(), samples.time.end(), .0);
+		std::fill(samples.calls.begin(), samples.calls.end(), 0);
+	}
+
+	bool calibrating = measureCascade_ && cascadeRequests_ < CASCADE_CALIBRATION_REQUESTS;
+	samples.calibrating = calibrating;
+	if(!featureCascade_ || (calibrating && ++cascadeRequests_ % CASCADE_REORDER_INTERVAL == 0)) {
+		std::vector<uint> *cascade = new std::vector<uint>(featureFunctions_.size());
+		for(uint i = 0; i < cascade->size(); i++)
+			(*cascade)[i] = i;
+		if(measureCascade_)
+			std::stable_sort(cascade->begin(), cascade->end(), CompareUpdateCost(updateTime_, updateCalls_));
+		featureCascade_.reset(cascade);
+
+		if(logger_.loggable(debug)) {
+			LOG(logger_, debug, "Feature cascade:");
+			for(uint i = 0; i < cascade->size(); i++)
+				LOG(logger_, debug, featureFunctions_[(*cascade)[i]].getId() << '\t'
+					<< getAverageUpdateCost((*cascade)[i]));
+		}
+	}
+
+	if(!calibrating)
+		samples.fixedCascade = featureCascade_;
+
+	return featureCascade_;
+}
+
 void DecoderConfiguration::setupRandomGenerator(Arabica::DOM::Node<std::string> n) {
 	for(Arabica::DOM::Node<std::string> c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
 		if(c.getNodeType() == Arabica::DOM::Node<std::string>::TEXT_NODE) {
@@ -173,6 +273,7 @@ void DecoderConfiguration::setupStateGenerator(Arabica::DOM::Node<std::string> n
 	}
 
 	stateGenerator_ = new StateGenerator(type, Parameters(logger_, istateNode), random_);
+	stateGenerator_->setupOperationSelection(Parameters(logger_, n));
 
 	for(c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
 		if(c.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE || c.getNodeName() != "operation")
@@ -196,7 +297,25 @@ void DecoderConfiguration::setupSearch(Arabica::DOM::Node<std::string> n) {
 }
 
 void DecoderConfiguration::setupModels(Arabica::DOM::Node<std::string> n) {
-	FeatureFunctionFactory ffFactory(random_);
+	// With cascade="fixed", the exact scores are computed in configuration
+	// order, which makes the search independent of timing measurements.
+	std::string cascade = static_cast<Arabica::DOM::Element<std::string> >(n).getAttribute("cascade");
+	if(cascade == "fixed")
+		measureCascade_ = false;
+	else if(cascade != "" && cascade != "measured") {
+		LOG(logger_, error, "Unknown feature cascade type: " << cascade);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	// With pipeline="generic", the feature functions are always called
+	// through their virtual interface, even if they're all standard models.
+	std::string pipeline = static_cast<Arabica::DOM::Element<std::string> >(n).getAttribute("pipeline");
+	if(pipeline != "" && pipeline != "auto" && pipeline != "generic") {
+		LOG(logger_, error, "Unknown feature pipeline type: " << pipeline);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	FeatureFunctionFactory ffFactory(random_, sparseFeatures_);
 	uint scoreIndex = 0;
 	std::set<std::string> ids;
 	for(Arabica::DOM::Node<std::string> c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
@@ -218,11 +337,14 @@ void DecoderConfiguration::setupModels(Arabica::DOM::Node<std::string> n) {
 		FeatureFunctionInstantiation *ff = new FeatureFunctionInstantiation(id, scoreIndex, ff_impl);
 		featureFunctions_.push_back(ff);
 		scoreIndex += ff->getNumberOfScores();
+		if(ff->hasSparseScores())
+			sparse_ = true;
 		
 		// TODO: This is messy.
 		if(type == "phrase-table" && !phraseTable_) {
 			phraseTable_ = boost::dynamic_pointer_cast<const PhraseTable>(ff_impl);
 			assert(phraseTable_);
+			phraseTableScoreIndex_ = ff->getScoreIndex();
 		}
 	}
 	nscores_ = scoreIndex;
@@ -231,13 +353,28 @@ void DecoderConfiguration::setupModels(Arabica::DOM::Node<std::string> n) {
 		LOG(logger_, error, "No models found.");
 		BOOST_THROW_EXCEPTION(ConfigurationException());
 	}
+
+	featurePipeline_ = FeaturePipeline::create(featureFunctions_, pipeline != "generic");
+	LOG(logger_, normal, "Feature pipeline: " << featurePipeline_->getDescription());
 }
 
 void DecoderConfiguration::setupWeights(Arabica::DOM::Node<std::string> n) {
 	boost::dynamic_bitset<> coveredWeights(getTotalNumberOfScores());
 	featureWeights_.resize(getTotalNumberOfScores());
 	for(Arabica::DOM::Node<std::string> c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
-		if(c.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE || c.getNodeName() != "weight")
+		if(c.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE)
+			continue;
+		if(c.getNodeName() == "sparse-weights") {
+			Arabica::DOM::Element<std::string> snode = static_cast<Arabica::DOM::Element<std::string> >(c);
+			std::string file = snode.getAttribute("file");
+			if(file == "") {
+				LOG(logger_, error, "Lacking required attribute 'file' on sparse-weights element.");
+				BOOST_THROW_EXCEPTION(ConfigurationException());
+			}
+			sparseFeatures_.loadWeights(file);
+			continue;
+		}
+		if(c.getNodeName() != "weight")
 			continue;
 		Arabica::DOM::Element<std::string> wnode = static_cast<Arabica::DOM::Element<std::string> >(c);
 		std::string id = wnode.getAttribute("model");
@@ -291,5 +428,10 @@ void DecoderConfiguration::setupWeights(Arabica::DOM::Node<std::string> n) {
 		LOG(logger_, error, "Insufficient number of weights: " << coveredWeights);
 		BOOST_THROW_EXCEPTION(ConfigurationException());
 	}
+
+	if(phraseTable_) {
+		std::vector<Float>::const_iterator begin = featureWeights_.begin() + phraseTableScoreIndex_;
+		phraseTableWeights_.assign(begin, begin + phraseTable_->getNumberOfScores());
+	}
 }
 
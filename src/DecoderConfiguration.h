@@ -25,6 +25,7 @@
 
 #include "Docent.h"
 #include "Random.h"
+#include "SparseFeatureRegistry.h"
 
 #include <iostream>
 #include <vector>
@@ -34,12 +35,15 @@
 #include <boost/optional.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <DOM/Document.hpp>
 #include <DOM/Element.hpp>
 
 class BeamSearchAdapter;
 class FeatureFunctionInstantiation;
+class FeaturePipeline;
 class PhraseTable;
 class SearchAlgorithm;
 class StateGenerator;
@@ -65,13 +69,52 @@ public:
 
 private:
 	Logger logger_;
+	RandomImplementation randomImplementation_;
 	Random random_;
 	
 	boost::shared_ptr<const PhraseTable> phraseTable_;
+	uint phraseTableScoreIndex_;
+	std::vector<Float> phraseTableWeights_;
 	
+	SparseFeatureRegistry sparseFeatures_;
 	FeatureFunctionList featureFunctions_;
 	std::vector<Float> featureWeights_;
 	uint nscores_;
+	bool sparse_;
+	bool performanceCounters_;
+
+	// Feature indices ordered by measured updateScore cost, cheapest first.
+	// The order is recalibrated during the first few thousand steps and then
+	// fixed, or it's the configuration order if measureCascade_ is false.
+	bool measureCascade_;
+	mutable boost::shared_ptr<const std::vector<uint> > featureCascade_;
+	mutable uint cascadeRequests_;
+	// total updateScore time and calls per feature
+	mutable std::vector<double> updateTime_;
+	mutable std::vector<unsigned long> updateCalls_;
+	mutable boost::mutex cascadeMutex_;
+
+	// Cost samples taken by one thread since it last requested the cascade,
+	// so that the threads can measure without synchronisation. They're added
+	// to the totals when the thread requests the cascade.
+	struct UpdateCostSamples_ {
+		std::vector<double> time;
+		std::vector<unsigned long> calls;
+		std::vector<uint> tick;
+		bool calibrating;
+		// the final order, once calibration is over, so that it can be
+		// returned without taking the lock
+		boost::shared_ptr<const std::vector<uint> > fixedCascade;
+	};
+	mutable boost::thread_specific_ptr<UpdateCostSamples_> updateCostSamples_;
+
+	UpdateCostSamples_ &getUpdateCostSamples() const;
+	double getAverageUpdateCost(uint i) const {
+		return updateCalls_[i] == 0 ? .0 : updateTime_[i] / updateCalls_[i];
+	}
+
+	// chosen once the models are known, see FeaturePipeline::create
+	FeaturePipeline *featurePipeline_;
 
 	StateGenerator *stateGenerator_;
 	SearchAlgorithm *search_;
@@ -101,10 +144,42 @@ public:
 	const std::vector<Float> &getFeatureWeights() const {
 		return featureWeights_;
 	}
+
+	// the weights of the scores stored with the phrase pairs of the phrase table
+	const std::vector<Float> &getPhraseTableWeights() const {
+		return phraseTableWeights_;
+	}
 	
 	uint getTotalNumberOfScores() const {
 		return nscores_;
 	}
+
+	// true if any feature function fires sparse features
+	bool hasSparseFeatures() const {
+		return sparse_;
+	}
+
+	const FeaturePipeline &getFeaturePipeline() const {
+		return *featurePipeline_;
+	}
+
+	boost::shared_ptr<const std::vector<uint> > getFeatureCascade() const;
+
+	// Returns true if the cost of the next updateScore call for feature i
+	// should be measured and passed to recordUpdateCost. Only a sample of the
+	// calls made while the cascade is being calibrated are measured.
+	bool sampleUpdateCost(uint i) const;
+	// records the time taken by the given number of updates of feature i
+	void recordUpdateCost(uint i, double seconds, uint calls = 1) const;
+
+	// whether documents collect PerformanceCounters, off by default
+	bool collectsPerformanceCounters() const {
+		return performanceCounters_;
+	}
+
+	void setCollectPerformanceCounters(bool collect) {
+		performanceCounters_ = collect;
+	}
 	
 	const StateGenerator &getStateGenerator() const {
 		return *stateGenerator_;
@@ -29,6 +29,10 @@
 #include <list>
 #include <string>
 
+#include <time.h>
+
+#include "CoverageBitmap.h"
+
 #include <boost/dynamic_bitset.hpp>
 #include <boost/exception/all.hpp>
 #include <boost/flyweight.hpp>
@@ -55,16 +59,38 @@ typedef boost::flyweight<PhraseData,boost::flyweights::no_tracking> Phrase;
 
 typedef std::vector<Float> Scores;
 
-typedef boost::dynamic_bitset<> CoverageBitmap;
-
 BOOST_SERIALIZATION_SPLIT_FREE(CoverageBitmap)
+BOOST_SERIALIZATION_SPLIT_FREE(boost::dynamic_bitset<>)
 namespace boost {
 namespace serialization {
+	// CoverageBitmap uses the same format as dynamic_bitset, so existing binary files stay readable.
+	template<class Archive>
+	void save(Archive &ar, const boost::dynamic_bitset<> &bm, const uint version) {
+		boost::dynamic_bitset<>::size_type size = bm.size();
+		std::vector<boost::dynamic_bitset<>::block_type> blocks(bm.num_blocks());
+		boost::to_block_range(bm, blocks.begin());
+
+		ar << size;
+		ar << const_cast<const std::vector<boost::dynamic_bitset<>::block_type>& >(blocks);
+	}
+
+	template<class Archive>
+	void load(Archive &ar, boost::dynamic_bitset<> &bm, const uint version) {
+		boost::dynamic_bitset<>::size_type size;
+		std::vector<boost::dynamic_bitset<>::block_type> blocks;
+
+		ar >> size;
+		ar >> blocks;
+
+		bm.resize(size);
+		boost::from_block_range(blocks.begin(), blocks.end(), bm);
+	}
+
 	template<class Archive>
 	void save(Archive &ar, const CoverageBitmap &bm, const uint version) {
 		CoverageBitmap::size_type size = bm.size();
 		std::vector<CoverageBitmap::block_type> blocks(bm.num_blocks());
-		boost::to_block_range(bm, blocks.begin());
+		bm.copyBlocks(blocks.begin());
 
 		ar << size;
 		ar << const_cast<const std::vector<CoverageBitmap::block_type>& >(blocks);
@@ -80,7 +106,7 @@ namespace serialization {
 		ar >> blocks;
 
 		bm.resize(size);
-		boost::from_block_range(blocks.begin(), blocks.end(), bm);
+		bm.assignBlocks(blocks.begin(), blocks.end());
 	}
 
 	template<class Archive, class T, class A1, class A2, class A3, class A4, class A5>
@@ -110,6 +136,13 @@ namespace serialization {
 
 const Float IMPOSSIBLE_SCORE = -1e30f;
 
+// wall-clock time in seconds for cost measurements
+inline double getMonotonicTime() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 inline Scores &operator+=(Scores &a, const Scores &b) {
 	assert(a.size() == b.size());
 	std::transform(a.begin(), a.end(), b.begin(), a.begin(), std::plus<Float>());
@@ -151,14 +184,6 @@ struct PointerEqualsTo : public std::binary_function<T,T,bool> {
 	}
 };
 
-namespace boost { // hijack namespace to make sure it's found where it's needed
-inline std::size_t hash_value(const CoverageBitmap &bm) {
-	std::vector<CoverageBitmap::block_type> blocks(bm.num_blocks());
-	boost::to_block_range(bm, blocks.begin());
-	return boost::hash_range(blocks.begin(), blocks.end());
-}
-}
-
 /*** Exceptions ***/
 
 struct DocentException : virtual std::exception, virtual boost::exception {};
@@ -25,13 +25,16 @@
 #include "DecoderConfiguration.h"
 #include "FeatureFunction.h"
 #include "MMAXDocument.h"
+#include "PerformanceCounters.h"
 #include "PhrasePair.h"
 #include "PhrasePairCollection.h"
 #include "PhraseTable.h"
 #include "PlainTextDocument.h"
+#include "ProposalCache.h"
 #include "Random.h"
 #include "SearchStep.h"
 #include "StateGenerator.h"
+#include "TargetSentence.h"
 
 #include <algorithm>
 #include <iterator>
@@ -42,22 +45,23 @@
 #include <boost/lambda/construct.hpp>
 #include <boost/lambda/if.hpp>
 
+Logger DocumentState::logger_("DocumentState");
+
 DocumentState::DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const MMAXDocument> &inputdoc, int docNumber) :
-		logger_("DocumentState"),
 		configuration_(&config), docNumber_(docNumber), inputdoc_(inputdoc),
-		scores_(configuration_->getTotalNumberOfScores()), generation_(0) {
+		scores_(configuration_->getTotalNumberOfScores()), attemptedSteps_(0), generation_(0), searchTemperature_(0) {
 	init();
 }
 
 DocumentState::DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const NistXmlDocument> &inputdoc, int docNumber) :
-		logger_("DocumentState"),
 		configuration_(&config), docNumber_(docNumber), inputdoc_(inputdoc->asMMAXDocument()),
-		scores_(configuration_->getTotalNumberOfScores()), generation_(0) {
+		scores_(configuration_->getTotalNumberOfScores()), attemptedSteps_(0), generation_(0), searchTemperature_(0) {
 	init();
 }
 
 void DocumentState::init() {
 	sentences_.reserve(inputdoc_->getNumberOfSentences());
+	targetSentences_.reserve(inputdoc_->getNumberOfSentences());
 	phraseTranslations_.reserve(inputdoc_->getNumberOfSentences());
 	std::vector<Float> *sntlen = new std::vector<Float>();
 	sntlen->reserve(inputdoc_->getNumberOfSentences());
@@ -66,27 +70,60 @@ void DocumentState::init() {
 	const StateGenerator &generator = configuration_->getStateGenerator();
 	for(uint i = 0; i < inputdoc_->getNumberOfSentences(); i++) {
 		std::vector<Word> snt(inputdoc_->sentence_begin(i), inputdoc_->sentence_end(i));
-		phraseTranslations_.push_back(ttable.getPhrasesForSentence(snt));
+		phraseTranslations_.push_back(ttable.getPhrasesForSentence(snt,
+			configuration_->getPhraseTableWeights(), generator.getProposalTemperatures()));
 		PhraseSegmentation ps = generator.initSegmentation(phraseTranslations_[i], snt, docNumber_, i);
 		sentences_.push_back(ps);
+		targetSentences_.push_back(boost::shared_ptr<const TargetSentence>(new TargetSentence(ps)));
 		cumlength += snt.size();
 		sntlen->push_back(cumlength);
 	}
 	cumulativeSentenceLength_.reset(sntlen);
+	proposalCache_.reset(new ProposalCache(*configuration_));
+	if(proposalCache_->usesSentenceGenerations())
+		sentenceGenerations_.resize(sentences_.size(), generation_);
+	if(generator.getSentenceSelectionPolicy().adaptive) {
+		sentenceActivity_.resize(sentences_.size());
+		std::vector<Float> lengths(sentences_.size());
+		for(uint i = 0; i < sentences_.size(); i++)
+			lengths[i] = getInputSentenceLength(i);
+		sentenceDistribution_ = FenwickDistribution(lengths);
+	}
+	if(configuration_->collectsPerformanceCounters())
+		performanceCounters_.reset(new PerformanceCounters(*configuration_));
 
 	Scores::iterator scoreit = scores_.begin();
 	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
 	for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end();
 			scoreit += it->getNumberOfScores(), ++it)
 		featureStates_.push_back(it->initDocument(*this, scoreit));
+	if(configuration_->hasSparseFeatures())
+		for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end(); ++it)
+			if(it->hasSparseScores())
+				it->initSparseScores(*this, sparseScores_);
+	updateScore();
+}
+
+// The weighted total is computed from scratch rather than taken over from the
+// search step, so rounding errors don't accumulate over many accepted steps.
+void DocumentState::updateScore() {
+	sparseScore_ = sparseScores_.getWeightedSum();
+	score_ = std::inner_product(scores_.begin(), scores_.end(),
+		configuration_->getFeatureWeights().begin(), Float(0)) + sparseScore_;
 }
 
 DocumentState::DocumentState(const DocumentState &o)
-	: logger_("DocumentState"),
-	  configuration_(o.configuration_), docNumber_(o.docNumber_), inputdoc_(o.inputdoc_),
-	  sentences_(o.sentences_), phraseTranslations_(o.phraseTranslations_),
+	: configuration_(o.configuration_), docNumber_(o.docNumber_), inputdoc_(o.inputdoc_),
+	  sentences_(o.sentences_), targetSentences_(o.targetSentences_), phraseTranslations_(o.phraseTranslations_),
 	  cumulativeSentenceLength_(o.cumulativeSentenceLength_), scores_(o.scores_),
-	  generation_(o.generation_) {
+	  sparseScores_(o.sparseScores_), sparseScore_(o.sparseScore_), score_(o.score_),
+	  operationPayoffs_(o.operationPayoffs_), operationDistribution_(o.operationDistribution_),
+	  sentenceActivity_(o.sentenceActivity_), attemptedSteps_(o.attemptedSteps_),
+	  sentenceDistribution_(o.sentenceDistribution_), frozenSentences_(o.frozenSentences_),
+	  generation_(o.generation_), sentenceGenerations_(o.sentenceGenerations_),
+	  searchTemperature_(o.searchTemperature_),
+	  proposalCache_(new ProposalCache(*o.configuration_)),
+	  performanceCounters_(o.performanceCounters_) {
 	using namespace boost::lambda;
 	std::transform(o.featureStates_.begin(), o.featureStates_.end(), std::back_inserter(featureStates_),
 		if_then_else_return(_1, bind(&FeatureFunction::State::clone, _1),
@@ -102,11 +139,25 @@ DocumentState &DocumentState::operator=(const DocumentState &o) {
 	configuration_ = o.configuration_;
 	inputdoc_ = o.inputdoc_;
 	sentences_ = o.sentences_;
+	targetSentences_ = o.targetSentences_;
 	docNumber_ = o.docNumber_;
 	phraseTranslations_ = o.phraseTranslations_;
 	cumulativeSentenceLength_ = o.cumulativeSentenceLength_;
 	scores_ = o.scores_;
+	sparseScores_ = o.sparseScores_;
+	sparseScore_ = o.sparseScore_;
+	score_ = o.score_;
+	operationPayoffs_ = o.operationPayoffs_;
+	operationDistribution_ = o.operationDistribution_;
+	sentenceActivity_ = o.sentenceActivity_;
+	attemptedSteps_ = o.attemptedSteps_;
+	sentenceDistribution_ = o.sentenceDistribution_;
+	frozenSentences_ = o.frozenSentences_;
 	generation_ = o.generation_;
+	sentenceGenerations_ = o.sentenceGenerations_;
+	searchTemperature_ = o.searchTemperature_;
+	proposalCache_.reset(new ProposalCache(*configuration_));
+	performanceCounters_ = o.performanceCounters_;
 	std::vector<FeatureFunction::State *> ffs;
 	std::transform(o.featureStates_.begin(), o.featureStates_.end(), std::back_inserter(ffs),
 		if_then_else_return(_1, bind(&FeatureFunction::State::clone, _1),
@@ -136,16 +187,103 @@ Scores DocumentState::computeSentenceScores(uint i) const {
 	return s;
 }
 
+void DocumentState::separatePerformanceCounters() {
+	if(performanceCounters_)
+		performanceCounters_.reset(new PerformanceCounters(*configuration_));
+}
+
 void DocumentState::registerAttemptedMove(const SearchStep *step) {
 	moveCount_[step->getOperation()].first++;
 }
 
+void DocumentState::registerOperationPayoff(uint op, Float gain, Float seconds, Float decay) {
+	if(op >= operationPayoffs_.size())
+		operationPayoffs_.resize(op + 1);
+	OperationPayoff &p = operationPayoffs_[op];
+	p.gain = decay * p.gain + gain;
+	p.seconds = decay * p.seconds + seconds;
+	p.attempts++;
+	operationDistribution_.clear();
+}
+
+uint DocumentState::drawSentence(Random rnd) const {
+	const SentenceSelectionPolicy &policy = configuration_->getStateGenerator().getSentenceSelectionPolicy();
+	if(!policy.adaptive)
+		return rnd.drawFromCumulativeDistribution(*cumulativeSentenceLength_);
+
+	// don't get stuck if everything is frozen
+	if(sentenceDistribution_.empty())
+		return rnd.drawFromCumulativeDistribution(*cumulativeSentenceLength_);
+	return sentenceDistribution_.draw(rnd);
+}
+
+void DocumentState::updateSentenceWeight(uint sentno, const SentenceSelectionPolicy &policy) {
+	const SentenceActivity_ &a = sentenceActivity_[sentno];
+	Float weight = 0;
+	if(attemptedSteps_ >= a.frozenUntil) {
+		Float activity = a.attempts > 0 ? a.accepts / a.attempts : Float(0);
+		weight = getInputSentenceLength(sentno) * (1 + policy.activityBoost * activity);
+	}
+	sentenceDistribution_.setWeight(sentno, weight);
+}
+
+void DocumentState::registerSentenceOutcome(const SearchStep *step, bool accepted, const SentenceSelectionPolicy &policy) {
+	attemptedSteps_++;
+
+	while(!frozenSentences_.empty() && frozenSentences_.top().first <= attemptedSteps_) {
+		uint sentno = frozenSentences_.top().second;
+		// a sentence frozen again in the meantime has another entry
+		if(sentenceActivity_[sentno].frozenUntil == frozenSentences_.top().first)
+			updateSentenceWeight(sentno, policy);
+		frozenSentences_.pop();
+	}
+
+	// the modifications are sorted by sentence number
+	const std::vector<SearchStep::Modification> &mods = step->getModifications();
+	for(uint i = 0; i < mods.size(); i++) {
+		uint sentno = mods[i].sentno;
+		if(i > 0 && mods[i - 1].sentno == sentno)
+			continue;
+
+		SentenceActivity_ &a = sentenceActivity_[sentno];
+		a.attempts = policy.decay * a.attempts + 1;
+		a.accepts = policy.decay * a.accepts + (accepted ? 1 : 0);
+		if(accepted)
+			a.rejectionRun = 0;
+		else if(++a.rejectionRun >= policy.freezeRejections * getInputSentenceLength(sentno)) {
+			LOG(logger_, debug, "Freezing sentence " << sentno << " for " << policy.freezeSteps << " steps.");
+			a.frozenUntil = attemptedSteps_ + policy.freezeSteps;
+			a.rejectionRun = 0;
+			frozenSentences_.push(SentenceThaw_(a.frozenUntil, sentno));
+		}
+		updateSentenceWeight(sentno, policy);
+	}
+}
+
+void DocumentState::unfreezeSentences(const SentenceSelectionPolicy &policy) {
+	while(!frozenSentences_.empty()) {
+		uint sentno = frozenSentences_.top().second;
+		sentenceActivity_[sentno].frozenUntil = 0;
+		updateSentenceWeight(sentno, policy);
+		frozenSentences_.pop();
+	}
+}
+
 void DocumentState::applyModifications(SearchStep *step) {
 	assert(&step->getDocumentState() == this && step->getDocumentGeneration() == generation_);
 
 	moveCount_[step->getOperation()].second++;
 
+	PerformanceCounters *perf = performanceCounters_.get();
+	PerformanceCounters::Stopwatch applyWatch(perf);
+
 	std::vector<SearchStep::Modification> &mods = step->getModifications();
+
+	// must be done before the proposals are spliced into the sentences
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it)
+		if(it == mods.begin() || (it - 1)->sentno != it->sentno)
+			targetSentences_[it->sentno].reset(new TargetSentence(*targetSentences_[it->sentno], *step, it->sentno));
+
 	for(std::vector<SearchStep::Modification>::iterator it = mods.begin(); it != mods.end(); ++it) {
 		uint sentno = it->sentno;
 		PhraseSegmentation &sent = sentences_[sentno];
@@ -160,8 +298,12 @@ void DocumentState::applyModifications(SearchStep *step) {
 
 		sent.erase(from_it, to_it);
 		sent.splice(to_it, proposal);
+		if(!sentenceGenerations_.empty())
+			sentenceGenerations_[sentno] = generation_ + 1;
 	}
 	scores_ = step->getScores();
+	sparseScores_ += step->getSparseScoreChanges();
+	updateScore();
 
 /*
 	BOOST_FOREACH(const PhraseSegmentation &sent, sentences_)
@@ -171,8 +313,21 @@ void DocumentState::applyModifications(SearchStep *step) {
 	const DecoderConfiguration::FeatureFunctionList &ffs = configuration_->getFeatureFunctions();
 	const std::vector<FeatureFunction::StateModifications *> &smods = step->getStateModifications();
 	for(uint i = 0; i < ffs.size(); i++)
-		if(smods[i] != NULL)
+		if(smods[i] != NULL) {
+			PerformanceCounters::Stopwatch watch(perf);
 			featureStates_[i] = ffs[i].applyStateModifications(featureStates_[i], smods[i]);
+			if(perf) {
+				watch.stop();
+				watch.record(perf->getFeature(i).apply);
+			}
+		}
+
+	if(perf) {
+		applyWatch.stop();
+		PerformanceCounters::OperationCounters &oc = perf->getOperation(step->getOperation());
+		applyWatch.record(oc.apply);
+		oc.accepted++;
+	}
 
 	delete step;
 	
@@ -182,11 +337,12 @@ void DocumentState::applyModifications(SearchStep *step) {
 PlainTextDocument DocumentState::asPlainTextDocument() const {
 	std::vector<std::vector<Word> > out(sentences_.size());
 
-	for(uint i = 0; i < sentences_.size(); i++)
-		BOOST_FOREACH(const AnchoredPhrasePair &app, sentences_[i]) {
-			const std::vector<Word> &phr = app.second.get().getTargetPhrase().get();
-			std::copy(phr.begin(), phr.end(), std::back_inserter(out[i]));
-		}
+	for(uint i = 0; i < sentences_.size(); i++) {
+		const TargetSentence &tgt = *targetSentences_[i];
+		out[i].reserve(tgt.size());
+		for(uint j = 0; j < tgt.size(); j++)
+			out[i].push_back(tgt[j]);
+	}
 
 	return PlainTextDocument(out);
 }
@@ -216,5 +372,7 @@ std::ostream &operator<<(std::ostream &os, const DocumentState &doc) {
 	os << "DOCUMENT STATE:\n";
 	std::copy(doc.sentences_.begin(), doc.sentences_.end(), std::ostream_iterator<PhraseSegmentation>(os));
 	os << doc.scores_ << " * " << doc.configuration_->getFeatureWeights() << " = " << doc.getScore() << '\n';
+	if(!doc.sparseScores_.empty())
+		os << "SPARSE: " << doc.sparseScores_ << '\n';
 	return os;
 }
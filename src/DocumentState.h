@@ -29,19 +29,26 @@
 #include "PhrasePair.h"
 #include "PlainTextDocument.h"
 #include "Random.h"
+#include "SparseScores.h"
+#include "TargetSentence.h"
 
+#include <functional>
 #include <map>
 #include <iosfwd>
 #include <numeric>
+#include <queue>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/functional/hash.hpp>
 
 class MMAXDocument;
 class NistXmlDocument;
+class PerformanceCounters;
 class PhrasePairCollection;
 class PhraseTable;
+class ProposalCache;
 class SearchStep;
 class StateOperation;
 
@@ -49,6 +56,7 @@ typedef unsigned long DocumentGeneration;
 
 class DocumentState {
 	friend class StateOperation;
+	friend class StateGenerator;
 	friend std::ostream &operator<<(std::ostream &os, const DocumentState &doc);
 	friend std::size_t hash_value(const DocumentState &state);
 
@@ -56,24 +64,101 @@ public:
 	// the pair is (attempted moves, accepted moves)
 	typedef std::map<const StateOperation *,std::pair<DocumentGeneration,DocumentGeneration> > MoveCounts;
 
+	// Exponentially decaying sums of the score gain and the time spent per
+	// operation, used for adaptive operation selection.
+	struct OperationPayoff {
+		Float gain;
+		Float seconds;
+		DocumentGeneration attempts;
+
+		OperationPayoff() : gain(0), seconds(0), attempts(0) {}
+	};
+	// indexed by the position of the operation in the configuration
+	typedef std::vector<OperationPayoff> OperationPayoffs;
+
+	// Parameters of adaptive sentence selection. Sentences are drawn in proportion
+	// to their input length, multiplied by (1 + activityBoost * recent acceptance
+	// rate). A sentence is frozen for freezeSteps steps when freezeRejections
+	// consecutive steps per input word touching it have been rejected, or until
+	// an accepted step changes the score of a document-level feature.
+	struct SentenceSelectionPolicy {
+		bool adaptive;
+		Float activityBoost;
+		Float decay;
+		Float freezeRejections;
+		DocumentGeneration freezeSteps;
+
+		SentenceSelectionPolicy() :
+			adaptive(false), activityBoost(4), decay(.99), freezeRejections(20), freezeSteps(5000) {}
+	};
+
 private:
-	Logger logger_;
+	static Logger logger_;
 	const DecoderConfiguration *configuration_;
 
 	uint docNumber_;
 	
 	boost::shared_ptr<const MMAXDocument> inputdoc_;
 	std::vector<PhraseSegmentation> sentences_;
+	// Flat target word arrays of the sentences. They are replaced rather than
+	// modified when a sentence changes, so they can be shared between copies.
+	std::vector<boost::shared_ptr<const TargetSentence> > targetSentences_;
 	std::vector<boost::shared_ptr<const PhrasePairCollection> > phraseTranslations_;
 	boost::shared_ptr<const std::vector<Float> > cumulativeSentenceLength_;
 	Scores scores_;
+	// non-zero sparse feature values
+	SparseScores sparseScores_;
+	// weighted total of sparseScores_
+	Float sparseScore_;
+	// weighted total of scores_ and sparseScores_, recomputed whenever they change
+	Float score_;
 	std::vector<FeatureFunction::State *> featureStates_;
 
 	MoveCounts moveCount_;
+	OperationPayoffs operationPayoffs_;
+	// cumulative adaptive operation distribution, empty if it must be recomputed
+	mutable std::vector<Float> operationDistribution_;
+
+	struct SentenceActivity_ {
+		Float attempts;
+		Float accepts;
+		uint rejectionRun;
+		DocumentGeneration frozenUntil;
+
+		SentenceActivity_() : attempts(0), accepts(0), rejectionRun(0), frozenUntil(0) {}
+	};
+	typedef std::pair<DocumentGeneration,uint> SentenceThaw_;
+	typedef std::priority_queue<SentenceThaw_,std::vector<SentenceThaw_>,std::greater<SentenceThaw_> > ThawQueue_;
+
+	// The activities, the selection distribution and the frozen sentences
+	// are only kept if adaptive sentence selection is enabled. The
+	// distribution is updated for the sentences touched by each step.
+	std::vector<SentenceActivity_> sentenceActivity_;
+	DocumentGeneration attemptedSteps_;
+	FenwickDistribution sentenceDistribution_;
+	// frozen sentences by the step at which they thaw, possibly with stale entries
+	ThawQueue_ frozenSentences_;
+
 	DocumentGeneration generation_;
+	// generation in which each sentence was last modified, only kept if
+	// the proposal cache needs it
+	std::vector<DocumentGeneration> sentenceGenerations_;
+
+	// temperature of the search working on the document, 0 for greedy searches
+	Float searchTemperature_;
+
+	// The proposal cache is an optimisation only and isn't copied along
+	// with the document state.
+	boost::scoped_ptr<ProposalCache> proposalCache_;
+
+	// NULL unless the configuration asks for performance counters. Copies
+	// share the counters, so work done on them is counted for the document.
+	boost::shared_ptr<PerformanceCounters> performanceCounters_;
 
 	void init();
+	void updateScore();
 	void debugSentenceCoverage(const PhraseSegmentation &seg) const;
+	void updateSentenceWeight(uint sentno, const SentenceSelectionPolicy &policy);
 
 public:
 	DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const MMAXDocument> &text, int docNumber);
@@ -103,9 +188,7 @@ public:
 
 	PlainTextDocument asPlainTextDocument() const;
 
-	uint drawSentence(Random rnd) const {
-		return rnd.drawFromCumulativeDistribution(*cumulativeSentenceLength_);
-	}
+	uint drawSentence(Random rnd) const;
 
 	SearchStep *proposeSearchStep() const;
 	void applyModifications(SearchStep *step);
@@ -118,30 +201,79 @@ public:
 		return sentences_[sentno];
 	}
 	
+	const TargetSentence &getTargetSentence(uint sentno) const {
+		return *targetSentences_[sentno];
+	}
+
 	Scores computeSentenceScores(uint sentno) const; // debugging only!
 
 	const Scores &getScores() const {
 		return scores_;
 	}
 	
+	const SparseScores &getSparseScores() const {
+		return sparseScores_;
+	}
+
+	Float getSparseScore() const {
+		return sparseScore_;
+	}
+
 	Float getScore() const {
-		return std::inner_product(scores_.begin(), scores_.end(),
-			configuration_->getFeatureWeights().begin(), Float(0));
+		return score_;
 	}
 	
 	DocumentGeneration getGeneration() const {
 		return generation_;
 	}
+
+	// Operations that sample at the temperature of the search read it from
+	// here. Searches with a temperature set it before proposing a step.
+	Float getSearchTemperature() const {
+		return searchTemperature_;
+	}
+
+	void setSearchTemperature(Float temperature) {
+		searchTemperature_ = temperature;
+	}
+
+	// only available if the proposal cache usesSentenceGenerations()
+	DocumentGeneration getSentenceGeneration(uint sentno) const {
+		return sentenceGenerations_[sentno];
+	}
+
+	ProposalCache &getProposalCache() const {
+		return *proposalCache_;
+	}
 	
+	PerformanceCounters *getPerformanceCounters() const {
+		return performanceCounters_.get();
+	}
+
+	// Gives the document empty counters of its own instead of those shared
+	// with the state it was copied from, e.g. to run it in another thread.
+	void separatePerformanceCounters();
+
 	const DecoderConfiguration *getDecoderConfiguration() const {
 		return configuration_;
 	}
 
+	uint getDocumentNumber() const {
+		return docNumber_;
+	}
+
 	void registerAttemptedMove(const SearchStep *step);
 	const MoveCounts &getMoveCounts() const {
 		return moveCount_;
 	}
 
+	void registerOperationPayoff(uint op, Float gain, Float seconds, Float decay);
+	void registerSentenceOutcome(const SearchStep *step, bool accepted, const SentenceSelectionPolicy &policy);
+	void unfreezeSentences(const SentenceSelectionPolicy &policy);
+	const OperationPayoffs &getOperationPayoffs() const {
+		return operationPayoffs_;
+	}
+
 	void dumpFeatureFunctionStates() const;
 };
 
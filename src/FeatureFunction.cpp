@@ -25,6 +25,7 @@
 #include "FeatureFunction.h"
 //#include "LexicalChainCohesionModel.h"
 #include "NgramModel.h"
+#include "PhrasePairIndicatorModel.h"
 #include "PhraseTable.h"
 //#include "PronominalAnaphoraModel.h"
 #include "SearchStep.h"
@@ -37,63 +38,27 @@
 #include "TypeTokenRateModel.h"
 #include "BleuModel.h"
 #include "ConnectiveModel.h"
+#include "CountingFeatureFunction.h"
+#include "GeometricDistortionModel.h"
 
 #include <algorithm>
 #include <limits>
 #include <vector>
 
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
-
-template<class CountingFunction>
-class CountingFeatureFunction : public FeatureFunction {
-private:
-	CountingFunction countingFunction_;
-
-public:
-	CountingFeatureFunction(CountingFunction countingFunction)
-		: countingFunction_(countingFunction) {}
-
-	static FeatureFunction *createWordPenaltyFeatureFunction();
-	static FeatureFunction *createOOVPenaltyFeatureFunction();
-
-	virtual State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
-	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
-		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
-	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
-		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const;
-	virtual uint getNumberOfScores() const {
-		return 1;
-	}
-
-	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
-};
-
-class GeometricDistortionModel : public FeatureFunction {
-private:
-	template<class Operator>
-	void scoreSegment(PhraseSegmentation::const_iterator from, PhraseSegmentation::const_iterator to,
-		Scores::iterator sbegin, Operator op) const;
-
-	Float computeDistortionDistance(const CoverageBitmap &m1, const CoverageBitmap &m2) const;
-	
-	Float distortionLimit_;
-
-public:
-	GeometricDistortionModel(const Parameters &params);
-
-	virtual State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
-	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
-		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
-	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
-		StateModifications *estmods, Scores::const_iterator, Scores::iterator estbegin) const;
-	
-	virtual uint getNumberOfScores() const {
-		return distortionLimit_ == -1 ? 1 : 2;
-	}
+void FeatureFunction::estimateScoreUpdates(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, Scores::const_iterator psbegin, const std::vector<Scores::iterator> &sbegins,
+		std::vector<StateModifications *> &estmods) const {
+	estmods.resize(steps.size());
+	for(uint i = 0; i < steps.size(); i++)
+		estmods[i] = estimateScoreUpdate(doc, *steps[i], state, psbegin, sbegins[i]);
+}
 
-	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
-};
+void FeatureFunction::updateScores(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, std::vector<StateModifications *> &estmods, Scores::const_iterator psbegin,
+		const std::vector<Scores::iterator> &sbegins) const {
+	for(uint i = 0; i < steps.size(); i++)
+		estmods[i] = updateScore(doc, *steps[i], state, estmods[i], psbegin, sbegins[i]);
+}
 
 class SentenceLengthModel : public FeatureFunction {
 private:
@@ -118,128 +83,21 @@ public:
 		return 1;
 	}
 
-	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
-};
-
-struct WordPenaltyCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
-	Float operator()(const AnchoredPhrasePair &ppair) const {
-		return -Float(ppair.second.get().getTargetPhrase().get().size());
-	};
-};
-
-struct OOVPenaltyCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
-	Float operator()(const AnchoredPhrasePair &ppair) const {
-		return ppair.second.get().isOOV() ? Float(-1) : Float(0);
-	}
-};
-
-struct LongWordCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
-
-	LongWordCounter(const Parameters &params) {
-		try {
-			longLimit_ = params.get<uint>("long-word-length-limit");
-		}
-		catch(ParameterNotFoundException()) {
-			longLimit_ = 7; //default value (from LIX)
-		}
+	virtual uint getDependencies() const {
+		return TargetLength;
 	}
 
-	Float operator()(const AnchoredPhrasePair &ppair) const {
-		int numLong = 0;
-		BOOST_FOREACH(const Word &w, ppair.second.get().getTargetPhrase().get()) {
-			if (w.size() >= longLimit_) {
-				numLong++;
-			}
-		}
-		return Float(-numLong);
+	virtual bool isSentenceLocal() const {
+		return true;
 	}
 
-private:
-	uint longLimit_;
+	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
-
-template<class F>
-CountingFeatureFunction<F> *createCountingFeatureFunction(F countingFunction) {
-	return new CountingFeatureFunction<F>(countingFunction);
-}
-
-template<class F>
-FeatureFunction::State *CountingFeatureFunction<F>::initDocument(const DocumentState &doc,
-		Scores::iterator sbegin) const {
-	using namespace boost::lambda;
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
-	Float &s = *sbegin;
-	s = Float(0);
-	for(uint i = 0; i < segs.size(); i++)
-		std::for_each(segs[i].begin(), segs[i].end(), s += bind(countingFunction_, _1));
-	return NULL;
-}
-
-template<class F>
-void CountingFeatureFunction<F>::computeSentenceScores(const DocumentState &doc, uint sentno,
-		Scores::iterator sbegin) const {
-	using namespace boost::lambda;
-	Float &s = *sbegin;
-	s = Float(0);
-	const PhraseSegmentation &snt = doc.getPhraseSegmentation(sentno);
-	std::for_each(snt.begin(), snt.end(), s += bind(countingFunction_, _1));
-}
-
-template<class F>
-FeatureFunction::StateModifications *CountingFeatureFunction<F>::estimateScoreUpdate(const DocumentState &doc,
-		const SearchStep &step, const State *state, Scores::const_iterator psbegin,
-		Scores::iterator sbegin) const {
-	using namespace boost::lambda;
-	Float &s = *sbegin;
-	s = *psbegin;
-	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-		std::for_each(it->from_it, it->to_it, s -= bind(countingFunction_, _1));
-		std::for_each(it->proposal.begin(), it->proposal.end(), s += bind(countingFunction_, _1));
-	}
-	return NULL;
-}
-
-template<class F>
-FeatureFunction::StateModifications *CountingFeatureFunction<F>::updateScore(const DocumentState &doc,
-		const SearchStep &step, const State *state, FeatureFunction::StateModifications *estmods,
-		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	return estmods;
-}
-
 GeometricDistortionModel::GeometricDistortionModel(const Parameters &params) {
 	distortionLimit_ = params.get<Float>("distortion-limit", std::numeric_limits<Float>::infinity());
 }
 
-inline Float GeometricDistortionModel::computeDistortionDistance(const CoverageBitmap &m1, const CoverageBitmap &m2) const {
-	uint fp1 = m1.find_first();
-	CoverageBitmap::size_type fp1n;
-	while((fp1n = m1.find_next(fp1)) != CoverageBitmap::npos)
-		fp1 = fp1n;
-	uint fp2 = m2.find_first();
-	return static_cast<Float>(-abs(fp2 - (fp1 + 1)));
-}
-
-template<class Operator>
-inline void GeometricDistortionModel::scoreSegment(PhraseSegmentation::const_iterator from,
-		PhraseSegmentation::const_iterator to, Scores::iterator sbegin, Operator op) const {
-	if(from == to)
-		return;
-
-	PhraseSegmentation::const_iterator it1 = from;
-	PhraseSegmentation::const_iterator it2 = from;
-	++it2;
-	while(it2 != to) {
-		Float dist = computeDistortionDistance(it1->first, it2->first);
-		*sbegin = op(*sbegin, dist);
-		if(-dist > distortionLimit_)
-			(*(sbegin + 1)) = op(*(sbegin + 1), Float(-1));
-		it1 = it2;
-		++it2;
-	}
-}
-
 FeatureFunction::State *GeometricDistortionModel::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
 	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
 	std::fill_n(sbegin, getNumberOfScores(), .0);
@@ -254,54 +112,6 @@ void GeometricDistortionModel::computeSentenceScores(const DocumentState &doc, u
 	scoreSegment(seg.begin(), seg.end(), sbegin, std::plus<Float>());
 }
 
-FeatureFunction::StateModifications *GeometricDistortionModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
-		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	
-	std::copy(psbegin, psbegin + getNumberOfScores(), sbegin);
-	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-		uint sentno = it->sentno;
-		PhraseSegmentation::const_iterator from_it = it->from_it;
-		PhraseSegmentation::const_iterator to_it = it->to_it;
-		const PhraseSegmentation &proposal = it->proposal;
-		const PhraseSegmentation &oldseg = doc.getPhraseSegmentation(sentno);
-
-		if(!proposal.empty()) {
-			if(from_it != oldseg.begin()) {
-				--from_it;
-				Float dist = computeDistortionDistance(from_it->first, proposal.front().first);
-				*sbegin += dist;
-				if(-dist > distortionLimit_)
-					(*(sbegin + 1))--;
-			}
-
-			if(to_it != oldseg.end()) {
-				Float dist = computeDistortionDistance(proposal.back().first, to_it->first);
-				*sbegin += dist;
-				if(-dist > distortionLimit_)
-					(*(sbegin + 1))--;
-				++to_it;
-			}
-		} else if(from_it != oldseg.begin() && to_it != oldseg.end()) {
-			--from_it;
-			Float dist = computeDistortionDistance(from_it->first, to_it->first);
-			*sbegin += dist;
-			if(-dist > distortionLimit_)
-				(*(sbegin + 1))--;
-			++to_it;
-		}
-		
-		scoreSegment(from_it, to_it, sbegin, std::minus<Float>());
-		scoreSegment(proposal.begin(), proposal.end(), sbegin, std::plus<Float>());
-	}
-	return NULL;
-}
-
-FeatureFunction::StateModifications *GeometricDistortionModel::updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
-		FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
-	return estmods;
-}
-
 SentenceLengthModel::SentenceLengthModel(const Parameters &params) {
 	Float identicalProb = params.get<Float>("prob-identical");
 	Float shortProb = params.get<Float>("prob-short");
@@ -316,33 +126,32 @@ SentenceLengthModel::SentenceLengthModel(const Parameters &params) {
 
 FeatureFunction::State *SentenceLengthModel::initDocument(const DocumentState &doc,
 		Scores::iterator sbegin) const {
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
+	uint nsents = doc.getPhraseSegmentations().size();
 	Float &s = *sbegin;
 	s = Float(0);
-	for(uint i = 0; i < segs.size(); i++)
-		s += score(doc.getInputSentenceLength(i), countTargetWords(segs[i]));
+	for(uint i = 0; i < nsents; i++)
+		s += score(doc.getInputSentenceLength(i), doc.getTargetSentence(i).size());
 	return NULL;
 }
 
 FeatureFunction::StateModifications *SentenceLengthModel::estimateScoreUpdate(const DocumentState &doc,
 		const SearchStep &step, const State *state, Scores::const_iterator psbegin,
 		Scores::iterator sbegin) const {
-	using namespace boost::lambda;
 	Float &s = *sbegin;
 	s = *psbegin;
+	// the modifications are sorted by sentence number, all those
+	// affecting the same sentence must be applied before rescoring it
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+	std::vector<SearchStep::Modification>::const_iterator it = mods.begin();
+	while(it != mods.end()) {
 		uint sentno = it->sentno;
-		PhraseSegmentation::const_iterator from_it = it->from_it;
-		PhraseSegmentation::const_iterator to_it = it->to_it;
-		const PhraseSegmentation &proposal = it->proposal;
-		
-		Float outlen = Float(countTargetWords(doc.getPhraseSegmentation(sentno)));
-		s -= score(doc.getInputSentenceLength(sentno), outlen);
+		const TargetSentence &current = doc.getTargetSentence(sentno);
+		uint outlen = current.size();
+		s -= score(doc.getInputSentenceLength(sentno), Float(outlen));
 
-		std::for_each(from_it, to_it, outlen -= bind(WordPenaltyCounter(), _1));
-		std::for_each(proposal.begin(), proposal.end(), outlen += bind(WordPenaltyCounter(), _1));
-		s += score(doc.getInputSentenceLength(sentno), outlen);
+		for(; it != mods.end() && it->sentno == sentno; ++it)
+			outlen += countTargetWords(it->proposal) - current.countWords(it->from, it->to);
+		s += score(doc.getInputSentenceLength(sentno), Float(outlen));
 	}
 	return NULL;
 }
@@ -354,7 +163,7 @@ FeatureFunction::StateModifications *SentenceLengthModel::updateScore(const Docu
 }
 
 void SentenceLengthModel::computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const {
-	*sbegin = score(doc.getInputSentenceLength(sentno), countTargetWords(doc.getPhraseSegmentation(sentno)));
+	*sbegin = score(doc.getInputSentenceLength(sentno), doc.getTargetSentence(sentno).size());
 }
 
 Float SentenceLengthModel::score(Float inputlen, Float outputlen) const {
@@ -380,11 +189,11 @@ boost::shared_ptr<FeatureFunction> FeatureFunctionFactory::create(const std::str
 	else if(type == "sentence-length-model")
 		ff = new SentenceLengthModel(params);
 	else if(type == "word-penalty")
-		ff = createCountingFeatureFunction(WordPenaltyCounter());
+		ff = createCountingFeatureFunction(WordPenaltyCounter(), TargetLength);
 	else if(type == "oov-penalty")
-		ff = createCountingFeatureFunction(OOVPenaltyCounter());
+		ff = createCountingFeatureFunction(OOVPenaltyCounter(), PhrasePairs);
 	else if(type == "long-word-penalty")
-		ff = createCountingFeatureFunction(LongWordCounter(params));
+		ff = createCountingFeatureFunction(LongWordCounter(params), TargetWords);
 	//else if(type == "word-space-cohesion-model")
 	//	ff = WordSpaceCohesionModelFactory::createWordSpaceCohesionModel(params);
 	//else if(type == "lexical-chain-cohesion-model")
@@ -407,6 +216,8 @@ boost::shared_ptr<FeatureFunction> FeatureFunctionFactory::create(const std::str
 		ff = new BleuModel(params);
 	else if(type == "connective-model")
 		ff = new ConnectiveModel(params);
+	else if(type == "phrase-pair-indicator")
+		ff = new PhrasePairIndicatorModel(params, sparseFeatures_);
 	else 
 		BOOST_THROW_EXCEPTION(ConfigurationException());
 
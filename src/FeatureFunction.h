@@ -26,14 +26,33 @@
 #include "Docent.h"
 #include "DecoderConfiguration.h"
 #include "PhrasePair.h"
+#include "SparseScores.h"
+
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
 class DocumentState;
 class SearchStep;
 
+// Aspects of the document state that a search step can change. Each feature
+// function declares the aspects its scores depend on, and search steps that
+// change none of them don't call the feature function at all.
+enum StateAspect {
+	SourceOrder = 1,	// order in which the source phrases are translated
+	PhrasePairs = 2,	// multiset of phrase pairs in each sentence
+	TargetWords = 4,	// multiset of target words in each sentence
+	TargetLength = 8,	// number of target words in each sentence
+	TargetSequence = 16,	// order of the target words
+	AllAspects = 31
+};
+
 class FeatureFunction {
 public:
+	// States and state modifications are only ever passed back to the
+	// feature function that created them, so implementations can downcast
+	// them with boost::polymorphic_downcast, which checks the type in debug
+	// builds only.
 	class State {
 	protected:
 		State() {}
@@ -58,12 +77,49 @@ public:
 		Scores::const_iterator psbegin, Scores::iterator sbegin) const = 0;
 	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
 		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const = 0;
+
+	// Batch versions of estimateScoreUpdate and updateScore for several steps
+	// proposed on the same document state. sbegins contains the position of
+	// this feature's scores in the score vector of each step, and estmods the
+	// state modifications of each step. The default implementations call the
+	// single-step versions; features can override them to share setup work
+	// between the steps.
+	virtual void estimateScoreUpdates(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, Scores::const_iterator psbegin, const std::vector<Scores::iterator> &sbegins,
+		std::vector<StateModifications *> &estmods) const;
+	virtual void updateScores(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, std::vector<StateModifications *> &estmods, Scores::const_iterator psbegin,
+		const std::vector<Scores::iterator> &sbegins) const;
+
 	virtual uint getNumberOfScores() const = 0;
+
+	// Bitwise OR of the StateAspects the scores depend on.
+	virtual uint getDependencies() const {
+		return AllAspects;
+	}
+
+	// True if the score change caused by modifying a sentence depends on
+	// nothing but the contents of that sentence.
+	virtual bool isSentenceLocal() const {
+		return false;
+	}
 	
 	virtual FeatureFunction::State *applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
 		return NULL;
 	}
 
+	// Feature functions can fire named sparse features in addition to their
+	// dense scores. Sparse scores are exact from the start and have no
+	// feature state; computeSparseScoreUpdate adds the changes caused by a
+	// step to delta, and is called only for steps changing an aspect the
+	// feature function depends on.
+	virtual bool hasSparseScores() const {
+		return false;
+	}
+
+	virtual void initSparseScores(const DocumentState &doc, SparseScores &scores) const {}
+	virtual void computeSparseScoreUpdate(const DocumentState &doc, const SearchStep &step, SparseScores &delta) const {}
+
 	virtual void dumpFeatureFunctionState(const DocumentState &doc, FeatureFunction::State *state) const {}
 
 	// debugging only!
@@ -75,15 +131,27 @@ private:
 	std::string id_;
 	uint scoreIndex_;
 	boost::shared_ptr<const FeatureFunction> impl_;
+	// constant properties of the feature function, cached to save virtual
+	// calls in the inner loops of score computation
+	uint dependencies_;
+	uint numberOfScores_;
+	bool sentenceLocal_;
+	bool sparse_;
 
 public:
 	FeatureFunctionInstantiation(const std::string &id, uint scoreIndex, boost::shared_ptr<const FeatureFunction> impl) :
-		id_(id), scoreIndex_(scoreIndex), impl_(impl) {}
+		id_(id), scoreIndex_(scoreIndex), impl_(impl),
+		dependencies_(impl->getDependencies()), numberOfScores_(impl->getNumberOfScores()),
+		sentenceLocal_(impl->isSentenceLocal()), sparse_(impl->hasSparseScores()) {}
 
 	const std::string &getId() const {
 		return id_;
 	}
 
+	const FeatureFunction *getImplementation() const {
+		return impl_.get();
+	}
+
 	uint getScoreIndex() const {
 		return scoreIndex_;
 	}
@@ -106,11 +174,43 @@ public:
 			FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
 		return impl_->updateScore(doc, step, state, estmods, psbegin, estbegin);
 	}
+
+	void estimateScoreUpdates(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+			const FeatureFunction::State *state, Scores::const_iterator psbegin,
+			const std::vector<Scores::iterator> &sbegins, std::vector<FeatureFunction::StateModifications *> &estmods) const {
+		impl_->estimateScoreUpdates(doc, steps, state, psbegin, sbegins, estmods);
+	}
+
+	void updateScores(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+			const FeatureFunction::State *state, std::vector<FeatureFunction::StateModifications *> &estmods,
+			Scores::const_iterator psbegin, const std::vector<Scores::iterator> &sbegins) const {
+		impl_->updateScores(doc, steps, state, estmods, psbegin, sbegins);
+	}
 	
 	uint getNumberOfScores() const {
-		return impl_->getNumberOfScores();
+		return numberOfScores_;
 	}
-	
+
+	bool dependsOn(uint aspects) const {
+		return (dependencies_ & aspects) != 0;
+	}
+
+	bool isSentenceLocal() const {
+		return sentenceLocal_;
+	}
+
+	bool hasSparseScores() const {
+		return sparse_;
+	}
+
+	void initSparseScores(const DocumentState &doc, SparseScores &scores) const {
+		impl_->initSparseScores(doc, scores);
+	}
+
+	void computeSparseScoreUpdate(const DocumentState &doc, const SearchStep &step, SparseScores &delta) const {
+		impl_->computeSparseScoreUpdate(doc, step, delta);
+	}
+
 	FeatureFunction::State *applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
 		return impl_->applyStateModifications(oldState, modif);
 	}
@@ -123,9 +223,11 @@ public:
 class FeatureFunctionFactory {
 private:
 	Random random_;
+	SparseFeatureRegistry &sparseFeatures_;
 
 public:
-	FeatureFunctionFactory(Random rnd) : random_(rnd) {}
+	FeatureFunctionFactory(Random rnd, SparseFeatureRegistry &sparseFeatures) :
+		random_(rnd), sparseFeatures_(sparseFeatures) {}
 
 	boost::shared_ptr<FeatureFunction> create(const std::string &type, const Parameters &params) const;
 };
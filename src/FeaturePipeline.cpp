@@ -0,0 +1,236 @@
+/*
+ *  FeaturePipeline.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "CountingFeatureFunction.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "FeaturePipeline.h"
+#include "GeometricDistortionModel.h"
+#include "NgramModel.h"
+#include "PerformanceCounters.h"
+#include "PhraseTable.h"
+#include "SearchAlgorithm.h"
+#include "SearchStep.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+class GenericFeatureDispatch {
+private:
+	const DecoderConfiguration::FeatureFunctionList &ff_;
+
+public:
+	GenericFeatureDispatch(const DecoderConfiguration::FeatureFunctionList &ff) : ff_(ff) {}
+
+	FeatureFunction::StateModifications *estimateScoreUpdate(uint i, const DocumentState &doc, const SearchStep &step,
+			const FeatureFunction::State *state, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+		return ff_[i].estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+	}
+
+	FeatureFunction::StateModifications *updateScore(uint i, const DocumentState &doc, const SearchStep &step,
+			const FeatureFunction::State *state, FeatureFunction::StateModifications *estmods,
+			Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+		return ff_[i].updateScore(doc, step, state, estmods, psbegin, sbegin);
+	}
+};
+
+// The type of each feature is determined once, when the pipeline is set up.
+// The calls are qualified, so the compiler can inline the counting features
+// and the distortion model; the phrase table and the n-gram model are still
+// called out of line, unless the decoder is built with link-time optimisation.
+template<class LanguageModel>
+class StandardFeatureDispatch {
+private:
+	enum Kind { PhraseTableFeature, NgramFeature, DistortionFeature, WordPenaltyFeature, OOVPenaltyFeature };
+
+	typedef CountingFeatureFunction<WordPenaltyCounter> WordPenalty_;
+	typedef CountingFeatureFunction<OOVPenaltyCounter> OOVPenalty_;
+
+	std::vector<Kind> kinds_;
+	std::vector<const FeatureFunction *> models_;
+
+public:
+	// Returns false if any of the features isn't a standard model with this LM type.
+	bool classify(const DecoderConfiguration::FeatureFunctionList &ff) {
+		kinds_.clear();
+		models_.clear();
+		for(uint i = 0; i < ff.size(); i++) {
+			const FeatureFunction *f = ff[i].getImplementation();
+			if(dynamic_cast<const PhraseTable *>(f))
+				kinds_.push_back(PhraseTableFeature);
+			else if(dynamic_cast<const LanguageModel *>(f))
+				kinds_.push_back(NgramFeature);
+			else if(dynamic_cast<const GeometricDistortionModel *>(f))
+				kinds_.push_back(DistortionFeature);
+			else if(dynamic_cast<const WordPenalty_ *>(f))
+				kinds_.push_back(WordPenaltyFeature);
+			else if(dynamic_cast<const OOVPenalty_ *>(f))
+				kinds_.push_back(OOVPenaltyFeature);
+			else
+				return false;
+			models_.push_back(f);
+		}
+		return true;
+	}
+
+	FeatureFunction::StateModifications *estimateScoreUpdate(uint i, const DocumentState &doc, const SearchStep &step,
+			const FeatureFunction::State *state, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+		const FeatureFunction *f = models_[i];
+		switch(kinds_[i]) {
+		case PhraseTableFeature:
+			return static_cast<const PhraseTable *>(f)->PhraseTable::estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		case NgramFeature:
+			return static_cast<const LanguageModel *>(f)->LanguageModel::estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		case DistortionFeature:
+			return static_cast<const GeometricDistortionModel *>(f)->GeometricDistortionModel::estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		case WordPenaltyFeature:
+			return static_cast<const WordPenalty_ *>(f)->WordPenalty_::estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		case OOVPenaltyFeature:
+			return static_cast<const OOVPenalty_ *>(f)->OOVPenalty_::estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		}
+		assert(false);
+		return NULL;
+	}
+
+	FeatureFunction::StateModifications *updateScore(uint i, const DocumentState &doc, const SearchStep &step,
+			const FeatureFunction::State *state, FeatureFunction::StateModifications *estmods,
+			Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+		const FeatureFunction *f = models_[i];
+		switch(kinds_[i]) {
+		case PhraseTableFeature:
+			return static_cast<const PhraseTable *>(f)->PhraseTable::updateScore(doc, step, state, estmods, psbegin, sbegin);
+		case NgramFeature:
+			return static_cast<const LanguageModel *>(f)->LanguageModel::updateScore(doc, step, state, estmods, psbegin, sbegin);
+		case DistortionFeature:
+			return static_cast<const GeometricDistortionModel *>(f)->GeometricDistortionModel::updateScore(doc, step, state, estmods, psbegin, sbegin);
+		case WordPenaltyFeature:
+			return static_cast<const WordPenalty_ *>(f)->WordPenalty_::updateScore(doc, step, state, estmods, psbegin, sbegin);
+		case OOVPenaltyFeature:
+			return static_cast<const OOVPenalty_ *>(f)->OOVPenalty_::updateScore(doc, step, state, estmods, psbegin, sbegin);
+		}
+		assert(false);
+		return NULL;
+	}
+};
+
+// The scoring loops of SearchStep, instantiated for each way of calling the
+// feature functions.
+template<class Dispatch>
+class DispatchingFeaturePipeline : public FeaturePipeline {
+private:
+	const DecoderConfiguration::FeatureFunctionList &ff_;
+	Dispatch dispatch_;
+	std::string description_;
+
+	void computeFeatureScore(const SearchStep &step, uint i) const;
+
+public:
+	DispatchingFeaturePipeline(const DecoderConfiguration::FeatureFunctionList &ff, const Dispatch &dispatch,
+			const std::string &description) :
+		ff_(ff), dispatch_(dispatch), description_(description) {}
+
+	virtual std::string getDescription() const {
+		return description_;
+	}
+
+	virtual void estimateScores(const SearchStep &step) const;
+	virtual bool computeScores(const SearchStep &step, const AcceptanceDecision *accept) const;
+};
+
+template<class Dispatch>
+void DispatchingFeaturePipeline<Dispatch>::estimateScores(const SearchStep &step) const {
+	const DocumentState &doc = step.document_;
+	Scores::const_iterator oldscoreit = doc.getScores().begin();
+	Scores::iterator scoreit = step.scores_.begin();
+	PerformanceCounters *perf = doc.getPerformanceCounters();
+	for(uint i = 0; i < ff_.size(); scoreit += ff_[i].getNumberOfScores(), oldscoreit += ff_[i].getNumberOfScores(), i++) {
+		// Features that don't depend on anything this step changes keep their
+		// old scores and state.
+		if(ff_[i].dependsOn(step.changedAspects_)) {
+			PerformanceCounters::Stopwatch watch(perf);
+			step.stateModifications_[i] = dispatch_.estimateScoreUpdate(i, doc, step, step.featureStates_[i], oldscoreit, scoreit);
+			if(perf) {
+				watch.stop();
+				watch.record(perf->getFeature(i).estimate);
+				watch.record(perf->getOperation(step.operation_).estimate);
+			}
+			step.score_ += step.getWeightedFeatureScore(i) - step.getWeightedFeatureScore(i, doc.getScores());
+		} else
+			std::copy(oldscoreit, oldscoreit + ff_[i].getNumberOfScores(), scoreit);
+	}
+}
+
+template<class Dispatch>
+bool DispatchingFeaturePipeline<Dispatch>::computeScores(const SearchStep &step, const AcceptanceDecision *accept) const {
+	const std::vector<uint> &cascade = *step.cascade_;
+	while(step.cascadePosition_ < cascade.size()) {
+		computeFeatureScore(step, cascade[step.cascadePosition_++]);
+		if(accept && !(*accept)(step.score_, step.logProposalRatio_))
+			return false;
+	}
+	return true;
+}
+
+template<class Dispatch>
+void DispatchingFeaturePipeline<Dispatch>::computeFeatureScore(const SearchStep &step, uint i) const {
+	const FeatureFunctionInstantiation &ff = ff_[i];
+	if(!ff.dependsOn(step.changedAspects_))
+		return;
+	const DocumentState &doc = step.document_;
+	uint idx = ff.getScoreIndex();
+	Float estimate = step.getWeightedFeatureScore(i);
+	PerformanceCounters *perf = doc.getPerformanceCounters();
+	PerformanceCounters::Stopwatch watch(perf);
+	bool timed = step.configuration_.sampleUpdateCost(i);
+	double start = timed ? getMonotonicTime() : .0;
+	step.stateModifications_[i] = dispatch_.updateScore(i, doc, step, step.featureStates_[i], step.stateModifications_[i],
+		doc.getScores().begin() + idx, step.scores_.begin() + idx);
+	if(timed)
+		step.configuration_.recordUpdateCost(i, getMonotonicTime() - start);
+	Float exact = step.getWeightedFeatureScore(i);
+	if(perf) {
+		watch.stop();
+		watch.record(perf->getFeature(i).update);
+		watch.record(perf->getOperation(step.operation_).update);
+		perf->recordScoreGap(i, estimate, exact);
+	}
+	step.score_ += exact - estimate;
+}
+
+FeaturePipeline *FeaturePipeline::create(const DecoderConfiguration::FeatureFunctionList &ff, bool specialise) {
+	if(specialise) {
+		StandardFeatureDispatch<NgramModel<lm::ngram::ProbingModel> > probing;
+		if(probing.classify(ff))
+			return new DispatchingFeaturePipeline<StandardFeatureDispatch<NgramModel<lm::ngram::ProbingModel> > >(
+				ff, probing, "standard models, probing LM");
+
+		StandardFeatureDispatch<NgramModel<lm::ngram::TrieModel> > trie;
+		if(trie.classify(ff))
+			return new DispatchingFeaturePipeline<StandardFeatureDispatch<NgramModel<lm::ngram::TrieModel> > >(
+				ff, trie, "standard models, trie LM");
+	}
+
+	return new DispatchingFeaturePipeline<GenericFeatureDispatch>(ff, GenericFeatureDispatch(ff), "generic");
+}
@@ -0,0 +1,59 @@
+/*
+ *  FeaturePipeline.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_FeaturePipeline_h
+#define docent_FeaturePipeline_h
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+
+#include <string>
+
+class AcceptanceDecision;
+class SearchStep;
+
+// Runs the feature functions on a search step. The generic pipeline calls
+// them through their virtual interface. For configurations made up of the
+// standard models only (phrase table, n-gram model, geometric distortion,
+// word and OOV penalties), a pipeline instantiated for their concrete types
+// is selected at startup, which calls them without virtual dispatch.
+class FeaturePipeline {
+public:
+	virtual ~FeaturePipeline() {}
+
+	virtual std::string getDescription() const = 0;
+
+	// Estimates the scores of all features that depend on what the step changes.
+	virtual void estimateScores(const SearchStep &step) const = 0;
+
+	// Computes the exact scores in the cascade order of the step, continuing
+	// from where the cascade has got to. If accept is given, returns false as
+	// soon as the step is rejected; the feature that rejected it is the last
+	// one computed.
+	virtual bool computeScores(const SearchStep &step, const AcceptanceDecision *accept) const = 0;
+
+	// Falls back to the generic pipeline if specialise is false or if the
+	// configuration contains other models.
+	static FeaturePipeline *create(const DecoderConfiguration::FeatureFunctionList &ff, bool specialise);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ *  GeometricDistortionModel.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_GeometricDistortionModel_h
+#define docent_GeometricDistortionModel_h
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "SearchStep.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+// The score updates are defined in the header so that the statically
+// dispatched feature pipeline can inline them.
+class GeometricDistortionModel : public FeatureFunction {
+private:
+	template<class Operator>
+	void scoreSegment(PhraseSegmentation::const_iterator from, PhraseSegmentation::const_iterator to,
+		Scores::iterator sbegin, Operator op) const;
+
+	Float computeDistortionDistance(const AnchoredPhrasePair &p1, const AnchoredPhrasePair &p2) const;
+	
+	Float distortionLimit_;
+
+public:
+	GeometricDistortionModel(const Parameters &params);
+
+	virtual State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
+	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
+	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
+		StateModifications *estmods, Scores::const_iterator, Scores::iterator estbegin) const;
+	
+	virtual uint getNumberOfScores() const {
+		return distortionLimit_ == -1 ? 1 : 2;
+	}
+
+	virtual uint getDependencies() const {
+		return SourceOrder;
+	}
+
+	virtual bool isSentenceLocal() const {
+		return true;
+	}
+
+	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
+};
+
+inline Float GeometricDistortionModel::computeDistortionDistance(const AnchoredPhrasePair &p1, const AnchoredPhrasePair &p2) const {
+	int jump = static_cast<int>(p2.getSourceStart()) - static_cast<int>(p1.getSourceEnd());
+	return static_cast<Float>(-std::abs(jump));
+}
+
+template<class Operator>
+inline void GeometricDistortionModel::scoreSegment(PhraseSegmentation::const_iterator from,
+		PhraseSegmentation::const_iterator to, Scores::iterator sbegin, Operator op) const {
+	if(from == to)
+		return;
+
+	PhraseSegmentation::const_iterator it1 = from;
+	PhraseSegmentation::const_iterator it2 = from;
+	++it2;
+	while(it2 != to) {
+		Float dist = computeDistortionDistance(*it1, *it2);
+		*sbegin = op(*sbegin, dist);
+		if(-dist > distortionLimit_)
+			(*(sbegin + 1)) = op(*(sbegin + 1), Float(-1));
+		it1 = it2;
+		++it2;
+	}
+}
+
+inline FeatureFunction::StateModifications *GeometricDistortionModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+	
+	std::copy(psbegin, psbegin + getNumberOfScores(), sbegin);
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		uint sentno = it->sentno;
+		PhraseSegmentation::const_iterator from_it = it->from_it;
+		PhraseSegmentation::const_iterator to_it = it->to_it;
+		const PhraseSegmentation &proposal = it->proposal;
+		const PhraseSegmentation &oldseg = doc.getPhraseSegmentation(sentno);
+
+		if(!proposal.empty()) {
+			if(from_it != oldseg.begin()) {
+				--from_it;
+				Float dist = computeDistortionDistance(*from_it, proposal.front());
+				*sbegin += dist;
+				if(-dist > distortionLimit_)
+					(*(sbegin + 1))--;
+			}
+
+			if(to_it != oldseg.end()) {
+				Float dist = computeDistortionDistance(proposal.back(), *to_it);
+				*sbegin += dist;
+				if(-dist > distortionLimit_)
+					(*(sbegin + 1))--;
+				++to_it;
+			}
+		} else if(from_it != oldseg.begin() && to_it != oldseg.end()) {
+			--from_it;
+			Float dist = computeDistortionDistance(*from_it, *to_it);
+			*sbegin += dist;
+			if(-dist > distortionLimit_)
+				(*(sbegin + 1))--;
+			++to_it;
+		}
+		
+		scoreSegment(from_it, to_it, sbegin, std::minus<Float>());
+		scoreSegment(proposal.begin(), proposal.end(), sbegin, std::plus<Float>());
+	}
+	return NULL;
+}
+
+inline FeatureFunction::StateModifications *GeometricDistortionModel::updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
+		FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
+	return estmods;
+}
+
+#endif
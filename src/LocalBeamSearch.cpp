@@ -46,13 +46,17 @@ struct LocalBeamSearchState : public SearchState {
 		beam.offer(doc);
 	}
 
+	uint getNumberOfSteps() const {
+		return nsteps;
+	}
+
 	const boost::shared_ptr<DocumentState>& getLastDocumentState() {
 		return beam.getBestDocumentState();
 	}
 };
 
 LocalBeamSearch::LocalBeamSearch(const DecoderConfiguration &config, const Parameters &params)
-		: logger_("LocalBeamSearch"), random_(config.getRandom()),
+		: SearchAlgorithm(params), logger_("LocalBeamSearch"), random_(config.getRandom()),
 		  generator_(config.getStateGenerator()) {
 	totalMaxSteps_ = params.get<uint>("max-steps");
 	maxRejected_ = params.get<uint>("max-rejected");
@@ -61,28 +65,35 @@ LocalBeamSearch::LocalBeamSearch(const DecoderConfiguration &config, const Param
 }
 
 SearchState *LocalBeamSearch::createState(boost::shared_ptr<DocumentState> doc) const {
-	return new LocalBeamSearchState(doc, beamSize_);
+	SearchState *state = new LocalBeamSearchState(doc, beamSize_);
+	setupState(state, *doc);
+	return state;
 }
 
 void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {
 	LocalBeamSearchState &state = dynamic_cast<LocalBeamSearchState &>(*sstate);
+	Random::ScopedStream stream(random_, state.getRandomStream());
 
 	using namespace boost::lambda;
 	std::for_each(state.beam.begin(), state.beam.end(), bind(&NbestStorage::offer, &nbest, _1));
 
 	uint accepted = 0;
 	uint i = 0;
+	bool timed = generator_.needsOutcomeTiming();
 	while(state.rejected < maxRejected_ && i < maxSteps && state.nsteps < totalMaxSteps_ &&
-			accepted < maxAccepted && nbest.getBestScore() < targetScore_) {
+			accepted < maxAccepted && nbest.getBestScore() < targetScore_ && !state.isTimeUp()) {
+		double start = timed ? getMonotonicTime() : .0;
 		AcceptanceDecision accept(state.beam.getLowestScore());
 		boost::shared_ptr<DocumentState> doc = state.beam.pickRandom(random_);
 		SearchStep *step = generator_.createSearchStep(*doc);
 		doc->registerAttemptedMove(step);
 		if(step->isProvisionallyAcceptable(accept)) {
-			if(accept(step->getScore())) {
+			if(step->isAcceptable(accept)) {
 				LOG(logger_, debug, "Accepting.");
 				boost::shared_ptr<DocumentState> clone =
 					boost::make_shared<DocumentState>(*doc);
+				generator_.registerOutcome(*doc, step, true, step->getScore() - doc->getScore(),
+					timed ? getMonotonicTime() - start : .0);
 				doc->applyModifications(step);
 				LOG(logger_, debug, *doc);
 				state.beam.offer(doc);
@@ -91,11 +102,13 @@ void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxS
 			} else {
 				LOG(logger_, debug, "Discarding.");
 				state.rejected++;
+				generator_.registerOutcome(*doc, step, false, 0, timed ? getMonotonicTime() - start : .0);
 				delete step;
 			}
 		} else {
 			LOG(logger_, debug, "Discarding.");
 			state.rejected++;
+			generator_.registerOutcome(*doc, step, false, 0, timed ? getMonotonicTime() - start : .0);
 			delete step;
 		}
 		i++;
@@ -118,6 +131,9 @@ void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxS
 	if(nbest.getBestScore() > targetScore_)
 		LOG(logger_, normal, "Found solution with better than target score.");
 
+	if(state.isTimeUp())
+		LOG(logger_, normal, "Time limit reached after " << state.nsteps << " steps.");
+
 	for(NbestStorage::const_iterator beamit = state.beam.begin(); beamit != state.beam.end(); ++beamit) {
 		const boost::shared_ptr<DocumentState> &doc = *beamit;
 		DocumentState::MoveCounts::const_iterator it = doc->getMoveCounts().begin();
@@ -22,26 +22,146 @@
 
 #include "Logger.h"
 
-Logger::IndexMap_ Logger::indices_;
-std::vector<LogLevel> Logger::levels_;
+#include <string>
+#include <vector>
 
-uint Logger::findChannel(const std::string &channel) {
-	uint idx;
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 
-	IndexMap_::const_iterator it = indices_.find(channel);
-	if(it == indices_.end()) {
-		idx = levels_.size();
-		levels_.push_back(normal);
-		indices_.insert(std::make_pair(channel, idx));
-	} else
-		idx = it->second;
+// Writes log messages to stderr in a background thread, so the search
+// threads don't wait for the terminal. If the terminal can't keep up, the
+// queue is capped and the threads that log wait until the writer has taken
+// the queued messages.
+class LogWriter {
+private:
+	static const uint MAX_QUEUED_MESSAGES = 4096;
 
-	return idx;
+	boost::mutex mutex_;
+	boost::condition_variable queued_;
+	boost::condition_variable dequeued_;
+	boost::condition_variable written_;
+	std::vector<std::string> queue_;
+	bool writing_;
+	bool stop_;
+	boost::scoped_ptr<boost::thread> thread_;
+
+	void run();
+	void waitUntilWritten(boost::mutex::scoped_lock &lock);
+
+public:
+	LogWriter() : writing_(false), stop_(false) {}
+	~LogWriter();
+
+	void write(const std::string &message);
+	void writeImmediately(const std::string &message);
+	void flush();
+};
+
+static LogWriter &logWriter() {
+	static LogWriter writer;
+	return writer;
+}
+
+LogWriter::~LogWriter() {
+	if(!thread_)
+		return;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		stop_ = true;
+	}
+	queued_.notify_one();
+	thread_->join();
+}
+
+void LogWriter::run() {
+	std::vector<std::string> batch;
+	boost::mutex::scoped_lock lock(mutex_);
+	for(;;) {
+		while(queue_.empty() && !stop_)
+			queued_.wait(lock);
+		if(queue_.empty())
+			return;
+
+		batch.swap(queue_);
+		writing_ = true;
+		dequeued_.notify_all();
+		lock.unlock();
+		for(std::vector<std::string>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+			std::cerr << *it;
+		std::cerr.flush();
+		batch.clear();
+		lock.lock();
+		writing_ = false;
+		written_.notify_all();
+	}
+}
+
+const uint LogWriter::MAX_QUEUED_MESSAGES;
+
+void LogWriter::write(const std::string &message) {
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if(!thread_)
+			thread_.reset(new boost::thread(&LogWriter::run, this));
+		while(queue_.size() >= MAX_QUEUED_MESSAGES)
+			dequeued_.wait(lock);
+		queue_.push_back(message);
+	}
+	queued_.notify_one();
+}
+
+void LogWriter::waitUntilWritten(boost::mutex::scoped_lock &lock) {
+	while(!queue_.empty() || writing_)
+		written_.wait(lock);
 }
 
-Logger::Logger(const std::string &channel) : index_(findChannel(channel)) {}
+// Used for errors, which often precede an exception that may end the program
+// before the writer thread gets to run.
+void LogWriter::writeImmediately(const std::string &message) {
+	boost::mutex::scoped_lock lock(mutex_);
+	waitUntilWritten(lock);
+	std::cerr << message;
+	std::cerr.flush();
+}
+
+void LogWriter::flush() {
+	boost::mutex::scoped_lock lock(mutex_);
+	waitUntilWritten(lock);
+}
+
+LogMessage::~LogMessage() {
+	stream_ << '\n';
+	if(level_ >= error)
+		logWriter().writeImmediately(stream_.str());
+	else
+		logWriter().write(stream_.str());
+}
+
+Logger::LevelMap_ &Logger::levels() {
+	static LevelMap_ levels;
+	return levels;
+}
+
+boost::mutex &Logger::mutex() {
+	static boost::mutex mutex;
+	return mutex;
+}
+
+LogLevel *Logger::findChannel(const std::string &channel) {
+	boost::mutex::scoped_lock lock(mutex());
+	return &levels().insert(std::make_pair(channel, normal)).first->second;
+}
+
+Logger::Logger(const std::string &channel) : level_(findChannel(channel)) {}
 
 void Logger::setLogLevel(const std::string &channel, LogLevel level) {
-	uint idx = findChannel(channel);
-	levels_[idx] = level;
+	if(level < DOCENT_LOG_THRESHOLD)
+		std::cerr << "Warning: Messages below the compile-time log threshold are not available for "
+			<< channel << ". Rebuild with a lower DOCENT_LOG_THRESHOLD to see them." << std::endl;
+	*findChannel(channel) = level;
+}
+
+void Logger::flush() {
+	logWriter().flush();
 }
@@ -26,8 +26,10 @@
 #include "Docent.h"
 
 #include <iostream>
+#include <map>
+#include <sstream>
 
-#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
 
 enum LogLevel {
 	debug,
@@ -36,34 +38,69 @@ enum LogLevel {
 	error
 };
 
+// Messages below this level are removed at compile time. Release builds
+// drop debug messages unless a different threshold is defined.
+#ifndef DOCENT_LOG_THRESHOLD
+#ifdef NDEBUG
+#define DOCENT_LOG_THRESHOLD verbose
+#else
+#define DOCENT_LOG_THRESHOLD debug
+#endif
+#endif
+
+// A handle to a log channel. Creating a logger looks up the channel in a
+// global table, so loggers of classes that are instantiated in the inner
+// loop of the search should be static members, which are resolved once at
+// static initialisation. Checking the level of a logger takes no lock.
 class Logger {
 private:
-	typedef boost::unordered_map<std::string,uint> IndexMap_;
-	static IndexMap_ indices_;
-	static std::vector<LogLevel> levels_;
+	// The map is node-based, so the level pointers held by existing loggers
+	// stay valid when new channels are added.
+	typedef std::map<std::string,LogLevel> LevelMap_;
+
+	const LogLevel *level_;
 
-	uint index_;
+	// function-local statics, so that loggers can be created during static initialisation
+	static LevelMap_ &levels();
+	static boost::mutex &mutex();
 
-	static uint findChannel(const std::string &channel);
+	static LogLevel *findChannel(const std::string &channel);
 
 public:
 	static void setLogLevel(const std::string &channel, LogLevel level);
 
+	// waits until all messages queued so far have been written
+	static void flush();
+
 	Logger(const std::string &channel);
 
 	bool loggable(LogLevel l) const {
-		return l >= levels_[index_];
+		return l >= DOCENT_LOG_THRESHOLD && l >= *level_;
 	}
+};
+
+// Collects one log message and hands it to the log writer thread when it
+// goes out of scope, so messages from different threads are never mixed up.
+// Error messages are written immediately.
+class LogMessage {
+private:
+	LogLevel level_;
+	std::ostringstream stream_;
+
+public:
+	explicit LogMessage(LogLevel level) : level_(level) {}
+	~LogMessage();
 
-	std::ostream &getLogStream() const {
-		return std::cerr;
+	std::ostream &getStream() {
+		return stream_;
 	}
 };
 
 // beware of double evaluation in the following macro
 #define LOG(logger, level, message) \
-	for(bool flagInLoggerMacro = (logger).loggable(level); flagInLoggerMacro; flagInLoggerMacro = false) \
-		(logger).getLogStream() << message << '\n'
+	for(bool flagInLoggerMacro = (level) >= DOCENT_LOG_THRESHOLD && (logger).loggable(level); \
+			flagInLoggerMacro; flagInLoggerMacro = false) \
+		LogMessage(level).getStream() << message
 
 // LOG_DEBUGBUILD can be used (sparingly) in places where even the loggability
 // check hurts performance noticeably.
@@ -0,0 +1,203 @@
+/*
+ *  MultiStartSearch.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "MultiStartSearch.h"
+#include "NbestStorage.h"
+#include "PerformanceCounters.h"
+#include "SearchAlgorithm.h"
+
+#include <limits>
+
+#include <boost/ref.hpp>
+
+MultiStartSearch::MultiStartSearch(const SearchAlgorithm &algorithm, const boost::shared_ptr<DocumentState> &doc,
+		uint chains, uint nbestSize) :
+		logger_("MultiStartSearch"), algorithm_(algorithm), busyChains_(0), stop_(false) {
+	if(chains == 0)
+		chains = 1;
+
+	Random random = doc->getDecoderConfiguration()->getRandom();
+
+	chains_.resize(chains);
+	for(uint i = 0; i < chains; i++) {
+		Chain_ &c = chains_[i];
+		// the first chain works on the document passed in, like single-chain search
+		if(i == 0)
+			c.document = doc;
+		else {
+			c.document.reset(new DocumentState(*doc));
+			c.document->separatePerformanceCounters();
+		}
+		c.state = algorithm.createState(c.document);
+		c.nbest = new NbestStorage(nbestSize);
+		// chain 0 gets the same stream as single-chain search
+		c.state->setRandomStream(random.createStream(doc->getDocumentNumber(), i));
+		c.finished = false;
+		c.pendingSteps = 0;
+	}
+}
+
+MultiStartSearch::~MultiStartSearch() {
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		stop_ = true;
+	}
+	sliceStarted_.notify_all();
+	workers_.join_all();
+
+	for(uint i = 0; i < chains_.size(); i++) {
+		delete chains_[i].state;
+		delete chains_[i].nbest;
+	}
+}
+
+void MultiStartSearch::restrictTimeLimit(double seconds) {
+	for(uint i = 0; i < chains_.size(); i++)
+		chains_[i].state->restrictTimeLimit(seconds);
+}
+
+void MultiStartSearch::runChain(Chain_ &chain, uint steps) const {
+	try {
+		uint stepsBefore = chain.state->getNumberOfSteps();
+		algorithm_.search(chain.state, *chain.nbest, steps, std::numeric_limits<uint>::max());
+		if(chain.state->getNumberOfSteps() - stepsBefore < steps)
+			chain.finished = true;
+	} catch(...) {
+		chain.error = boost::current_exception();
+		chain.finished = true;
+	}
+}
+
+void MultiStartSearch::runWorker(Chain_ &chain) {
+	boost::mutex::scoped_lock lock(mutex_);
+	for(;;) {
+		while(chain.pendingSteps == 0 && !stop_)
+			sliceStarted_.wait(lock);
+		if(stop_)
+			return;
+
+		uint steps = chain.pendingSteps;
+		lock.unlock();
+		runChain(chain, steps);
+		lock.lock();
+		chain.pendingSteps = 0;
+		if(--busyChains_ == 0)
+			sliceFinished_.notify_one();
+	}
+}
+
+bool MultiStartSearch::search(uint steps) {
+	if(steps == 0)
+		return !isFinished();
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if(workers_.size() == 0)
+			for(uint i = 0; i < chains_.size(); i++)
+				workers_.add_thread(new boost::thread(&MultiStartSearch::runWorker, this, boost::ref(chains_[i])));
+
+		for(uint i = 0; i < chains_.size(); i++)
+			if(!chains_[i].finished) {
+				chains_[i].pendingSteps = steps;
+				busyChains_++;
+			}
+		sliceStarted_.notify_all();
+		while(busyChains_ > 0)
+			sliceFinished_.wait(lock);
+	}
+
+	mergePerformanceCounters();
+
+	for(uint i = 0; i < chains_.size(); i++)
+		if(chains_[i].error)
+			boost::rethrow_exception(chains_[i].error);
+
+	cancelChains(algorithm_.getChainCancelMargin());
+
+	return !isFinished();
+}
+
+void MultiStartSearch::search() {
+	while(search(algorithm_.getChainSlice()))
+		;
+
+	LOG(logger_, verbose, "Search finished after " << getNumberOfSteps() << " steps in "
+		<< chains_.size() << " chains, best score " << getBestScore());
+}
+
+void MultiStartSearch::mergePerformanceCounters() {
+	PerformanceCounters *total = chains_[0].document->getPerformanceCounters();
+	if(total == NULL)
+		return;
+
+	for(uint i = 1; i < chains_.size(); i++) {
+		PerformanceCounters *perf = chains_[i].document->getPerformanceCounters();
+		*total += *perf;
+		perf->clear();
+	}
+}
+
+void MultiStartSearch::cancelChains(Float margin) {
+	if(margin == std::numeric_limits<Float>::infinity())
+		return;
+
+	// the best chain itself is never cancelled since margin >= 0
+	Float threshold = getBestScore() - margin;
+	for(uint i = 0; i < chains_.size(); i++) {
+		Chain_ &c = chains_[i];
+		if(!c.finished && c.nbest->getBestScore() < threshold) {
+			LOG(logger_, verbose, "Cancelling chain " << i << " with best score " << c.nbest->getBestScore()
+				<< " after " << c.state->getNumberOfSteps() << " steps.");
+			c.finished = true;
+		}
+	}
+}
+
+bool MultiStartSearch::isFinished() const {
+	for(uint i = 0; i < chains_.size(); i++)
+		if(!chains_[i].finished)
+			return false;
+	return true;
+}
+
+Float MultiStartSearch::getBestScore() const {
+	Float best = -std::numeric_limits<Float>::infinity();
+	for(uint i = 0; i < chains_.size(); i++)
+		best = std::max(best, chains_[i].nbest->getBestScore());
+	return best;
+}
+
+unsigned long MultiStartSearch::getNumberOfSteps() const {
+	unsigned long steps = 0;
+	for(uint i = 0; i < chains_.size(); i++)
+		steps += chains_[i].state->getNumberOfSteps();
+	return steps;
+}
+
+void MultiStartSearch::collectNbest(NbestStorage &nbest) const {
+	for(uint i = 0; i < chains_.size(); i++)
+		for(NbestStorage::const_iterator it = chains_[i].nbest->begin(); it != chains_[i].nbest->end(); ++it)
+			nbest.offer(*it);
+}
@@ -0,0 +1,109 @@
+/*
+ *  MultiStartSearch.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_MultiStartSearch_h
+#define docent_MultiStartSearch_h
+
+#include "Docent.h"
+
+#include <vector>
+
+#include <boost/exception_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class DocumentState;
+class NbestStorage;
+struct SearchAlgorithm;
+struct SearchState;
+
+// Runs several independent search chains on the same document in parallel
+// threads and keeps the best result. Each chain starts from a copy of the
+// initial state and draws its random numbers from a stream of its own, so the
+// result is the same no matter how many threads actually run at once. The
+// chains are run in slices; after each slice, chains whose best score has
+// fallen behind the best chain by more than the cancellation margin are
+// abandoned. A chain is finished when a slice ends before its steps are used
+// up, i.e. when the search algorithm has stopped on its own. Performance
+// counters are collected separately per chain and added to those of the
+// document passed in after each slice. Each chain keeps its worker thread
+// for all slices, so thread-specific caches survive from one slice to the next.
+class MultiStartSearch {
+private:
+	struct Chain_ {
+		boost::shared_ptr<DocumentState> document;
+		SearchState *state;
+		NbestStorage *nbest;
+		bool finished;
+		boost::exception_ptr error;
+		// steps of the current slice still to be run by the worker, 0 if idle
+		uint pendingSteps;
+	};
+
+	Logger logger_;
+	const SearchAlgorithm &algorithm_;
+	std::vector<Chain_> chains_;
+
+	// the workers are started by the first slice
+	boost::thread_group workers_;
+	boost::mutex mutex_;
+	boost::condition_variable sliceStarted_;
+	boost::condition_variable sliceFinished_;
+	uint busyChains_;
+	bool stop_;
+
+	void runWorker(Chain_ &chain);
+	void runChain(Chain_ &chain, uint steps) const;
+	void cancelChains(Float margin);
+	void mergePerformanceCounters();
+
+	MultiStartSearch(const MultiStartSearch &);
+	MultiStartSearch &operator=(const MultiStartSearch &);
+
+public:
+	MultiStartSearch(const SearchAlgorithm &algorithm, const boost::shared_ptr<DocumentState> &doc,
+		uint chains, uint nbestSize);
+	~MultiStartSearch();
+
+	// applies a time limit to all chains
+	void restrictTimeLimit(double seconds);
+
+	// Runs one slice of the given number of steps on each active chain.
+	// Returns false if all chains are finished.
+	bool search(uint steps);
+
+	// runs slices until all chains are finished
+	void search();
+
+	bool isFinished() const;
+	Float getBestScore() const;
+
+	// total number of steps taken by all chains
+	unsigned long getNumberOfSteps() const;
+
+	// offers the n-best lists of all chains to nbest
+	void collectNbest(NbestStorage &nbest) const;
+};
+
+#endif
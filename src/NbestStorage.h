@@ -57,6 +57,10 @@ public:
 	bool offer(const boost::shared_ptr<const DocumentState> &doc);
 	void copyNbestList(std::vector<boost::shared_ptr<const DocumentState> > &outvec) const;
 	
+	uint getMaxSize() const {
+		return maxSize_;
+	}
+
 	Float getBestScore() const {
 		return bestScore_;
 	}
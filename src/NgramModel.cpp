@@ -26,6 +26,7 @@
 #include "FeatureFunction.h"
 #include "NgramModel.h"
 //#include "NgramModelIrstlm.h"
+#include "PerformanceCounters.h"
 #include "PhrasePair.h"
 #include "PiecewiseIterator.h"
 #include "SearchStep.h"
@@ -35,63 +36,11 @@
 
 // from kenlm
 #include "lm/binary_format.hh"
-#include "lm/model.hh"
 
+#include <boost/cast.hpp>
 #include <boost/foreach.hpp>
-
-template<class M> struct NgramDocumentState;
-template<class M> struct NgramDocumentModifications;
-
-template<class Model>
-class NgramModel : public FeatureFunction {
-	friend class NgramModelFactory;
-	friend struct NgramDocumentState<NgramModel<Model> >;
-	friend struct NgramDocumentModifications<NgramModel<Model> >;
-
-private:
-	typedef typename Model::Vocabulary VocabularyType_;
-	typedef typename Model::State StateType_;
-
-	typedef NgramDocumentState<NgramModel<Model> > NgramDocumentState_;
-	typedef NgramDocumentModifications<NgramModel<Model> > NgramDocumentModifications_;
-
-	typedef std::pair<StateType_,Float> WordState_;
-	typedef std::vector<WordState_> SentenceState_;
-
-	mutable Logger logger_;
-
-	Model *model_;
-
-	NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag);
-
-	Float scoreNgram(const StateType_ &old_state, lm::WordIndex word, WordState_ &out_state) const;
-
-	template<bool ScoreCompleteSentence,class PhrasePairIterator,class StateIterator>
-	Float scorePhraseSegmentation(const StateType_ *last_state, PhrasePairIterator from_it,
-		PhrasePairIterator to_it, PhrasePairIterator eos,
-		StateIterator state_it, bool atEos = false) const;
-		
-	int annotationLevel_;
-	bool tokenFlag_;
-
-public:
-	virtual ~NgramModel();
-
-	virtual FeatureFunction::State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
-
-	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
-		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
-	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
-		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const;
-
-	virtual FeatureFunction::State *applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const;
-
-	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
-	
-	virtual uint getNumberOfScores() const {
-		return 1;
-	}
-};
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
 
 FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
 	std::string file = params.get<std::string>("lm-file");
@@ -99,6 +48,8 @@ FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
 
 	int annotationLevel = params.get<uint>("annotation-level", -1);
 	bool tokenFlag = params.get<bool>("token-flag", false);
+	uint wordCacheSize = params.get<uint>("word-cache-size", 65536);
+	uint phraseCacheSize = params.get<uint>("phrase-cache-size", 16384);
 
 
 	std::string smtype = params.get<std::string>("model-type", "");
@@ -126,19 +77,19 @@ FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
 			LOG(logger, error, "Incorrect LM type in configuration "
 				"for file " << file);
 
-		return new NgramModel<lm::ngram::ProbingModel>(file,annotationLevel,tokenFlag);
+		return new NgramModel<lm::ngram::ProbingModel>(file,annotationLevel,tokenFlag,wordCacheSize,phraseCacheSize);
 	case lm::ngram::TRIE_SORTED:
 		if(!smtype.empty() && smtype != "trie-sorted")
 			LOG(logger, error, "Incorrect LM type in configuration "
 				"for file " << file);
-		return new NgramModel<lm::ngram::TrieModel>(file,annotationLevel,tokenFlag);
+		return new NgramModel<lm::ngram::TrieModel>(file,annotationLevel,tokenFlag,wordCacheSize,phraseCacheSize);
 /*
 	case lm::ngram::QUANT_TRIE_SORTED:
 		if(!smtype.empty() && smtype != "quant-trie-sorted")
 			LOG(logger, error, "Incorrect LM type in configuration "
 				"for file " << file);
 
-		return new NgramModel<lm::ngram::QuantTrieModel>(file,annotationLevel,tokenFlag);
+		return new NgramModel<lm::ngram::QuantTrieModel>(file,annotationLevel,tokenFlag,wordCacheSize,phraseCacheSize);
 */
 	default:
 		LOG(logger, error, "Unsupported LM type for file " << file);
@@ -146,9 +97,14 @@ FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
 	}
 }
 
+// The LM states of a sentence are never modified in place, only replaced
+// as a whole when a modification is applied. They can therefore be shared
+// between copies of a document state, which makes cloning cheap and saves
+// most of the memory taken up by the copies kept in the n-best list and the
+// search beam.
 template<class M>
 struct NgramDocumentState : public FeatureFunction::State {
-	std::vector<typename M::SentenceState_> lmCache;
+	std::vector<boost::shared_ptr<const typename M::SentenceState_> > lmCache;
 	
 	virtual FeatureFunction::State *clone() const {
 		return new NgramDocumentState(*this);
@@ -166,9 +122,81 @@ struct NgramDocumentModifications : public FeatureFunction::StateModifications {
 	std::vector<std::pair<uint,typename M::SentenceState_> > modifications;
 };
 
+// Direct-mapped caches for LM queries, one per thread. The word cache maps
+// a context state and a word to the LM score and the resulting state, the
+// phrase cache maps a context state and a target phrase to the states and
+// scores of all words in the phrase. Rejected proposals make the decoder
+// score the same phrases in the same contexts over and over again.
+template<class M>
+struct NgramQueryCache {
+	typedef typename M::StateType_ StateType_;
+	typedef typename M::WordState_ WordState_;
+	typedef typename M::SentenceState_ SentenceState_;
+
+	struct WordEntry {
+		StateType_ context;
+		lm::WordIndex word;
+		bool valid;
+		WordState_ result;
+
+		WordEntry() : valid(false) {}
+	};
+
+	struct PhraseEntry {
+		StateType_ context;
+		const PhraseData *phrase;
+		Float score;
+		SentenceState_ result;
+
+		PhraseEntry() : phrase(NULL) {}
+	};
+
+	std::vector<WordEntry> words;
+	std::vector<PhraseEntry> phrases;
+
+	// scratch space for the vocabulary indices of a phrase and for the
+	// context words of independent queries
+	std::vector<lm::WordIndex> indices;
+	std::vector<lm::WordIndex> contextWords;
+
+	unsigned long wordLookups;
+	unsigned long wordHits;
+	unsigned long phraseLookups;
+	unsigned long phraseHits;
+
+	NgramQueryCache(uint wordCacheSize, uint phraseCacheSize) :
+		words(wordCacheSize), phrases(phraseCacheSize),
+		wordLookups(0), wordHits(0), phraseLookups(0), phraseHits(0) {}
+
+	void resetCounts() {
+		wordLookups = wordHits = phraseLookups = phraseHits = 0;
+	}
+
+	// adds the lookups and hits counted since the last reset to events
+	void reportCounts(PerformanceCounters::EventCounts &events) const {
+		events["word-cache-lookups"] += wordLookups;
+		events["word-cache-hits"] += wordHits;
+		events["phrase-cache-lookups"] += phraseLookups;
+		events["phrase-cache-hits"] += phraseHits;
+	}
+
+	WordEntry &findWord(const StateType_ &context, lm::WordIndex word) {
+		std::size_t seed = boost::hash<StateType_>()(context);
+		boost::hash_combine(seed, word);
+		return words[seed % words.size()];
+	}
+
+	PhraseEntry &findPhrase(const StateType_ &context, const PhraseData *phrase) {
+		std::size_t seed = boost::hash<StateType_>()(context);
+		boost::hash_combine(seed, phrase);
+		return phrases[seed % phrases.size()];
+	}
+};
+
 template<class Model>
-NgramModel<Model>::NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag) :
-		logger_("NgramModel") {
+NgramModel<Model>::NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag,
+		uint wordCacheSize, uint phraseCacheSize) :
+		logger_("NgramModel"), wordCacheSize_(wordCacheSize), phraseCacheSize_(phraseCacheSize) {
 	model_ = new Model(file.c_str());
 	annotationLevel_ = annotationLevel;
 	tokenFlag_ = tokenFlag;
@@ -181,6 +209,62 @@ NgramModel<M>::~NgramModel() {
 	delete model_;
 }
 
+template<class M>
+inline typename NgramModel<M>::NgramQueryCache_ &NgramModel<M>::getQueryCache() const {
+	NgramQueryCache_ *cache = queryCache_.get();
+	if(cache == NULL) {
+		cache = new NgramQueryCache_(wordCacheSize_, phraseCacheSize_);
+		queryCache_.reset(cache);
+	}
+	return *cache;
+}
+
+static inline void prefetch(const void *p) {
+#ifdef __GNUC__
+	__builtin_prefetch(p);
+#endif
+}
+
+// The vocabulary lookups for the words of a phrase are independent of each
+// other, so doing them all at once lets their cache misses overlap, which
+// isn't possible for the chain of LM queries that follows.
+template<class M>
+inline void NgramModel<M>::lookupWordIndices(const PhraseData &words, std::vector<lm::WordIndex> &out) const {
+	const VocabularyType_ &vocab = model_->GetVocabulary();
+	out.resize(words.size());
+	for(uint i = 0; i < words.size(); i++)
+		out[i] = vocab.Index(words[i]);
+}
+
+// Issues prefetches for the cache slots that the first query for a phrase in
+// the given context will touch. The phrase slot is requested first since
+// finding the word slot takes a vocabulary lookup.
+template<class M>
+inline void NgramModel<M>::prefetchQueries(NgramQueryCache_ &cache, const StateType_ &context, const PhraseData &words) const {
+	if(words.empty())
+		return;
+	if(!cache.phrases.empty())
+		prefetch(&cache.findPhrase(context, &words));
+	if(!cache.words.empty())
+		prefetch(&cache.findWord(context, model_->GetVocabulary().Index(words.front())));
+}
+
+// Prefetches the cache slots for the first query in each sentence modified by
+// a step.
+template<class M>
+void NgramModel<M>::prefetchStep(const DocumentState &doc, const SearchStep &step, const NgramDocumentState_ &state,
+		NgramQueryCache_ &cache) const {
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		if((it != mods.begin() && (it - 1)->sentno == it->sentno) || it->proposal.empty())
+			continue;
+		uint pos = doc.getTargetSentence(it->sentno).getPhraseStart(it->from);
+		const StateType_ &context = pos == 0 ? model_->BeginSentenceState() : (*state.lmCache[it->sentno])[pos - 1].first;
+		prefetchQueries(cache, context,
+			it->proposal.front().second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_).get());
+	}
+}
+
 template<class M>
 FeatureFunction::State *NgramModel<M>::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
 	NgramDocumentState_ *state = new NgramDocumentState_();
@@ -188,9 +272,10 @@ FeatureFunction::State *NgramModel<M>::initDocument(const DocumentState &doc, Sc
 	state->lmCache.resize(segs.size());
 	Float &s = *sbegin;
 	for(uint i = 0; i < segs.size(); i++) {
-		state->lmCache[i].resize(countTargetWords(segs[i].begin(), segs[i].end()) + 1); // one for </s>
+		SentenceState_ *sntstate = new SentenceState_(doc.getTargetSentence(i).size() + 1); // one for </s>
+		state->lmCache[i].reset(sntstate);
 		s += scorePhraseSegmentation<true>(&model_->BeginSentenceState(), segs[i].begin(),
-			segs[i].end(), segs[i].end(), state->lmCache[i].begin(), true);
+			segs[i].end(), segs[i].end(), sntstate->begin(), true);
 	}
 	return state;
 }
@@ -198,7 +283,7 @@ FeatureFunction::State *NgramModel<M>::initDocument(const DocumentState &doc, Sc
 template<class M>
 void NgramModel<M>::computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const {
 	const PhraseSegmentation &snt = doc.getPhraseSegmentation(sentno);
-	SentenceState_ state(countTargetWords(snt.begin(), snt.end()) + 1);
+	SentenceState_ state(doc.getTargetSentence(sentno).size() + 1);
 	*sbegin = scorePhraseSegmentation<true>(&model_->BeginSentenceState(), snt.begin(), snt.end(), snt.end(),
 		state.begin(), true);
 }
@@ -207,8 +292,24 @@ template<class M>
 FeatureFunction::StateModifications *NgramModel<M>::estimateScoreUpdate(const DocumentState &doc,
 		const SearchStep &step, const FeatureFunction::State *ffstate,
 		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const NgramDocumentState_ &state = dynamic_cast<const NgramDocumentState_ &>(*ffstate);
+	const NgramDocumentState_ &state = *boost::polymorphic_downcast<const NgramDocumentState_ *>(ffstate);
+	return estimateStep(doc, step, state, psbegin, sbegin);
+}
 
+template<class M>
+void NgramModel<M>::estimateScoreUpdates(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const FeatureFunction::State *ffstate, Scores::const_iterator psbegin,
+		const std::vector<Scores::iterator> &sbegins, std::vector<StateModifications *> &estmods) const {
+	const NgramDocumentState_ &state = *boost::polymorphic_downcast<const NgramDocumentState_ *>(ffstate);
+	estmods.resize(steps.size());
+	for(uint i = 0; i < steps.size(); i++)
+		estmods[i] = estimateStep(doc, *steps[i], state, psbegin, sbegins[i]);
+}
+
+template<class M>
+FeatureFunction::StateModifications *NgramModel<M>::estimateStep(const DocumentState &doc,
+		const SearchStep &step, const NgramDocumentState_ &state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
 	// copy scores and subtract those that will change so updateScore() only adds stuff
 	Float s = *psbegin;
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
@@ -217,28 +318,26 @@ FeatureFunction::StateModifications *NgramModel<M>::estimateScoreUpdate(const Do
 	while(it != mods.end()) {
 		LOG(logger_, debug, "next modification");
 		uint sentno = it->sentno;
-		PhraseSegmentation::const_iterator from_it = it->from_it;
-		PhraseSegmentation::const_iterator to_it = it->to_it;
-
-		const PhraseSegmentation &current = doc.getPhraseSegmentation(sentno);
-		uint clear_from = countTargetWords(current.begin(), from_it);
-		uint w_to = clear_from + countTargetWords(from_it, to_it);
+		const TargetSentence &current = doc.getTargetSentence(sentno);
+		uint clear_from = current.getPhraseStart(it->from);
+		uint w_to = current.getPhraseStart(it->to);
 		uint clear_to = w_to + model_->Order() - 1;
 
 		// don't clear further than to the start of the next modification
 		++it;
 		if(it != mods.end() && it->sentno == sentno) {
-			uint next_from = w_to + countTargetWords(to_it, it->from_it);
+			uint next_from = current.getPhraseStart(it->from);
 			if(next_from < clear_to)
 				clear_to = next_from;
 		}
 		// or the end of the sentence
-		if(clear_to > state.lmCache[sentno].size())
-			clear_to = state.lmCache[sentno].size();
+		const SentenceState_ &sntstate = *state.lmCache[sentno];
+		if(clear_to > sntstate.size())
+			clear_to = sntstate.size();
 
 		for(uint i = clear_from; i < clear_to; i++) {
-			LOG(logger_, debug, "*** minus " << state.lmCache[sentno][i].second);
-			s -= state.lmCache[sentno][i].second;
+			LOG(logger_, debug, "*** minus " << sntstate[i].second);
+			s -= sntstate[i].second;
 		}
 	}
 
@@ -250,17 +349,50 @@ template<class M>
 FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentState &doc,
 		const SearchStep &step, const FeatureFunction::State *ffstate,
 		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+	const NgramDocumentState_ &state = *boost::polymorphic_downcast<const NgramDocumentState_ *>(ffstate);
+	return updateStep(doc, step, state, getQueryCache(), estmods, psbegin, sbegin);
+}
+
+template<class M>
+void NgramModel<M>::updateScores(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const FeatureFunction::State *ffstate, std::vector<StateModifications *> &estmods,
+		Scores::const_iterator psbegin, const std::vector<Scores::iterator> &sbegins) const {
+	// The query chains of different steps are independent. The cache slots
+	// for the first queries of the steps ahead are fetched while the current
+	// step is being scored, so that their misses overlap with its work.
+	const uint PREFETCH_DISTANCE = 4;
+	const NgramDocumentState_ &state = *boost::polymorphic_downcast<const NgramDocumentState_ *>(ffstate);
+	NgramQueryCache_ &cache = getQueryCache();
+	for(uint i = 0; i < steps.size() && i < PREFETCH_DISTANCE; i++)
+		prefetchStep(doc, *steps[i], state, cache);
+	for(uint i = 0; i < steps.size(); i++) {
+		if(i + PREFETCH_DISTANCE < steps.size())
+			prefetchStep(doc, *steps[i + PREFETCH_DISTANCE], state, cache);
+		estmods[i] = updateStep(doc, *steps[i], state, cache, estmods[i], psbegin, sbegins[i]);
+	}
+}
+
+template<class M>
+FeatureFunction::StateModifications *NgramModel<M>::updateStep(const DocumentState &doc,
+		const SearchStep &step, const NgramDocumentState_ &state, NgramQueryCache_ &cache,
+		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
 	LOG(logger_, debug, "NgramModel::updateScore");
-	const NgramDocumentState_ &state = dynamic_cast<const NgramDocumentState_ &>(*ffstate);
 	Float &s = *sbegin;
 	Float estimated = s;
 
-	NgramDocumentPreviousScore *prevscore = dynamic_cast<NgramDocumentPreviousScore *>(estmods);
+	NgramDocumentPreviousScore *prevscore = boost::polymorphic_downcast<NgramDocumentPreviousScore *>(estmods);
 	s = prevscore->score;
 	delete prevscore;
 
 	NgramDocumentModifications_ *modif = new NgramDocumentModifications_();
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+
+	// the cache is shared by all documents the thread works on, so the hit
+	// rates are counted per update and added to the document's counters
+	PerformanceCounters *perf = doc.getPerformanceCounters();
+	if(perf)
+		cache.resetCounts();
+
 	std::vector<SearchStep::Modification>::const_iterator it1 = mods.begin();
 	while(it1 != mods.end()) {
 		uint sentno = it1->sentno;
@@ -270,15 +402,16 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 				break;
 
 		const PhraseSegmentation &current = doc.getPhraseSegmentation(sentno);
+		const TargetSentence &currentWords = doc.getTargetSentence(sentno);
 
 		modif->modifications.push_back(std::make_pair(sentno, SentenceState_()));
 		SentenceState_ &sntstate = modif->modifications.back().second;
-		sntstate.reserve(state.lmCache[sentno].size()); // an approximation
+		const SentenceState_ &oldsntstate = *state.lmCache[sentno];
+		sntstate.reserve(oldsntstate.size()); // an approximation
 
-		typename SentenceState_::const_iterator oldstate1 = state.lmCache[sentno].begin();
+		typename SentenceState_::const_iterator oldstate1 = oldsntstate.begin();
 		PhraseSegmentation::const_iterator next_from_it = it1->from_it;
-		typename SentenceState_::const_iterator oldstate2 = oldstate1 +
-			countTargetWords(current.begin(), next_from_it);
+		typename SentenceState_::const_iterator oldstate2 = oldstate1 + currentWords.getPhraseStart(it1->from);
 		sntstate.insert(sntstate.end(), oldstate1, oldstate2);
 
 		// keep a copy of the last state to avoid problems with invalidating iterators
@@ -299,12 +432,15 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 			const PhraseSegmentation &proposal = modit->proposal;
 
 			bool last_mod_in_sentence;
+			uint next_from;
 			if(modit + 1 != it2) {
 				last_mod_in_sentence = false;
 				next_from_it = (modit + 1)->from_it;
+				next_from = (modit + 1)->from;
 			} else {
 				last_mod_in_sentence = true;
 				next_from_it = current.end();
+				next_from = currentWords.getNumberOfPhrases();
 			}
 
 			uint pieceIndex = pieces.size();
@@ -314,7 +450,7 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 			pieces.push_back(next_from_it);
 
 			uint state_pos = sntstate.size();
-			oldstate1 = oldstate2 + countTargetWords(from_it, to_it);
+			oldstate1 = oldstate2 + currentWords.countWords(modit->from, modit->to);
 			
 			for(typename SentenceState_::const_iterator pit = oldstate2; pit != oldstate1; ++pit) {
 				LOG(logger_, debug, "(a) minus " << pit->second);
@@ -323,9 +459,9 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 			sntstate.insert(sntstate.end(), countTargetWords(proposal), WordState_());
 
 			if(last_mod_in_sentence)
-				oldstate2 = state.lmCache[sentno].end(); // also take along the </s> token
+				oldstate2 = oldsntstate.end(); // also take along the </s> token
 			else
-				oldstate2 = oldstate1 + countTargetWords(to_it, next_from_it);
+				oldstate2 = oldstate1 + currentWords.countWords(modit->to, next_from);
 
 			sntstate.insert(sntstate.end(), oldstate1, oldstate2);
 
@@ -343,6 +479,9 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 		}
 	}
 
+	if(perf)
+		cache.reportCounts(perf->getFeature(this).events);
+
 	assert(s <= estimated);
 	return modif;
 }
@@ -350,20 +489,101 @@ FeatureFunction::StateModifications *NgramModel<M>::updateScore(const DocumentSt
 template<class M>
 FeatureFunction::State *NgramModel<M>::applyStateModifications(FeatureFunction::State *oldState,
 		FeatureFunction::StateModifications *modif) const {
-	NgramDocumentState_ &state = dynamic_cast<NgramDocumentState_ &>(*oldState);
-	NgramDocumentModifications_ *mod = dynamic_cast<NgramDocumentModifications_ *>(modif);
+	NgramDocumentState_ &state = *boost::polymorphic_downcast<NgramDocumentState_ *>(oldState);
+	NgramDocumentModifications_ *mod = boost::polymorphic_downcast<NgramDocumentModifications_ *>(modif);
 	for(typename std::vector<std::pair<uint,SentenceState_> >::iterator it = mod->modifications.begin();
-			it != mod->modifications.end(); ++it)
-		state.lmCache[it->first].swap(it->second);
+			it != mod->modifications.end(); ++it) {
+		SentenceState_ *sntstate = new SentenceState_();
+		sntstate->swap(it->second);
+		state.lmCache[it->first].reset(sntstate);
+	}
 	return oldState;
 }
 
 template<class M>
-inline Float NgramModel<M>::scoreNgram(const StateType_ &state,
+inline bool NgramModel<M>::findCachedNgram(NgramQueryCache_ &cache, const StateType_ &state,
+		lm::WordIndex word, WordState_ &out_state) const {
+	if(cache.words.empty())
+		return false;
+
+	cache.wordLookups++;
+	typename NgramQueryCache_::WordEntry &entry = cache.findWord(state, word);
+	if(entry.valid && entry.word == word && entry.context == state) {
+		cache.wordHits++;
+		out_state = entry.result;
+		return true;
+	}
+	return false;
+}
+
+template<class M>
+inline void NgramModel<M>::storeCachedNgram(NgramQueryCache_ &cache, const StateType_ &state,
+		lm::WordIndex word, const WordState_ &result) const {
+	if(cache.words.empty())
+		return;
+
+	typename NgramQueryCache_::WordEntry &entry = cache.findWord(state, word);
+	entry.context = state;
+	entry.word = word;
+	entry.result = result;
+	entry.valid = true;
+}
+
+template<class M>
+inline Float NgramModel<M>::scoreNgram(NgramQueryCache_ &cache, const StateType_ &state,
 		lm::WordIndex word, WordState_ &out_state) const {
+	if(findCachedNgram(cache, state, word, out_state))
+		return out_state.second;
+
 	Float s = model_->Score(state, word, out_state.first);
 	s *= Float(2.30258509299405); // log10 -> ln
 	out_state.second = s;
+	storeCachedNgram(cache, state, word, out_state);
+	return s;
+}
+
+// Scores words [from, words.size()) of a phrase following the given context
+// state. Chaining the queries through the state returned by the previous one
+// makes each KenLM lookup wait for the hash table probes of the one before.
+// The context words of every query are already known, however, so the
+// queries are made with explicit context instead. They're independent of
+// each other, and the CPU can overlap the memory accesses of several
+// lookups. Since the LM state only drops context words that can't affect
+// later queries, the scores and states are the same.
+template<class M>
+template<class StateIterator>
+Float NgramModel<M>::scoreWords(NgramQueryCache_ &cache, const StateType_ &context,
+		const std::vector<lm::WordIndex> &words, uint from, StateIterator state_it) const {
+	uint n = words.size();
+	uint maxContext = model_->Order() - 1;
+
+	// the phrase words in reverse order, followed by those of the context state
+	std::vector<lm::WordIndex> &rcontext = cache.contextWords;
+	rcontext.clear();
+	for(uint i = n; i > from; i--)
+		rcontext.push_back(words[i - 1]);
+	rcontext.insert(rcontext.end(), context.words, context.words + context.Length());
+	const lm::WordIndex *rfirst = &rcontext[0];
+	const lm::WordIndex *rlast = rfirst + rcontext.size();
+
+	Float s = .0;
+	StateIterator out = state_it;
+	for(uint i = from; i < n; i++, ++out) {
+		// the words preceding word i, most recent first
+		const lm::WordIndex *rbegin = rfirst + (n - i);
+		const lm::WordIndex *rend = std::min(rbegin + maxContext, rlast);
+		Float lscore = model_->FullScoreForgotState(rbegin, rend, words[i], out->first).prob;
+		lscore *= Float(2.30258509299405); // log10 -> ln
+		out->second = lscore;
+		s += lscore;
+	}
+
+	const StateType_ *last_state = &context;
+	for(uint i = from; i < n; i++, ++state_it) {
+		storeCachedNgram(cache, *last_state, words[i], *state_it);
+		last_state = &state_it->first;
+	}
+
 	return s;
 }
 
@@ -372,6 +592,7 @@ template<bool ScoreCompleteSentence,class PhrasePairIterator,class StateIterator
 Float NgramModel<M>::scorePhraseSegmentation(const StateType_ *last_state, PhrasePairIterator from_it,
 		PhrasePairIterator to_it, PhrasePairIterator eos, StateIterator state_it, bool atEos) const {
 	const VocabularyType_ &vocab = model_->GetVocabulary();
+	NgramQueryCache_ &cache = getQueryCache();
 
 	PhrasePairIterator ng_it = from_it;
 
@@ -381,14 +602,57 @@ Float NgramModel<M>::scorePhraseSegmentation(const StateType_ *last_state, Phras
 	Float s = .0;
 	while(ng_it != to_it) {
 		LOG(logger_, debug, "running (a) loop");
-		for(PhraseData::const_iterator wi = ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_).get().begin();
-				wi != ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_).get().end(); ++wi) {
-			Float lscore = scoreNgram(*last_state, vocab.Index(*wi), *state_it);
-			// old score has already been subtracted
+		Phrase phrase = ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_);
+		const PhraseData &words = phrase.get();
+		if(words.empty()) {
+			++ng_it;
+			continue;
+		}
+
+		typename NgramQueryCache_::PhraseEntry *entry = NULL;
+		if(!cache.phrases.empty()) {
+			// flyweight values never move, so their address identifies the phrase
+			cache.phraseLookups++;
+			entry = &cache.findPhrase(*last_state, &words);
+			if(entry->phrase == &words && entry->context == *last_state) {
+				cache.phraseHits++;
+				// old scores have already been subtracted
+				state_it = std::copy(entry->result.begin(), entry->result.end(), state_it);
+				last_state = &(state_it - 1)->first;
+				s += entry->score;
+				LOG(logger_, debug, "(a) plus " << entry->score << " (cached phrase)");
+				++ng_it;
+				continue;
+			}
+			entry->phrase = NULL;
+			entry->context = *last_state;
+			entry->result.clear();
+		}
+
+		lookupWordIndices(words, cache.indices);
+		StateIterator phrase_it = state_it;
+		Float pscore = .0;
+		// old scores have already been subtracted
+		uint i = 0;
+		while(i < words.size() && findCachedNgram(cache, *last_state, cache.indices[i], *state_it)) {
+			pscore += state_it->second;
 			last_state = &state_it->first;
 			++state_it;
-			s += lscore;
-			LOG(logger_, debug, "(a) plus " << lscore << "\t" << *wi);
+			i++;
+		}
+		if(i < words.size()) {
+			pscore += scoreWords(cache, *last_state, cache.indices, i, state_it);
+			state_it += words.size() - i;
+			last_state = &(state_it - 1)->first;
+		}
+		LOG(logger_, debug, "(a) plus " << pscore << " for " << words.size() << " words");
+		s += pscore;
+		if(entry != NULL)
+			entry->result.assign(phrase_it, state_it);
+
+		if(entry != NULL) {
+			entry->phrase = &words;
+			entry->score = pscore;
 		}
 		++ng_it;
 	}
@@ -398,8 +662,8 @@ Float NgramModel<M>::scorePhraseSegmentation(const StateType_ *last_state, Phras
 	bool independent = false;
 	while(!ScoreCompleteSentence && ng_it != eos && !independent) {
 		LOG(logger_, debug, "running (b) loop");
-		for(PhraseData::const_iterator wi = ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_).get().begin();
-				wi != ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_).get().end(); ++wi) {
+		Phrase phrase = ng_it->second.get().getTargetPhraseOrAnnotations(annotationLevel_,tokenFlag_);
+		for(PhraseData::const_iterator wi = phrase.get().begin(); wi != phrase.get().end(); ++wi) {
 			if(future > last_state->Length() && future > last_statelen) {
 				LOG(logger_, debug, "breaking, future = " << future
 					<< ", last state size is " << uint(last_state->Length())
@@ -413,7 +677,7 @@ Float NgramModel<M>::scorePhraseSegmentation(const StateType_ *last_state, Phras
 			last_statelen = state_it->first.Length();
 			s -= state_it->second;
 			LOG(logger_, debug, "(b) minus " << state_it->second);
-			Float lscore = scoreNgram(*last_state, vocab.Index(*wi), *state_it);
+			Float lscore = scoreNgram(cache, *last_state, vocab.Index(*wi), *state_it);
 			last_state = &state_it->first;
 			++state_it;
 			s += lscore;
@@ -431,10 +695,15 @@ Float NgramModel<M>::scorePhraseSegmentation(const StateType_ *last_state, Phras
 			s -= state_it->second;
 			LOG(logger_, debug, "(c) minus " << state_it->second);
 		}
-		Float lscore = scoreNgram(*last_state, vocab.EndSentence(), *state_it);
+		Float lscore = scoreNgram(cache, *last_state, vocab.EndSentence(), *state_it);
 		s += lscore;
 		LOG(logger_, debug, "(c) plus " << lscore << "\t</s>");
 	}
 
 	return s;
 }
+
+// The feature pipeline calls the models directly, so the LM types it knows
+// about must be instantiated here.
+template class NgramModel<lm::ngram::ProbingModel>;
+template class NgramModel<lm::ngram::TrieModel>;
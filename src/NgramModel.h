@@ -24,9 +24,116 @@
 #define docent_NgramModel_h
 
 #include "FeatureFunction.h"
+#include "Logger.h"
+
+#include <string>
+#include <vector>
+
+// from kenlm
+#include "lm/model.hh"
+
+#include <boost/thread/tss.hpp>
 
 struct NgramModelFactory {
 	static FeatureFunction *createNgramModel(const Parameters &);
 };
 
+template<class M> struct NgramDocumentState;
+template<class M> struct NgramDocumentModifications;
+template<class M> struct NgramQueryCache;
+
+template<class Model>
+class NgramModel : public FeatureFunction {
+	friend class NgramModelFactory;
+	friend struct NgramDocumentState<NgramModel<Model> >;
+	friend struct NgramDocumentModifications<NgramModel<Model> >;
+	friend struct NgramQueryCache<NgramModel<Model> >;
+
+private:
+	typedef typename Model::Vocabulary VocabularyType_;
+	typedef typename Model::State StateType_;
+
+	typedef NgramDocumentState<NgramModel<Model> > NgramDocumentState_;
+	typedef NgramDocumentModifications<NgramModel<Model> > NgramDocumentModifications_;
+	typedef NgramQueryCache<NgramModel<Model> > NgramQueryCache_;
+
+	typedef std::pair<StateType_,Float> WordState_;
+	typedef std::vector<WordState_> SentenceState_;
+
+	mutable Logger logger_;
+
+	Model *model_;
+
+	uint wordCacheSize_;
+	uint phraseCacheSize_;
+	mutable boost::thread_specific_ptr<NgramQueryCache_> queryCache_;
+
+	NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag,
+		uint wordCacheSize, uint phraseCacheSize);
+
+	NgramQueryCache_ &getQueryCache() const;
+	void lookupWordIndices(const PhraseData &words, std::vector<lm::WordIndex> &out) const;
+	void prefetchQueries(NgramQueryCache_ &cache, const StateType_ &context, const PhraseData &words) const;
+	void prefetchStep(const DocumentState &doc, const SearchStep &step, const NgramDocumentState_ &state,
+		NgramQueryCache_ &cache) const;
+
+	StateModifications *estimateStep(const DocumentState &doc, const SearchStep &step, const NgramDocumentState_ &state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
+	StateModifications *updateStep(const DocumentState &doc, const SearchStep &step, const NgramDocumentState_ &state,
+		NgramQueryCache_ &cache, StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator sbegin) const;
+	Float scoreNgram(NgramQueryCache_ &cache, const StateType_ &old_state, lm::WordIndex word, WordState_ &out_state) const;
+	bool findCachedNgram(NgramQueryCache_ &cache, const StateType_ &old_state, lm::WordIndex word,
+		WordState_ &out_state) const;
+	void storeCachedNgram(NgramQueryCache_ &cache, const StateType_ &old_state, lm::WordIndex word,
+		const WordState_ &result) const;
+	template<class StateIterator>
+	Float scoreWords(NgramQueryCache_ &cache, const StateType_ &context, const std::vector<lm::WordIndex> &words,
+		uint from, StateIterator state_it) const;
+
+	template<bool ScoreCompleteSentence,class PhrasePairIterator,class StateIterator>
+	Float scorePhraseSegmentation(const StateType_ *last_state, PhrasePairIterator from_it,
+		PhrasePairIterator to_it, PhrasePairIterator eos,
+		StateIterator state_it, bool atEos = false) const;
+		
+	int annotationLevel_;
+	bool tokenFlag_;
+
+public:
+	virtual ~NgramModel();
+
+	virtual FeatureFunction::State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
+
+	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
+	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
+		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const;
+
+	virtual void estimateScoreUpdates(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, Scores::const_iterator psbegin, const std::vector<Scores::iterator> &sbegins,
+		std::vector<StateModifications *> &estmods) const;
+	virtual void updateScores(const DocumentState &doc, const std::vector<const SearchStep *> &steps,
+		const State *state, std::vector<StateModifications *> &estmods, Scores::const_iterator psbegin,
+		const std::vector<Scores::iterator> &sbegins) const;
+
+	virtual FeatureFunction::State *applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const;
+
+	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
+	
+	virtual uint getNumberOfScores() const {
+		return 1;
+	}
+
+	virtual uint getDependencies() const {
+		// annotations can differ between phrase pairs with the same target words
+		if(annotationLevel_ == -1)
+			return TargetWords | TargetSequence;
+		else
+			return PhrasePairs | TargetWords | TargetSequence;
+	}
+
+	virtual bool isSentenceLocal() const {
+		return true;
+	}
+};
+
 #endif
@@ -26,8 +26,9 @@
 #include "SearchStep.h"
 #include "OvixModel.h"
 
-#include <boost/lambda/lambda.hpp>
+#include <boost/cast.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/lambda/lambda.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <iostream>
@@ -105,28 +106,21 @@ void OvixModel::computeSentenceScores(const DocumentState &doc, uint sentno, Sco
 
 FeatureFunction::StateModifications *OvixModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																	Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const OvixModelState *prevstate = dynamic_cast<const OvixModelState *>(state);
+	const OvixModelState *prevstate = boost::polymorphic_downcast<const OvixModelState *>(state);
 	OvixModelState *s = prevstate->clone();
 
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
 	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-
-		// Do Nothing if it is a swap,s ince that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
-
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-		
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
+		PhraseSegmentation::const_iterator from_it = it->from_it;
+		PhraseSegmentation::const_iterator to_it = it->to_it;
 	
+		for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
+			s->removePhrasePair(*pit);	  
 		}
 	
+		BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
+			s->addPhrasePair(app);
+		}
 	}
 	
 	*sbegin = s->score();
@@ -139,8 +133,8 @@ FeatureFunction::StateModifications *OvixModel::updateScore(const DocumentState
 }
 
 FeatureFunction::State *OvixModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	OvixModelState *os = dynamic_cast<OvixModelState *>(oldState);
-	OvixModelState *ms = dynamic_cast<OvixModelState *>(modif);
+	OvixModelState *os = boost::polymorphic_downcast<OvixModelState *>(oldState);
+	OvixModelState *ms = boost::polymorphic_downcast<OvixModelState *>(modif);
 
 	os->types.swap(ms->types);
 	os->tokens = ms->tokens;
@@ -41,6 +41,10 @@ public:
 		return 1;
 	}
 
+	virtual uint getDependencies() const {
+		return TargetWords;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
@@ -0,0 +1,174 @@
+/*
+ *  PerformanceCounters.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "FeatureFunction.h"
+#include "PerformanceCounters.h"
+#include "StateGenerator.h"
+
+#include <iostream>
+
+const uint PerformanceCounters::cpuSampleInterval;
+
+PerformanceCounters::FeatureCounters &PerformanceCounters::FeatureCounters::operator+=(const FeatureCounters &o) {
+	estimate += o.estimate;
+	update += o.update;
+	apply += o.apply;
+	sparse += o.sparse;
+	cascadeRejections += o.cascadeRejections;
+	if(o.gapCount > 0 && (gapCount == 0 || o.gapMax > gapMax))
+		gapMax = o.gapMax;
+	gapCount += o.gapCount;
+	negativeGaps += o.negativeGaps;
+	gapSum += o.gapSum;
+	for(EventCounts::const_iterator it = o.events.begin(); it != o.events.end(); ++it)
+		events[it->first] += it->second;
+	return *this;
+}
+
+PerformanceCounters::OperationCounters &PerformanceCounters::OperationCounters::operator+=(const OperationCounters &o) {
+	propose += o.propose;
+	estimate += o.estimate;
+	update += o.update;
+	apply += o.apply;
+	failedProposals += o.failedProposals;
+	cacheHits += o.cacheHits;
+	cacheRejections += o.cacheRejections;
+	estimateRejections += o.estimateRejections;
+	exactRejections += o.exactRejections;
+	accepted += o.accepted;
+	return *this;
+}
+
+PerformanceCounters::PerformanceCounters(const DecoderConfiguration &config) :
+		configuration_(&config), features_(config.getFeatureFunctions().size()),
+		operations_(config.getStateGenerator().getNumberOfOperations()), cpuTick_(0) {}
+
+PerformanceCounters::FeatureCounters &PerformanceCounters::getFeature(const FeatureFunction *impl) {
+	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
+	uint i = 0;
+	while(ff[i].getImplementation() != impl)
+		i++;
+	return features_[i];
+}
+
+PerformanceCounters::OperationCounters &PerformanceCounters::getOperation(const StateOperation *op) {
+	return operations_[configuration_->getStateGenerator().getOperationIndex(op)];
+}
+
+PerformanceCounters &PerformanceCounters::operator+=(const PerformanceCounters &o) {
+	assert(configuration_ == o.configuration_);
+	for(uint i = 0; i < features_.size(); i++)
+		features_[i] += o.features_[i];
+	for(uint i = 0; i < operations_.size(); i++)
+		operations_[i] += o.operations_[i];
+	return *this;
+}
+
+void PerformanceCounters::clear() {
+	std::vector<FeatureCounters>(features_.size()).swap(features_);
+	std::vector<OperationCounters>(operations_.size()).swap(operations_);
+}
+
+static void writeJsonString(std::ostream &os, const std::string &s) {
+	os << '"';
+	for(std::string::const_iterator it = s.begin(); it != s.end(); ++it) {
+		if(*it == '"' || *it == '\\')
+			os << '\\' << *it;
+		else if(*it == '\n')
+			os << "\\n";
+		else if(*it == '\t')
+			os << "\\t";
+		else
+			os << *it;
+	}
+	os << '"';
+}
+
+static void writeJsonTiming(std::ostream &os, const char *name, const PerformanceCounters::Timing &t) {
+	os << ",\"" << name << "\":{\"calls\":" << t.calls << ",\"wall-ns\":" << t.wallNs
+		<< ",\"cpu-ns\":" << static_cast<boost::uint64_t>(t.getEstimatedCpuNs())
+		<< ",\"cpu-samples\":" << t.cpuSamples << '}';
+}
+
+// Features and operations are written in configuration order, so the output
+// of different runs can be compared line by line.
+void PerformanceCounters::writeJson(std::ostream &os, const std::string &scope, int document) const {
+	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
+	const StateGenerator &generator = configuration_->getStateGenerator();
+
+	os << "{\"scope\":";
+	writeJsonString(os, scope);
+	if(document >= 0)
+		os << ",\"document\":" << document;
+
+	os << ",\"features\":[";
+	for(uint i = 0; i < features_.size(); i++) {
+		const FeatureCounters &f = features_[i];
+		if(i > 0)
+			os << ',';
+		os << "{\"id\":";
+		writeJsonString(os, ff[i].getId());
+		writeJsonTiming(os, "estimate", f.estimate);
+		writeJsonTiming(os, "update", f.update);
+		writeJsonTiming(os, "apply", f.apply);
+		if(ff[i].hasSparseScores())
+			writeJsonTiming(os, "sparse", f.sparse);
+		os << ",\"cascade-rejections\":" << f.cascadeRejections
+			<< ",\"score-gap\":{\"count\":" << f.gapCount
+			<< ",\"mean\":" << (f.gapCount == 0 ? .0 : f.gapSum / f.gapCount)
+			<< ",\"max\":" << f.gapMax
+			<< ",\"negative\":" << f.negativeGaps << '}';
+		if(!f.events.empty()) {
+			os << ",\"events\":{";
+			for(EventCounts::const_iterator it = f.events.begin(); it != f.events.end(); ++it) {
+				if(it != f.events.begin())
+					os << ',';
+				writeJsonString(os, it->first);
+				os << ':' << it->second;
+			}
+			os << '}';
+		}
+		os << '}';
+	}
+
+	os << "],\"operations\":[";
+	for(uint i = 0; i < operations_.size(); i++) {
+		const OperationCounters &o = operations_[i];
+		if(i > 0)
+			os << ',';
+		os << "{\"operation\":";
+		writeJsonString(os, generator.getOperation(i).getDescription());
+		writeJsonTiming(os, "propose", o.propose);
+		writeJsonTiming(os, "estimate", o.estimate);
+		writeJsonTiming(os, "update", o.update);
+		writeJsonTiming(os, "apply", o.apply);
+		os << ",\"failed-proposals\":" << o.failedProposals
+			<< ",\"cache-hits\":" << o.cacheHits
+			<< ",\"cache-rejections\":" << o.cacheRejections
+			<< ",\"estimate-rejections\":" << o.estimateRejections
+			<< ",\"exact-rejections\":" << o.exactRejections
+			<< ",\"accepted\":" << o.accepted << '}';
+	}
+	os << "]}" << std::endl;
+}
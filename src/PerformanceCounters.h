@@ -0,0 +1,215 @@
+/*
+ *  PerformanceCounters.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_PerformanceCounters_h
+#define docent_PerformanceCounters_h
+
+#include "Docent.h"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include <boost/cstdint.hpp>
+
+class DecoderConfiguration;
+class FeatureFunction;
+class StateOperation;
+
+// Call counts, timings and rejection statistics per feature function and
+// per state operation, for finding out where decoding time goes. Counting is
+// enabled in the decoder configuration; documents then carry a set of
+// counters that is shared by all their copies. The counters aren't
+// synchronised, so concurrent search chains need counters of their own.
+class PerformanceCounters {
+public:
+	// Wall time is measured on every call. Reading the thread CPU clock is
+	// more expensive, so it's only done for one call in cpuSampleInterval
+	// and the total extrapolated from the sampled calls.
+	static const uint cpuSampleInterval = 16;
+
+	struct Timing {
+		unsigned long calls;
+		boost::uint64_t wallNs;
+		unsigned long cpuSamples;
+		boost::uint64_t cpuNs;
+
+		Timing() : calls(0), wallNs(0), cpuSamples(0), cpuNs(0) {}
+
+		Timing &operator+=(const Timing &o) {
+			calls += o.calls;
+			wallNs += o.wallNs;
+			cpuSamples += o.cpuSamples;
+			cpuNs += o.cpuNs;
+			return *this;
+		}
+
+		// CPU time extrapolated to all calls
+		double getEstimatedCpuNs() const {
+			return cpuSamples == 0 ? .0 : double(cpuNs) * calls / cpuSamples;
+		}
+	};
+
+	// counts of events specific to a feature function, like cache hits, by name
+	typedef std::map<std::string,unsigned long> EventCounts;
+
+	struct FeatureCounters {
+		Timing estimate;
+		Timing update;
+		Timing apply;
+		Timing sparse;
+		// steps rejected by the cascade right after this feature's exact update
+		unsigned long cascadeRejections;
+		// weighted estimate minus weighted exact score of each exact update
+		unsigned long gapCount;
+		unsigned long negativeGaps;
+		double gapSum;
+		double gapMax;
+		EventCounts events;
+
+		FeatureCounters() : cascadeRejections(0), gapCount(0), negativeGaps(0), gapSum(0), gapMax(0) {}
+
+		FeatureCounters &operator+=(const FeatureCounters &o);
+	};
+
+	struct OperationCounters {
+		Timing propose;
+		Timing estimate;
+		Timing update;
+		Timing apply;
+		// proposals that were NULL or empty and had to be drawn again
+		unsigned long failedProposals;
+		// proposals found in the document's proposal cache
+		unsigned long cacheHits;
+		unsigned long cacheRejections;
+		unsigned long estimateRejections;
+		unsigned long exactRejections;
+		unsigned long accepted;
+
+		OperationCounters() : failedProposals(0), cacheHits(0), cacheRejections(0), estimateRejections(0),
+			exactRejections(0), accepted(0) {}
+
+		OperationCounters &operator+=(const OperationCounters &o);
+	};
+
+	// Measures the time between its construction and the call to stop().
+	// Constructed with a NULL pointer, it does nothing, so instrumented code
+	// costs a single test when counting is disabled.
+	class Stopwatch {
+	private:
+		bool running_;
+		bool sampleCpu_;
+		boost::uint64_t wallNs_;
+		boost::uint64_t cpuNs_;
+
+		static boost::uint64_t readClock(clockid_t clock) {
+			timespec ts;
+			clock_gettime(clock, &ts);
+			return boost::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+
+	public:
+		explicit Stopwatch(PerformanceCounters *counters) :
+				running_(counters != NULL), sampleCpu_(false), wallNs_(0), cpuNs_(0) {
+			if(!running_)
+				return;
+			sampleCpu_ = counters->sampleCpu();
+			if(sampleCpu_)
+				cpuNs_ = readClock(CLOCK_THREAD_CPUTIME_ID);
+			wallNs_ = readClock(CLOCK_MONOTONIC);
+		}
+
+		void stop() {
+			if(!running_)
+				return;
+			wallNs_ = readClock(CLOCK_MONOTONIC) - wallNs_;
+			if(sampleCpu_)
+				cpuNs_ = readClock(CLOCK_THREAD_CPUTIME_ID) - cpuNs_;
+			running_ = false;
+		}
+
+		// Adds the measured time, divided into parts equal shares, to t as
+		// the given number of calls. Must be called after stop().
+		void record(Timing &t, unsigned long calls = 1, uint parts = 1) const {
+			t.calls += calls;
+			t.wallNs += wallNs_ / parts;
+			if(sampleCpu_) {
+				t.cpuSamples += calls;
+				t.cpuNs += cpuNs_ / parts;
+			}
+		}
+	};
+
+private:
+	const DecoderConfiguration *configuration_;
+	std::vector<FeatureCounters> features_;
+	// indexed by the position of the operation in the configuration
+	std::vector<OperationCounters> operations_;
+	uint cpuTick_;
+
+	bool sampleCpu() {
+		if(++cpuTick_ < cpuSampleInterval)
+			return false;
+		cpuTick_ = 0;
+		return true;
+	}
+
+public:
+	PerformanceCounters(const DecoderConfiguration &config);
+
+	FeatureCounters &getFeature(uint i) {
+		return features_[i];
+	}
+
+	// the counters of the feature function with the given implementation,
+	// for feature functions that count events of their own
+	FeatureCounters &getFeature(const FeatureFunction *impl);
+
+	OperationCounters &getOperation(uint i) {
+		return operations_[i];
+	}
+
+	OperationCounters &getOperation(const StateOperation *op);
+
+	void recordScoreGap(uint i, Float estimate, Float exact) {
+		FeatureCounters &f = features_[i];
+		Float gap = estimate - exact;
+		f.gapCount++;
+		f.gapSum += gap;
+		if(gap < 0)
+			f.negativeGaps++;
+		if(f.gapCount == 1 || gap > f.gapMax)
+			f.gapMax = gap;
+	}
+
+	PerformanceCounters &operator+=(const PerformanceCounters &o);
+	void clear();
+
+	// Writes the counters as a single line of JSON. scope says what they
+	// cover, document is output along with it unless it's negative.
+	void writeJson(std::ostream &os, const std::string &scope, int document = -1) const;
+};
+
+#endif
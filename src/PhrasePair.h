@@ -32,6 +32,7 @@
 #include <boost/iterator_adaptors.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
+#include <boost/serialization/nvp.hpp>
 #include <boost/serialization/split_member.hpp>
 
 class PhraseTable;
@@ -231,7 +232,67 @@ public:
 std::size_t hash_value(const PhrasePairData &p);
 
 typedef boost::flyweight<PhrasePairData,boost::flyweights::no_tracking> PhrasePair;
-typedef std::pair<CoverageBitmap,PhrasePair> AnchoredPhrasePair;
+// A phrase pair anchored at a source span. The first position of the span and
+// the position after its last one are cached, since distortion scoring and the
+// ordering of phrase pairs look them up all the time. The coverage must not
+// be modified after construction.
+struct AnchoredPhrasePair : public std::pair<CoverageBitmap,PhrasePair> {
+private:
+	uint sourceStart_;
+	uint sourceEnd_;
+
+	void updateSpan() {
+		CoverageBitmap::size_type start = first.find_first();
+		if(start == CoverageBitmap::npos)
+			sourceStart_ = sourceEnd_ = 0;
+		else {
+			sourceStart_ = start;
+			sourceEnd_ = first.find_last() + 1;
+		}
+	}
+
+	friend class boost::serialization::access;
+
+	// same format as std::pair, so saved states stay readable
+	template<class Archive>
+	void save(Archive &ar, const unsigned int version) const {
+		ar & boost::serialization::make_nvp("first", first);
+		ar & boost::serialization::make_nvp("second", second);
+	}
+
+	template<class Archive>
+	void load(Archive &ar, const unsigned int version) {
+		ar & boost::serialization::make_nvp("first", first);
+		ar & boost::serialization::make_nvp("second", second);
+		updateSpan();
+	}
+
+	BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+public:
+	AnchoredPhrasePair() : sourceStart_(0), sourceEnd_(0) {}
+
+	AnchoredPhrasePair(const CoverageBitmap &coverage, const PhrasePair &phrasePair) :
+			std::pair<CoverageBitmap,PhrasePair>(coverage, phrasePair) {
+		updateSpan();
+	}
+
+	AnchoredPhrasePair(const std::pair<CoverageBitmap,PhrasePair> &p) :
+			std::pair<CoverageBitmap,PhrasePair>(p) {
+		updateSpan();
+	}
+
+	// first covered source position
+	uint getSourceStart() const {
+		return sourceStart_;
+	}
+
+	// source position after the last covered one
+	uint getSourceEnd() const {
+		return sourceEnd_;
+	}
+};
+
 typedef std::list<AnchoredPhrasePair> PhraseSegmentation;
 
 template<class PhrasePairIterator>
@@ -24,7 +24,10 @@
 #include "Random.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+#include <map>
+#include <numeric>
 
 #include <boost/function.hpp>
 #include <boost/iterator/filter_iterator.hpp>
@@ -49,6 +52,12 @@ PhraseSegmentation PhrasePairCollection::proposeSegmentation() const {
 }
 
 PhraseSegmentation PhrasePairCollection::proposeSegmentation(const CoverageBitmap &range) const {
+	return proposeSegmentation(range, std::vector<Float>(), Float(0));
+}
+
+// An empty weight vector selects the uniform proposal distribution.
+PhraseSegmentation PhrasePairCollection::proposeSegmentation(const CoverageBitmap &range,
+		const std::vector<Float> &weights, Float temperature) const {
 	using namespace boost::lambda;
 
 	assert(range.size() == sentenceLength_);
@@ -63,10 +72,10 @@ PhraseSegmentation PhrasePairCollection::proposeSegmentation(const CoverageBitma
 		std::remove_copy_if(phrasePairList_.begin(), phrasePairList_.end(), std::back_inserter(ppairs),
 			!bind(&CoverageBitmap::is_subset_of, bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _1), range));
 		std::sort(ppairs.begin(), ppairs.end(),
-			bind(&CoverageBitmap::find_first, bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _1)) <
-				bind(&CoverageBitmap::find_first, bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _2)));
+			bind(&AnchoredPhrasePair::getSourceStart, _1) < bind(&AnchoredPhrasePair::getSourceStart, _2));
 
-		success = proposeSegmentationLeftRight(range, ppairs.begin(), ppairs.end(), seg);
+		success = proposeSegmentationLeftRight(range, ppairs.begin(), ppairs.end(),
+			weights.empty() ? NULL : &weights, temperature, seg);
 	//}
 
 	assert(success); // TODO: should throw here
@@ -77,7 +86,7 @@ PhraseSegmentation PhrasePairCollection::proposeSegmentation(const CoverageBitma
 
 bool PhrasePairCollection::proposeSegmentationLeftRight(const CoverageBitmap &range,
 		std::vector<AnchoredPhrasePair>::const_iterator startit, std::vector<AnchoredPhrasePair>::const_iterator endit,
-		PhraseSegmentation &seg) const {
+		const std::vector<Float> *weights, Float temperature, PhraseSegmentation &seg) const {
 	using namespace boost::lambda;
 
 	LOG(logger_, verbose, "proposeSegmentation " << range);
@@ -100,17 +109,34 @@ bool PhrasePairCollection::proposeSegmentationLeftRight(const CoverageBitmap &ra
 
 	if(it1 == endit) {
 		LOG(logger_, debug, "firstBit = " << firstBit);
-		LOG(logger_, debug, "startit->find_first() = " << startit->first.find_first());
+		LOG(logger_, debug, "startit->getSourceStart() = " << startit->getSourceStart());
 		LOG(logger_, debug, "No matching phrase pair.");
 		return false;
 	}
 
 	std::vector<AnchoredPhrasePair>::const_iterator it2 = std::find_if(it1, endit,
-		bind(&CoverageBitmap::find_first, bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _1)) > firstBit);
+		bind(&AnchoredPhrasePair::getSourceStart, _1) > firstBit);
 	uint noptions = std::distance(it1, it2);
 	uint choice;
 	std::vector<AnchoredPhrasePair>::const_iterator ph;
 	CoverageBitmap badChoices(noptions);
+
+	std::vector<Float> optionWeights;
+	std::vector<Float> cumulativeWeights;
+	Float remainingWeight = Float(0);
+	if(weights) {
+		optionWeights.reserve(noptions);
+		for(ph = it1; ph != it2; ++ph)
+			optionWeights.push_back(computeProposalLogWeight(ph->second, *weights, temperature));
+		Float maxWeight = *std::max_element(optionWeights.begin(), optionWeights.end());
+		cumulativeWeights.reserve(noptions);
+		for(std::vector<Float>::iterator it = optionWeights.begin(); it != optionWeights.end(); ++it) {
+			*it = std::exp(*it - maxWeight);
+			remainingWeight += *it;
+			cumulativeWeights.push_back(remainingWeight);
+		}
+	}
+
 	bool done = false;
 	do {
 		if(badChoices.count() == noptions) {
@@ -118,9 +144,14 @@ bool PhrasePairCollection::proposeSegmentationLeftRight(const CoverageBitmap &ra
 			return false;
 		}
 
-		do {
-			choice = random_.drawFromRange(noptions);
-		} while(badChoices.test(choice));
+		if(weights) {
+			choice = random_.drawFromRemainingOptions(optionWeights, cumulativeWeights, badChoices, remainingWeight);
+			remainingWeight -= optionWeights[choice];
+		} else {
+			do
+				choice = random_.drawFromRange(noptions);
+			while(badChoices.test(choice));
+		}
 		badChoices.set(choice);
 		ph = it1 + choice;
 		
@@ -132,16 +163,13 @@ bool PhrasePairCollection::proposeSegmentationLeftRight(const CoverageBitmap &ra
 		}
 
 		LOG(logger_, debug, "selected            " << ph->first);
-		CoverageBitmap::size_type i = firstBit, next;
-		LOG(logger_, debug, "First bit: " << i);
-		while((next = ph->first.find_next(i)) == i + 1) // find first gap in phrase
-			i = next;
-		i++;
+		// phrases cover contiguous spans starting at firstBit
+		uint i = ph->getSourceEnd();
 		LOG(logger_, debug, "Next unset bit: " << i);
 		std::vector<AnchoredPhrasePair>::const_iterator it2new = std::find_if(it2, endit,
-			bind(&CoverageBitmap::find_first, bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _1)) >= i);
+			bind(&AnchoredPhrasePair::getSourceStart, _1) >= i);
 		
-		done = proposeSegmentationLeftRight(range - ph->first, it2new, endit, seg);
+		done = proposeSegmentationLeftRight(range - ph->first, it2new, endit, weights, temperature, seg);
 	} while(!done);
 
 	LOG(logger_, debug, "Proposing " << *ph);
@@ -183,17 +211,8 @@ bool PhrasePairCollection::proposeSegmentationRandomChoice(CoverageBitmap range,
 }
 
 const AnchoredPhrasePair &PhrasePairCollection::proposeAlternativeTranslation(const AnchoredPhrasePair &old) const {
-	using namespace boost::lambda;
-	
-	typedef boost::function<bool(const AnchoredPhrasePair &)> FilterPred;
-	FilterPred filterPredicate = bind<const CoverageBitmap &>(&AnchoredPhrasePair::first, _1) == old.first;
-	boost::filter_iterator<FilterPred,PhraseSegmentation::const_iterator> fit1 =
-		boost::make_filter_iterator(filterPredicate, phrasePairList_.begin(), phrasePairList_.end());
-	boost::filter_iterator<FilterPred,PhraseSegmentation::const_iterator> fit2 =
-		boost::make_filter_iterator(filterPredicate, phrasePairList_.end(), phrasePairList_.end());
-
 	std::vector<const AnchoredPhrasePair *> sublist;
-	std::transform(fit1, fit2, std::back_inserter(sublist), &_1);
+	getAlternativeTranslations(old, sublist);
 	if(sublist.size() == 0)
 		return old;
 	
@@ -201,6 +220,137 @@ const AnchoredPhrasePair &PhrasePairCollection::proposeAlternativeTranslation(co
 	return *sublist[phidx];
 }
 
+Float PhrasePairCollection::computeProposalLogWeight(const PhrasePair &phrasePair,
+		const std::vector<Float> &weights, Float temperature) {
+	const Scores &scores = phrasePair.get().getScores();
+	return std::inner_product(weights.begin(), weights.end(), scores.begin(), Float(0)) / temperature;
+}
+
+// Called by the phrase table once all phrase pairs have been added.
+void PhrasePairCollection::indexSpans(const std::vector<Float> &proposalWeights,
+		const std::vector<Float> &proposalTemperatures) {
+	proposalWeights_ = proposalWeights;
+	proposalTemperatures_ = proposalTemperatures;
+
+	typedef std::map<std::pair<uint,uint>,std::vector<const AnchoredPhrasePair *> > SpanMap;
+	SpanMap spans;
+	for(PhrasePairList_::const_iterator it = phrasePairList_.begin(); it != phrasePairList_.end(); ++it)
+		spans[std::make_pair(it->getSourceStart(), it->getSourceEnd())].push_back(&*it);
+
+	spans_.clear();
+	spans_.reserve(spans.size());
+	firstSpan_.assign(sentenceLength_ + 1, 0);
+	for(SpanMap::const_iterator it = spans.begin(); it != spans.end(); ++it) {
+		spans_.push_back(Span_());
+		Span_ &span = spans_.back();
+		span.start = it->first.first;
+		span.end = it->first.second;
+		span.candidates = it->second;
+		span.proposalDistributions.resize(proposalTemperatures_.size());
+		for(uint i = 0; i < proposalTemperatures_.size(); i++)
+			buildProposalDistribution(span.candidates, proposalTemperatures_[i], span.proposalDistributions[i]);
+		firstSpan_[span.start + 1] = spans_.size();
+	}
+	// positions where no span starts begin where the previous position ends
+	for(uint i = 1; i <= sentenceLength_; i++)
+		firstSpan_[i] = std::max(firstSpan_[i], firstSpan_[i - 1]);
+}
+
+// Log of the sum of exp(logWeights), and the weights relative to their
+// maximum, which are exactly representable in a table.
+static Float normaliseLogWeights(const std::vector<Float> &logWeights, std::vector<Float> &weights) {
+	Float max = *std::max_element(logWeights.begin(), logWeights.end());
+	weights.resize(logWeights.size());
+	for(uint i = 0; i < logWeights.size(); i++)
+		weights[i] = std::exp(logWeights[i] - max);
+	return max + std::log(std::accumulate(weights.begin(), weights.end(), Float(0)));
+}
+
+void PhrasePairCollection::buildProposalDistribution(const std::vector<const AnchoredPhrasePair *> &candidates,
+		Float temperature, ProposalDistribution_ &dist) const {
+	dist.logWeights.clear();
+	dist.logWeights.reserve(candidates.size());
+	for(uint i = 0; i < candidates.size(); i++)
+		dist.logWeights.push_back(computeProposalLogWeight(candidates[i]->second, proposalWeights_, temperature));
+	dist.maxLogWeight = *std::max_element(dist.logWeights.begin(), dist.logWeights.end());
+	for(std::vector<Float>::iterator it = dist.logWeights.begin(); it != dist.logWeights.end(); ++it)
+		*it -= dist.maxLogWeight;
+
+	std::vector<Float> weights;
+	dist.logTotal = normaliseLogWeights(dist.logWeights, weights);
+	dist.alias = AliasTable(weights);
+
+	dist.dominant = -1;
+	if(candidates.size() < 2)
+		return;
+	uint top = std::max_element(dist.logWeights.begin(), dist.logWeights.end()) - dist.logWeights.begin();
+	if(dist.logWeights[top] <= dist.logTotal - std::log(Float(2)))
+		return;
+	std::vector<Float> rest(dist.logWeights);
+	rest.erase(rest.begin() + top);
+	dist.dominant = top;
+	dist.logTotalWithoutDominant = normaliseLogWeights(rest, weights);
+	dist.aliasWithoutDominant = AliasTable(weights);
+}
+
+// log(exp(a) - exp(b)) for b < a
+static Float logDifference(Float a, Float b) {
+	return a + std::log(Float(1) - std::exp(b - a));
+}
+
+const PhrasePairCollection::Span_ &PhrasePairCollection::getSpan(const AnchoredPhrasePair &app) const {
+	uint i = firstSpan_[app.getSourceStart()];
+	while(spans_[i].end != app.getSourceEnd())
+		i++;
+	return spans_[i];
+}
+
+// The alternative is drawn from the distribution without old: translations
+// other than the dominant one are drawn from the full table until something
+// other than old comes up, which takes at most two draws on average.
+// Then q(new|old) = w_new / (Z - w_old), where Z is the total weight.
+const AnchoredPhrasePair &PhrasePairCollection::proposeWeightedAlternativeTranslation(const AnchoredPhrasePair &old,
+		Float temperature, Float &logProposalRatio) const {
+	logProposalRatio = Float(0);
+
+	const Span_ &span = getSpan(old);
+	if(span.candidates.size() < 2)
+		return old;
+
+	uint t = std::find(proposalTemperatures_.begin(), proposalTemperatures_.end(), temperature) - proposalTemperatures_.begin();
+	if(t == proposalTemperatures_.size()) {
+		LOG(logger_, error, "No proposal distribution precomputed for temperature " << temperature << ".");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+	const ProposalDistribution_ &dist = span.proposalDistributions[t];
+
+	Float oldLogWeight = computeProposalLogWeight(old.second, proposalWeights_, temperature) - dist.maxLogWeight;
+	Float oldLogRest;
+	uint choice;
+	if(dist.dominant >= 0 && *span.candidates[dist.dominant] == old) {
+		oldLogRest = dist.logTotalWithoutDominant;
+		choice = dist.aliasWithoutDominant.draw(random_);
+		if(choice >= uint(dist.dominant))
+			choice++;
+	} else {
+		oldLogRest = logDifference(dist.logTotal, oldLogWeight);
+		do
+			choice = dist.alias.draw(random_);
+		while(*span.candidates[choice] == old);
+	}
+	Float newLogRest = int(choice) == dist.dominant ?
+		dist.logTotalWithoutDominant : logDifference(dist.logTotal, dist.logWeights[choice]);
+
+	logProposalRatio = oldLogWeight - dist.logWeights[choice] + oldLogRest - newLogRest;
+	return *span.candidates[choice];
+}
+
+// Returns all phrase pairs covering the same source span as old, including old itself.
+void PhrasePairCollection::getAlternativeTranslations(const AnchoredPhrasePair &old,
+		std::vector<const AnchoredPhrasePair *> &out) const {
+	out = getSpan(old).candidates;
+}
+
 
 bool PhrasePairCollection::phrasesExist(const PhraseSegmentation& phraseSegmentation) const {
 	for(PhraseSegmentation::const_iterator pit1 = phraseSegmentation.begin(); pit1 != phraseSegmentation.end(); ++pit1) {
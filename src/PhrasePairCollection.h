@@ -29,6 +29,8 @@
 
 #include <iterator>
 #include <list>
+#include <vector>
+
 
 class PhrasePairCollection {
 	friend class PhraseTable;
@@ -43,12 +45,55 @@ private:
 	typedef std::list<AnchoredPhrasePair> PhrasePairList_;
 	PhrasePairList_ phrasePairList_;
 
+	// Weighted proposal distribution over the translations of a span, with
+	// log weights relative to the largest one. If one translation has more
+	// than half of the mass, a second table leaves it out, so that any
+	// translation can be excluded from the draws in expected constant time.
+	// The totals are logarithms too, so tiny weights don't underflow.
+	struct ProposalDistribution_ {
+		std::vector<Float> logWeights;
+		Float maxLogWeight;
+		Float logTotal;
+		AliasTable alias;
+		int dominant;
+		Float logTotalWithoutDominant;
+		AliasTable aliasWithoutDominant;
+
+		ProposalDistribution_() : maxLogWeight(0), logTotal(0), dominant(-1), logTotalWithoutDominant(0) {}
+	};
+
+	// The translations of a source span [start, end), with one proposal
+	// distribution for each proposal temperature in use.
+	struct Span_ {
+		uint start;
+		uint end;
+		std::vector<const AnchoredPhrasePair *> candidates;
+		std::vector<ProposalDistribution_> proposalDistributions;
+	};
+
+	// The spans are indexed when the collection is built, ordered by start
+	// and end position, and firstSpan_[i] is the index of the first span
+	// starting at position i. The proposal distributions are precomputed at
+	// the same time for the phrase table weights and the temperatures of the
+	// operations in the configuration. The collection is shared by all chains
+	// searching the same document, and since it doesn't change after it's been
+	// built, they can draw from it without locking.
+	std::vector<Span_> spans_;
+	std::vector<uint> firstSpan_;
+	std::vector<Float> proposalWeights_;
+	std::vector<Float> proposalTemperatures_;
+
 	PhrasePairCollection(const PhraseTable &phraseTable, uint sentenceLength, Random random);
 	void addPhrasePair(CoverageBitmap cov, PhrasePair phrasePair);
+	void indexSpans(const std::vector<Float> &proposalWeights, const std::vector<Float> &proposalTemperatures);
+	void buildProposalDistribution(const std::vector<const AnchoredPhrasePair *> &candidates,
+		Float temperature, ProposalDistribution_ &dist) const;
+
+	const Span_ &getSpan(const AnchoredPhrasePair &app) const;
 
 	bool proposeSegmentationLeftRight(const CoverageBitmap &range,
 		std::vector<AnchoredPhrasePair>::const_iterator startit, std::vector<AnchoredPhrasePair>::const_iterator endit,
-		PhraseSegmentation &seg) const;
+		const std::vector<Float> *weights, Float temperature, PhraseSegmentation &seg) const;
 	bool proposeSegmentationRandomChoice(CoverageBitmap range, const PhrasePairList_ &list, PhraseSegmentation &seg) const;
 
 public:
@@ -68,6 +113,21 @@ public:
 	PhraseSegmentation proposeSegmentation() const;
 	PhraseSegmentation proposeSegmentation(const CoverageBitmap &range) const;
 	const AnchoredPhrasePair &proposeAlternativeTranslation(const AnchoredPhrasePair &old) const;
+
+	// Log of the unnormalised probability of proposing a phrase pair when sampling
+	// proportionally to its weighted phrase table scores.
+	static Float computeProposalLogWeight(const PhrasePair &phrasePair, const std::vector<Float> &weights, Float temperature);
+
+	// Like the uniform versions above, but preferring phrase pairs with good phrase table scores.
+	// The alternative translation is drawn at one of the temperatures the
+	// collection was built for, never returns old unless there's no other
+	// translation, and sets logProposalRatio to log q(old|new) - log q(new|old)
+	// for Metropolis-Hastings correction.
+	PhraseSegmentation proposeSegmentation(const CoverageBitmap &range, const std::vector<Float> &weights, Float temperature) const;
+	const AnchoredPhrasePair &proposeWeightedAlternativeTranslation(const AnchoredPhrasePair &old,
+		Float temperature, Float &logProposalRatio) const;
+
+	void getAlternativeTranslations(const AnchoredPhrasePair &old, std::vector<const AnchoredPhrasePair *> &out) const;
 	bool phrasesExist(const PhraseSegmentation& phraseSegmentation) const;
 };
 
@@ -0,0 +1,85 @@
+/*
+ *  PhrasePairIndicatorModel.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "PhrasePairIndicatorModel.h"
+#include "SearchStep.h"
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/foreach.hpp>
+
+PhrasePairIndicatorModel::PhrasePairIndicatorModel(const Parameters &params, SparseFeatureRegistry &registry) :
+		registry_(registry), prefix_(params.get<std::string>("prefix", "pp")) {}
+
+const SparseFeatureRegistry::Feature *PhrasePairIndicatorModel::getFeature(const PhrasePair &pp) const {
+	FeatureCache_ *cache = featureCache_.get();
+	if(cache == NULL) {
+		cache = new FeatureCache_();
+		featureCache_.reset(cache);
+	}
+
+	// flyweight values never move, so their address identifies the phrase pair
+	const PhrasePairData *ppd = &pp.get();
+	FeatureCache_::const_iterator it = cache->find(ppd);
+	if(it != cache->end())
+		return it->second;
+
+	std::string name = prefix_ + '_' + boost::algorithm::join(ppd->getSourcePhrase().get(), "_") +
+		'~' + boost::algorithm::join(ppd->getTargetPhrase().get(), "_");
+	const SparseFeatureRegistry::Feature *f = registry_.getFeature(name);
+	cache->insert(std::make_pair(ppd, f));
+	return f;
+}
+
+FeatureFunction::State *PhrasePairIndicatorModel::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
+	return NULL;
+}
+
+void PhrasePairIndicatorModel::initSparseScores(const DocumentState &doc, SparseScores &scores) const {
+	BOOST_FOREACH(const PhraseSegmentation &seg, doc.getPhraseSegmentations())
+		BOOST_FOREACH(const AnchoredPhrasePair &app, seg)
+			scores.add(getFeature(app.second), Float(1));
+}
+
+FeatureFunction::StateModifications *PhrasePairIndicatorModel::estimateScoreUpdate(const DocumentState &doc,
+		const SearchStep &step, const State *state, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+	return NULL;
+}
+
+FeatureFunction::StateModifications *PhrasePairIndicatorModel::updateScore(const DocumentState &doc,
+		const SearchStep &step, const State *state, StateModifications *estmods,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+	return estmods;
+}
+
+void PhrasePairIndicatorModel::computeSparseScoreUpdate(const DocumentState &doc, const SearchStep &step,
+		SparseScores &delta) const {
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		for(PhraseSegmentation::const_iterator pit = it->from_it; pit != it->to_it; ++pit)
+			delta.add(getFeature(pit->second), Float(-1));
+		BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal)
+			delta.add(getFeature(app.second), Float(1));
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ *  PhrasePairIndicatorModel.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_PhrasePairIndicatorModel_h
+#define docent_PhrasePairIndicatorModel_h
+
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_map.hpp>
+
+// Fires one sparse feature per phrase pair type, counting how often the
+// phrase pair is used in the document. The features are named
+// prefix_source~target, with the words of each phrase joined by
+// underscores.
+class PhrasePairIndicatorModel : public FeatureFunction {
+private:
+	typedef boost::unordered_map<const PhrasePairData *,const SparseFeatureRegistry::Feature *> FeatureCache_;
+
+	SparseFeatureRegistry &registry_;
+	std::string prefix_;
+	// per thread, to avoid locking the registry for known phrase pairs
+	mutable boost::thread_specific_ptr<FeatureCache_> featureCache_;
+
+	const SparseFeatureRegistry::Feature *getFeature(const PhrasePair &pp) const;
+
+public:
+	PhrasePairIndicatorModel(const Parameters &params, SparseFeatureRegistry &registry);
+
+	virtual State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const;
+	virtual StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
+		Scores::const_iterator psbegin, Scores::iterator sbegin) const;
+	virtual StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
+		StateModifications *estmods, Scores::const_iterator, Scores::iterator estbegin) const;
+
+	virtual bool hasSparseScores() const {
+		return true;
+	}
+
+	virtual void initSparseScores(const DocumentState &doc, SparseScores &scores) const;
+	virtual void computeSparseScoreUpdate(const DocumentState &doc, const SearchStep &step, SparseScores &delta) const;
+
+	virtual uint getNumberOfScores() const {
+		return 0;
+	}
+
+	virtual uint getDependencies() const {
+		return PhrasePairs;
+	}
+
+	virtual bool isSentenceLocal() const {
+		return true;
+	}
+
+	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const {}
+};
+
+#endif
@@ -105,7 +105,8 @@ FeatureFunction::StateModifications *PhraseTable::updateScore(const DocumentStat
 	return estmods;
 }
 
-boost::shared_ptr<const PhrasePairCollection> PhraseTable::getPhrasesForSentence(const std::vector<Word> &sentence) const {
+boost::shared_ptr<const PhrasePairCollection> PhraseTable::getPhrasesForSentence(const std::vector<Word> &sentence,
+		const std::vector<Float> &proposalWeights, const std::vector<Float> &proposalTemperatures) const {
 	using namespace boost::lambda;
 	LOG(logger_, verbose, "getPhrasesForSentence " << sentence);
 	boost::shared_ptr<PhrasePairCollection> ptc(new PhrasePairCollection(*this, sentence.size(), random_));	
@@ -180,6 +181,7 @@ boost::shared_ptr<const PhrasePairCollection> PhraseTable::getPhrasesForSentence
 		ptc->addPhrasePair(cov, PhrasePair(sentence[i], Scores(nscores_, 0)));
 	}
 
+	ptc->indexSpans(proposalWeights, proposalTemperatures);
 	return ptc;
 }
 
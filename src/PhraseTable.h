@@ -64,10 +64,21 @@ public:
 	virtual uint getNumberOfScores() const {
 		return nscores_;
 	}
+
+	virtual uint getDependencies() const {
+		return PhrasePairs;
+	}
+
+	virtual bool isSentenceLocal() const {
+		return true;
+	}
 	
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 
-	boost::shared_ptr<const PhrasePairCollection> getPhrasesForSentence(const std::vector<Word> &sentence) const;
+	// The weighted proposal distributions of the collection are precomputed
+	// for the given weights and temperatures.
+	boost::shared_ptr<const PhrasePairCollection> getPhrasesForSentence(const std::vector<Word> &sentence,
+		const std::vector<Float> &proposalWeights, const std::vector<Float> &proposalTemperatures) const;
 	
 	bool operator==(const PhraseTable &o) const {
 		return filename_ == o.filename_;
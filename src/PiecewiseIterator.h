@@ -37,7 +37,7 @@ class PiecewiseIterator : public boost::iterator_adaptor<PiecewiseIterator<Piece
 private:
 	typedef typename std::iterator_traits<PieceIterator>::value_type BaseIterator;
 
-	Logger logger_;
+	static Logger logger_;
 
 	PieceIterator piecesBegin_;
 	PieceIterator piecesEnd_;
@@ -77,15 +77,13 @@ private:
 
 public:
 	PiecewiseIterator(PieceIterator begin, PieceIterator end) :
-			PiecewiseIterator::iterator_adaptor_(*begin),
-			logger_("PiecewiseIterator") {
+			PiecewiseIterator::iterator_adaptor_(*begin) {
 		init(begin, begin, end, *begin);
 	}
 	
 	PiecewiseIterator(PieceIterator begin, PieceIterator startPiece, PieceIterator end,
 				BaseIterator initIterator) :
-			PiecewiseIterator::iterator_adaptor_(initIterator),
-			logger_("PiecewiseIterator") {
+			PiecewiseIterator::iterator_adaptor_(initIterator) {
 		init(begin, startPiece, end, initIterator);
 	}
 
@@ -163,5 +161,8 @@ private:
 	}
 };
 
+template<class PieceIterator>
+Logger PiecewiseIterator<PieceIterator>::logger_("PiecewiseIterator");
+
 #endif
 
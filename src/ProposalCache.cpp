@@ -0,0 +1,141 @@
+/*
+ *  ProposalCache.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "ProposalCache.h"
+#include "SearchStep.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <boost/functional/hash.hpp>
+
+ProposalCache::ProposalCache(const DecoderConfiguration &config, uint size) :
+		size_(size), sentenceLocal_(true), lookups_(0), hits_(0) {
+	const DecoderConfiguration::FeatureFunctionList &ff = config.getFeatureFunctions();
+	for(uint i = 0; i < ff.size(); i++)
+		if(!ff[i].isSentenceLocal())
+			sentenceLocal_ = false;
+}
+
+std::size_t ProposalCache::computeHash(const SearchStep &step) {
+	std::size_t seed = 0;
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		boost::hash_combine(seed, it->sentno);
+		boost::hash_combine(seed, it->from);
+		boost::hash_combine(seed, it->to);
+		boost::hash_combine(seed, it->proposal);
+	}
+	return seed;
+}
+
+void ProposalCache::getGenerations(const DocumentState &doc, const SearchStep &step,
+		std::vector<DocumentGeneration> &out) const {
+	out.clear();
+	if(!sentenceLocal_) {
+		out.push_back(doc.getGeneration());
+		return;
+	}
+
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it)
+		out.push_back(doc.getSentenceGeneration(it->sentno));
+}
+
+bool ProposalCache::matches(const Entry &entry, const DocumentState &doc, const SearchStep &step, std::size_t hash) const {
+	if(entry.hash != hash || entry.delta.empty())
+		return false;
+
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	if(entry.modifications.size() != mods.size())
+		return false;
+
+	for(uint i = 0; i < mods.size(); i++) {
+		const CachedModification &cm = entry.modifications[i];
+		if(cm.sentno != mods[i].sentno || cm.from != mods[i].from || cm.to != mods[i].to ||
+				cm.proposal != mods[i].proposal)
+			return false;
+	}
+
+	std::vector<DocumentGeneration> generations;
+	getGenerations(doc, step, generations);
+	return generations == entry.generations;
+}
+
+bool ProposalCache::lookup(const DocumentState &doc, const SearchStep &step, Scores &outScores, SparseScores &outSparse,
+		Float &outEstimate) {
+	if(entries_.empty())
+		return false;
+
+	lookups_++;
+	std::size_t hash = computeHash(step);
+	const Entry &entry = entries_[hash % size_];
+	if(!matches(entry, doc, step, hash))
+		return false;
+
+	hits_++;
+	const Scores &docScores = doc.getScores();
+	outScores.resize(docScores.size());
+	std::transform(docScores.begin(), docScores.end(), entry.delta.begin(), outScores.begin(), std::plus<Float>());
+	outSparse = entry.sparseDelta;
+	outEstimate = doc.getScore() + entry.estimateDelta;
+	return true;
+}
+
+void ProposalCache::store(const DocumentState &doc, const SearchStep &step, const Scores &scores, const SparseScores &sparse,
+		Float estimate) {
+	if(size_ == 0)
+		return;
+
+	// allocate lazily, most document copies made during search never use their cache
+	if(entries_.empty())
+		entries_.resize(size_);
+
+	std::size_t hash = computeHash(step);
+	Entry &entry = entries_[hash % size_];
+	entry.hash = hash;
+
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	entry.modifications.resize(mods.size());
+	for(uint i = 0; i < mods.size(); i++) {
+		entry.modifications[i].sentno = mods[i].sentno;
+		entry.modifications[i].from = mods[i].from;
+		entry.modifications[i].to = mods[i].to;
+		entry.modifications[i].proposal = mods[i].proposal;
+	}
+
+	getGenerations(doc, step, entry.generations);
+
+	const Scores &docScores = doc.getScores();
+	entry.delta.resize(docScores.size());
+	std::transform(scores.begin(), scores.end(), docScores.begin(), entry.delta.begin(), std::minus<Float>());
+	entry.sparseDelta = sparse;
+	entry.estimateDelta = estimate - doc.getScore();
+}
+
+void ProposalCache::clear() {
+	std::vector<Entry>().swap(entries_);
+}
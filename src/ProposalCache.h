@@ -0,0 +1,102 @@
+/*
+ *  ProposalCache.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_ProposalCache_h
+#define docent_ProposalCache_h
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "PhrasePair.h"
+#include "SparseScores.h"
+
+#include <vector>
+
+class DecoderConfiguration;
+class SearchStep;
+
+// Remembers the scores of recently rejected search steps so that the same
+// proposal can be rejected again without calling the feature functions.
+// The cached scores are stored as differences to the document scores. If
+// all feature functions are sentence-local, an entry stays valid as long as
+// the sentences it modifies are unchanged; otherwise, any change to the
+// document invalidates it.
+class ProposalCache {
+private:
+	struct CachedModification {
+		uint sentno;
+		uint from;
+		uint to;
+		PhraseSegmentation proposal;
+	};
+
+	struct Entry {
+		std::size_t hash;
+		std::vector<CachedModification> modifications;
+		std::vector<DocumentGeneration> generations;
+		Scores delta;
+		SparseScores sparseDelta;
+		Float estimateDelta;
+
+		Entry() : hash(0), estimateDelta(0) {}
+	};
+
+	uint size_;
+	bool sentenceLocal_;
+	std::vector<Entry> entries_;
+
+	unsigned long lookups_;
+	unsigned long hits_;
+
+	void getGenerations(const DocumentState &doc, const SearchStep &step, std::vector<DocumentGeneration> &out) const;
+	bool matches(const Entry &entry, const DocumentState &doc, const SearchStep &step, std::size_t hash) const;
+
+public:
+	ProposalCache(const DecoderConfiguration &config, uint size = 4096);
+
+	// hash of the consolidated modifications of a step, identifying the proposal
+	static std::size_t computeHash(const SearchStep &step);
+
+	// If the step is in the cache, stores its cached scores in outScores, its
+	// sparse score changes in outSparse and the weighted score estimate it had
+	// before any exact scores were computed in outEstimate and returns true.
+	bool lookup(const DocumentState &doc, const SearchStep &step, Scores &outScores, SparseScores &outSparse,
+		Float &outEstimate);
+	void store(const DocumentState &doc, const SearchStep &step, const Scores &scores, const SparseScores &sparse,
+		Float estimate);
+	void clear();
+
+	// whether lookups compare the generations of the modified sentences
+	// rather than that of the whole document
+	bool usesSentenceGenerations() const {
+		return sentenceLocal_ && size_ > 0;
+	}
+
+	unsigned long getLookups() const {
+		return lookups_;
+	}
+
+	unsigned long getHits() const {
+		return hits_;
+	}
+};
+
+#endif
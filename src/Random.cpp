@@ -23,6 +23,8 @@
 #include "Random.h"
 
 #include <cstdio>
+#include <ctime>
+#include <limits>
 
 void Random::seed() {
 	FILE *urandom = std::fopen("/dev/urandom", "rb");
@@ -49,12 +51,202 @@ void Random::seed(uint seed) {
 	impl_->seed(seed);
 }
 
+uint RandomImplementation::drawFromRemainingOptions(const std::vector<Float> &weights, const std::vector<Float> &cumulative,
+		const CoverageBitmap &excluded, Float &remaining) const {
+	uint noptions = weights.size();
+	if(!(remaining > Float(0))) {
+		// the running total may just have lost its precision
+		remaining = Float(0);
+		for(uint i = 0; i < noptions; i++)
+			if(!excluded.test(i))
+				remaining += weights[i];
+	}
+	if(!(remaining > Float(0))) {
+		uint k = drawFromRange(noptions - excluded.count());
+		for(uint i = 0;; i++)
+			if(!excluded.test(i) && k-- == 0)
+				return i;
+	}
+
+	// while most of the mass is left, redrawing from the full distribution is cheapest
+	if(remaining >= cumulative.back() * Float(.25)) {
+		uint choice;
+		do
+			choice = drawFromCumulativeDistribution(cumulative);
+		while(excluded.test(choice));
+		return choice;
+	}
+
+	Float x = draw01() * remaining;
+	uint last = noptions;
+	for(uint i = 0; i < noptions; i++) {
+		if(excluded.test(i))
+			continue;
+		last = i;
+		if(x < weights[i])
+			return i;
+		x -= weights[i];
+	}
+	// rounding errors
+	return last;
+}
+
+FenwickDistribution::FenwickDistribution(const std::vector<Float> &weights) :
+		weights_(weights), highestBit_(1), positive_(0), updates_(0) {
+	while(highestBit_ * 2 <= weights_.size())
+		highestBit_ *= 2;
+	rebuild();
+}
+
+void FenwickDistribution::rebuild() {
+	uint n = weights_.size();
+	tree_.assign(n + 1, Float(0));
+	positive_ = 0;
+	for(uint i = 1; i <= n; i++) {
+		assert(weights_[i - 1] >= 0);
+		if(weights_[i - 1] > 0)
+			positive_++;
+		tree_[i] += weights_[i - 1];
+		uint parent = i + (i & -i);
+		if(parent <= n)
+			tree_[parent] += tree_[i];
+	}
+	updates_ = 0;
+}
+
+Float FenwickDistribution::getTotal() const {
+	if(positive_ == 0)
+		return Float(0);
+	Float sum = 0;
+	for(uint i = weights_.size(); i > 0; i -= i & -i)
+		sum += tree_[i];
+	return sum;
+}
+
+void FenwickDistribution::setWeight(uint i, Float weight) {
+	assert(weight >= 0);
+	Float old = weights_[i];
+	if(weight == old)
+		return;
+
+	if(old > 0)
+		positive_--;
+	if(weight > 0)
+		positive_++;
+	weights_[i] = weight;
+
+	if(++updates_ >= weights_.size()) {
+		rebuild();
+		return;
+	}
+
+	Float delta = weight - old;
+	for(uint j = i + 1; j < tree_.size(); j += j & -j)
+		tree_[j] += delta;
+}
+
+uint FenwickDistribution::draw(const Random &random) const {
+	assert(positive_ > 0);
+	uint n = weights_.size();
+	Float x = random.draw01() * getTotal();
+
+	// find the largest prefix whose sum doesn't exceed x
+	uint pos = 0;
+	for(uint step = highestBit_; step > 0; step /= 2)
+		if(pos + step <= n && tree_[pos + step] <= x) {
+			pos += step;
+			x -= tree_[pos];
+		}
+
+	// guard against rounding, which can push us past the last option with positive weight
+	if(pos >= n)
+		pos = n - 1;
+	while(weights_[pos] == 0 && pos > 0)
+		pos--;
+	while(weights_[pos] == 0)
+		pos++;
+	return pos;
+}
+
+AliasTable::AliasTable(const std::vector<Float> &weights) :
+		probability_(weights.size()), alias_(weights.size()) {
+	uint n = weights.size();
+	assert(n > 0);
+
+	Float total = std::accumulate(weights.begin(), weights.end(), Float(0));
+	assert(total > 0);
+
+	std::vector<uint> small, large;
+	std::vector<Float> scaled(n);
+	for(uint i = 0; i < n; i++) {
+		scaled[i] = weights[i] * n / total;
+		if(scaled[i] < Float(1))
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	while(!small.empty() && !large.empty()) {
+		uint s = small.back();
+		uint l = large.back();
+		small.pop_back();
+		probability_[s] = scaled[s];
+		alias_[s] = l;
+		scaled[l] = (scaled[l] + scaled[s]) - Float(1);
+		if(scaled[l] < Float(1)) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// whatever is left over is only there because of rounding errors
+	for(std::vector<uint>::const_iterator it = large.begin(); it != large.end(); ++it) {
+		probability_[*it] = Float(1);
+		alias_[*it] = *it;
+	}
+	for(std::vector<uint>::const_iterator it = small.begin(); it != small.end(); ++it) {
+		probability_[*it] = Float(1);
+		alias_[*it] = *it;
+	}
+}
+
 RandomImplementation::RandomImplementation() :
-	logger_("RandomImplementation"),
-	generator_(), uintGenerator_(generator_, boost::uniform_int<uint>()) {}
+	logger_("RandomImplementation"), seed_(0),
+	threadStream_(&RandomImplementation::releaseThreadStream) {}
 	
 void RandomImplementation::seed(uint seed) {
-	generator_.seed(seed);
+	seed_ = seed;
+	defaultStream_ = RandomStream(seed, std::numeric_limits<uint>::max(), 0);
 	LOG(logger_, normal, "Random number generator seed: " << seed);
 }
 
+static inline void multiplyHighLow(boost::uint32_t a, boost::uint32_t b, boost::uint32_t &hi, boost::uint32_t &lo) {
+	boost::uint64_t product = boost::uint64_t(a) * b;
+	hi = static_cast<boost::uint32_t>(product >> 32);
+	lo = static_cast<boost::uint32_t>(product);
+}
+
+void RandomStream::generateBlock() {
+	const boost::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	const boost::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+	boost::uint32_t c[4] = { counter_[0], counter_[1], counter_[2], counter_[3] };
+	boost::uint32_t k0 = key_[0], k1 = key_[1];
+	for(uint round = 0; round < 10; round++) {
+		boost::uint32_t hi0, lo0, hi1, lo1;
+		multiplyHighLow(M0, c[0], hi0, lo0);
+		multiplyHighLow(M1, c[2], hi1, lo1);
+		c[0] = hi1 ^ c[1] ^ k0;
+		c[1] = lo1;
+		c[2] = hi0 ^ c[3] ^ k1;
+		c[3] = lo0;
+		k0 += W0;
+		k1 += W1;
+	}
+	std::copy(c, c + 4, block_);
+	position_ = 0;
+
+	// the lower 64 bits of the counter number the blocks, the upper ones the chain
+	if(++counter_[0] == 0)
+		counter_[1]++;
+}
@@ -24,82 +24,159 @@
 #define docent_Random_h
 
 #include "Docent.h"
+#include "CoverageBitmap.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <numeric>
 #include <vector>
 
-#include <boost/random/geometric_distribution.hpp>
-#include <boost/random/mersenne_twister.hpp>
-#include <boost/random/uniform_01.hpp>
-#include <boost/random/uniform_int.hpp>
-#include <boost/random/uniform_real.hpp>
-#include <boost/random/variate_generator.hpp>
-#include <boost/shared_ptr.hpp>
-
-class RandomImplementation {
-	friend class Random;
+#include <boost/cstdint.hpp>
+#include <boost/thread/tss.hpp>
 
+// A counter-based random number stream (Philox4x32-10, Salmon et al. 2011).
+// The numbers are a pure function of the key, consisting of the seed and the
+// document number, and a counter whose upper half is the number of the search
+// chain. Streams for different documents and chains are therefore independent
+// and can be created in any order and on any thread without changing the
+// numbers they produce. Four numbers are generated per block.
+class RandomStream {
 private:
-	typedef boost::mt19937 RandomGenerator_;
+	boost::uint32_t key_[2];
+	boost::uint32_t counter_[4];
+	boost::uint32_t block_[4];
+	uint position_;
+
+	void generateBlock();
 
 public:
-	typedef boost::variate_generator<RandomGenerator_ &,boost::uniform_int<uint> > UintGenerator;
-	
+	RandomStream() : position_(4) {
+		std::fill(key_, key_ + 2, 0);
+		std::fill(counter_, counter_ + 4, 0);
+	}
+
+	RandomStream(uint seed, uint document, uint chain) : position_(4) {
+		key_[0] = seed;
+		key_[1] = document;
+		counter_[0] = counter_[1] = 0;
+		counter_[2] = chain;
+		counter_[3] = 0;
+	}
+
+	boost::uint32_t next() {
+		if(position_ == 4)
+			generateBlock();
+		return block_[position_++];
+	}
+
+	// Uniform in (0,1): the midpoints of 2^23 equal intervals, all exactly
+	// representable as Float. Zero is excluded because the acceptance test
+	// of the search takes the logarithm of the result.
+	Float next01() {
+		return ((next() >> 9) + Float(.5)) * Float(1.0 / 8388608.0);
+	}
+};
+
+class RandomImplementation {
+	friend class Random;
+
 private:
 	Logger logger_;
+	uint seed_;
 
-	// We don't consider the state change induced by drawing a random number a modification,
-	// so the random generator is declared mutable.
-	mutable RandomGenerator_ generator_;
-	UintGenerator uintGenerator_;
+	// Used by threads that haven't installed a stream of their own. We don't
+	// consider the state change induced by drawing a random number a
+	// modification, so it is declared mutable.
+	mutable RandomStream defaultStream_;
+
+	// The streams are owned by the search states, not by the thread.
+	boost::thread_specific_ptr<RandomStream> threadStream_;
+	static void releaseThreadStream(RandomStream *) {}
 
 	RandomImplementation(const RandomImplementation &o);
 	RandomImplementation &operator=(const RandomImplementation &);
-	
-	RandomImplementation();
+
+	RandomStream &stream() const {
+		RandomStream *s = threadStream_.get();
+		return s ? *s : defaultStream_;
+	}
 
 public:
+	// The generator must be seeded before use.
+	RandomImplementation();
+
 	void seed(uint seed);
 
+	uint getSeed() const {
+		return seed_;
+	}
+
 	inline uint drawFromRange(uint noptions) const;
 	
 	inline uint drawFromCumulativeDistribution(const std::vector<Float> &distribution) const;
 	inline uint drawFromDiscreteDistribution(const std::vector<Float> &distribution) const;
+	uint drawFromRemainingOptions(const std::vector<Float> &weights, const std::vector<Float> &cumulative,
+		const CoverageBitmap &excluded, Float &remaining) const;
 	
 	inline uint drawFromGeometricDistribution(Float decay, uint cap = std::numeric_limits<uint>::max()) const;
 	
 	inline Float draw01() const;
 	inline bool flipCoin(Float p = .5) const;
-
-	UintGenerator &getUintGenerator() const {
-		return const_cast<UintGenerator &>(uintGenerator_);
-	}
 };
 
+// A handle to the random number generator owned by the DecoderConfiguration.
+// It is a plain pointer, so it is cheap to pass around by value.
 class Random {
 private:
-	boost::shared_ptr<RandomImplementation> impl_;
-	explicit Random(RandomImplementation *impl) : impl_(impl) {}
-
-	// This will create the object in an invalid state. You need to
-	// call setup() in order to make it valid.
-	// The default constructor is private to make sure we don't inadvertently
-	// create an unseeded random generator. Using the copy constructor is ok.
-	Random() : impl_(new RandomImplementation()) {}
+	RandomImplementation *impl_;
 
 public:
-	typedef RandomImplementation::UintGenerator UintGenerator;
+	// random number generator for std::random_shuffle
+	class UintGenerator : public std::unary_function<uint,uint> {
+	private:
+		const RandomImplementation *impl_;
+
+	public:
+		UintGenerator(const RandomImplementation *impl) : impl_(impl) {}
+
+		uint operator()(uint n) {
+			return impl_->drawFromRange(n);
+		}
+	};
+
+	// Installs a stream for the calling thread as long as it is in scope and
+	// restores the previous one afterwards.
+	class ScopedStream {
+	private:
+		RandomImplementation *impl_;
+		RandomStream *previous_;
+
+		ScopedStream(const ScopedStream &);
+		ScopedStream &operator=(const ScopedStream &);
+
+	public:
+		ScopedStream(const Random &random, RandomStream &stream)
+				: impl_(random.impl_), previous_(impl_->threadStream_.get()) {
+			impl_->threadStream_.reset(&stream);
+		}
+
+		~ScopedStream() {
+			impl_->threadStream_.reset(previous_);
+		}
+	};
 
 	// default copy constructor
 
-	static Random create() {
-		return Random();
-	}
+	explicit Random(RandomImplementation &impl) : impl_(&impl) {}
 
 	void seed();
 	void seed(uint seed);
+
+	// creates the stream for a given document and search chain
+	RandomStream createStream(uint document, uint chain) const {
+		return RandomStream(impl_->getSeed(), document, chain);
+	}
 	
 	uint drawFromRange(uint noptions) const {
 		return impl_->drawFromRange(noptions);
@@ -112,6 +189,16 @@ public:
 	uint drawFromDiscreteDistribution(const std::vector<Float> &distribution) const {
 		return impl_->drawFromDiscreteDistribution(distribution);
 	}
+
+	// Draws one of the options not in excluded with probability proportional
+	// to its weight, for sampling without replacement. cumulative holds the
+	// partial sums of all weights and remaining the total weight of the
+	// options not excluded. If that has underflowed to zero, the options are
+	// drawn uniformly instead.
+	uint drawFromRemainingOptions(const std::vector<Float> &weights, const std::vector<Float> &cumulative,
+			const CoverageBitmap &excluded, Float &remaining) const {
+		return impl_->drawFromRemainingOptions(weights, cumulative, excluded, remaining);
+	}
 	
 	uint drawFromGeometricDistribution(Float decay, uint cap = std::numeric_limits<uint>::max()) const {
 		return impl_->drawFromGeometricDistribution(decay, cap);
@@ -125,20 +212,93 @@ public:
 		return impl_->flipCoin(p);
 	}
 
-	UintGenerator &getUintGenerator() const {
-		return impl_->getUintGenerator();
+	UintGenerator getUintGenerator() const {
+		return UintGenerator(impl_);
+	}
+};
+
+// Walker's alias method (in Vose's formulation): after linear-time setup,
+// draws from a fixed discrete distribution in constant time.
+class AliasTable {
+private:
+	std::vector<Float> probability_;
+	std::vector<uint> alias_;
+
+public:
+	AliasTable() {}
+	// The weights need not be normalised.
+	explicit AliasTable(const std::vector<Float> &weights);
+
+	uint size() const {
+		return probability_.size();
+	}
+
+	uint draw(const Random &random) const {
+		uint column = random.drawFromRange(probability_.size());
+		return random.draw01() < probability_[column] ? column : alias_[column];
 	}
 };
 
+// A discrete distribution whose weights change one at a time, kept in a
+// Fenwick tree: setting a weight and drawing both take logarithmic time.
+// The partial sums are rebuilt from the weights after every size() updates,
+// so rounding errors don't accumulate.
+class FenwickDistribution {
+private:
+	std::vector<Float> weights_;
+	// tree_[i] is the sum of the weights (i - (i & -i), i], indexed from 1
+	std::vector<Float> tree_;
+	uint highestBit_;
+	uint positive_;
+	uint updates_;
+
+	void rebuild();
+
+public:
+	FenwickDistribution() : highestBit_(0), positive_(0), updates_(0) {}
+	// The weights need not be normalised, but mustn't be negative.
+	explicit FenwickDistribution(const std::vector<Float> &weights);
+
+	uint size() const {
+		return weights_.size();
+	}
+
+	Float getWeight(uint i) const {
+		return weights_[i];
+	}
+
+	bool empty() const {
+		return positive_ == 0;
+	}
+
+	Float getTotal() const;
+	void setWeight(uint i, Float weight);
+
+	// Only options with positive weight are drawn. The distribution mustn't be empty().
+	uint draw(const Random &random) const;
+};
+
+// Lemire's multiply-and-shift method, with rejection to remove the bias.
 uint RandomImplementation::drawFromRange(uint noptions) const {
 	assert(noptions > 0);
-	boost::uniform_int<uint> distr(0, noptions-1);
-	return distr(generator_);
+	RandomStream &s = stream();
+	boost::uint64_t m = boost::uint64_t(s.next()) * noptions;
+	boost::uint32_t low = static_cast<boost::uint32_t>(m);
+	if(low < noptions) {
+		boost::uint32_t threshold = -noptions % noptions;
+		while(low < threshold) {
+			m = boost::uint64_t(s.next()) * noptions;
+			low = static_cast<boost::uint32_t>(m);
+		}
+	}
+	return static_cast<uint>(m >> 32);
 }
 
 uint RandomImplementation::drawFromCumulativeDistribution(const std::vector<Float> &cumulative) const {
-    boost::uniform_real<Float> dist(0, cumulative.back());
-    return std::lower_bound(cumulative.begin(), cumulative.end(), dist(generator_)) - cumulative.begin();
+	Float x = draw01() * cumulative.back();
+	uint i = std::upper_bound(cumulative.begin(), cumulative.end(), x) - cumulative.begin();
+	// guard against rounding in the multiplication
+	return std::min<uint>(i, cumulative.size() - 1);
 }
 
 uint RandomImplementation::drawFromDiscreteDistribution(const std::vector<Float> &distribution) const {
@@ -148,14 +308,14 @@ uint RandomImplementation::drawFromDiscreteDistribution(const std::vector<Float>
 	return drawFromCumulativeDistribution(cumulative);
 }
 
+// number of failures before the first success with success probability decay
 uint RandomImplementation::drawFromGeometricDistribution(Float decay, uint cap) const {
-	boost::geometric_distribution<uint,Float> dist(decay);
-	return std::min(dist(generator_), cap);
+	Float x = std::floor(std::log(Float(1) - draw01()) / std::log(Float(1) - decay));
+	return x >= Float(cap) ? cap : static_cast<uint>(x);
 }
 
 Float RandomImplementation::draw01() const {
-	boost::uniform_01<Float> dist;
-	return dist(generator_);
+	return stream().next01();
 }
 
 bool RandomImplementation::flipCoin(Float p) const {
@@ -163,4 +323,3 @@ bool RandomImplementation::flipCoin(Float p) const {
 }
 
 #endif
-
@@ -21,11 +21,84 @@
  */
 
 #include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
 #include "LocalBeamSearch.h"
+#include "MultiStartSearch.h"
+#include "NbestStorage.h"
 //#include "MetropolisHastingsSampler.h"
 #include "SearchAlgorithm.h"
 #include "SimulatedAnnealing.h"
 
+#include <limits>
+
+Logger AcceptanceDecision::logger_("AcceptanceDecision");
+
+SearchAlgorithm::SearchAlgorithm(const Parameters &params) {
+	documentTimeLimit_ = params.get<double>("document-time-limit", std::numeric_limits<double>::infinity());
+	testsetTimeLimit_ = params.get<double>("testset-time-limit", std::numeric_limits<double>::infinity());
+
+	std::string allocation = params.get<std::string>("step-allocation", "fixed");
+	if(allocation == "fixed")
+		adaptiveStepAllocation_ = false;
+	else if(allocation == "adaptive")
+		adaptiveStepAllocation_ = true;
+	else {
+		Logger logger("SearchAlgorithm");
+		LOG(logger, error, "Unknown step allocation method: " << allocation);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+	stepAllocationSlice_ = params.get<uint>("step-allocation-slice", 5000);
+	stepAllocationMinShare_ = params.get<Float>("step-allocation-min-share", .25);
+	testsetMaxSteps_ = params.get<unsigned long>("testset-max-steps", 0);
+	if(stepAllocationMinShare_ < 0 || stepAllocationMinShare_ > 1) {
+		Logger logger("SearchAlgorithm");
+		LOG(logger, error, "Invalid step-allocation-min-share: " << stepAllocationMinShare_);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+	if(adaptiveStepAllocation_ && testsetMaxSteps_ == 0) {
+		Logger logger("SearchAlgorithm");
+		LOG(logger, error, "Adaptive step allocation requires the testset-max-steps search parameter.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	chains_ = params.get<uint>("chains", 1);
+	chainSlice_ = params.get<uint>("chain-slice", 10000);
+	chainCancelMargin_ = params.get<Float>("chain-cancel-margin", std::numeric_limits<Float>::infinity());
+	if(chains_ == 0 || chainSlice_ == 0 || chainCancelMargin_ < 0) {
+		Logger logger("SearchAlgorithm");
+		LOG(logger, error, "Invalid multi-start parameters: chains=" << chains_ << ", chain-slice=" << chainSlice_
+			<< ", chain-cancel-margin=" << chainCancelMargin_);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	// the step allocator runs a single chain per document
+	if(adaptiveStepAllocation_ && chains_ > 1) {
+		Logger logger("SearchAlgorithm");
+		LOG(logger, error, "Adaptive step allocation can't be combined with multiple chains (chains=" << chains_ << ").");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+}
+
+void SearchAlgorithm::setupState(SearchState *state, const DocumentState &doc) const {
+	if(documentTimeLimit_ != std::numeric_limits<double>::infinity())
+		state->restrictTimeLimit(documentTimeLimit_);
+	state->setRandomStream(doc.getDecoderConfiguration()->getRandom().createStream(doc.getDocumentNumber(), 0));
+}
+
+void SearchAlgorithm::search(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest) const {
+	if(chains_ > 1) {
+		MultiStartSearch multi(*this, doc, chains_, nbest.getMaxSize());
+		multi.search();
+		multi.collectNbest(nbest);
+		return;
+	}
+
+	SearchState *state = createState(doc);
+	search(state, nbest);
+	delete state;
+}
+
 SearchAlgorithm *SearchAlgorithm::createSearchAlgorithm(const std::string &algo,
 		const DecoderConfiguration &config, const Parameters &params) {
 	if(algo == "simulated-annealing")
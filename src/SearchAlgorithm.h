@@ -26,6 +26,7 @@
 #include "Docent.h"
 #include "Random.h"
 
+#include <algorithm>
 #include <functional>
 #include <limits>
 
@@ -38,7 +39,7 @@ class Parameters;
 
 class AcceptanceDecision : public std::unary_function<Float,bool> {
 private:
-	Logger logger_;
+	static Logger logger_;
 
 	Float threshold_;
 
@@ -46,11 +47,9 @@ private:
 
 public:
 	AcceptanceDecision(Float threshold)
-		: logger_("AcceptanceDecision"),
-		  threshold_(threshold), d_(0), T_(0), oldScore_(0) {}
+		: threshold_(threshold), d_(0), T_(0), oldScore_(0) {}
 
-	AcceptanceDecision(Random rnd, Float T, Float oldScore)
-		: logger_("AcceptanceDecision") {
+	AcceptanceDecision(Random rnd, Float T, Float oldScore) {
 		// compute acceptance threshold for acceptance with probability exp((old - new) / T)
 		Float d = rnd.draw01();
 		threshold_ = T * log(d) + oldScore;
@@ -71,30 +70,153 @@ public:
 		LOG(logger_, debug, "will accept:          " << (newScore > threshold_));
 		return newScore > threshold_;
 	}
+
+	// Metropolis-Hastings acceptance for asymmetric proposal distributions, where
+	// logProposalRatio is log q(old|new) - log q(new|old).
+	bool operator()(Float newScore, Float logProposalRatio) const {
+		return (*this)(newScore + T_ * logProposalRatio);
+	}
 };
 
 struct SearchState {
+private:
+	double deadline_;
+	RandomStream randomStream_;
+
+public:
+	SearchState() : deadline_(std::numeric_limits<double>::infinity()) {}
 	virtual ~SearchState() {}
 	virtual const boost::shared_ptr<DocumentState>& getLastDocumentState() = 0;
+
+	// total number of steps taken on this state in all slices so far
+	virtual uint getNumberOfSteps() const = 0;
+
+	// Makes sure search on this state stops at most the given number of seconds
+	// from now. The deadline holds across search slices.
+	void restrictTimeLimit(double seconds) {
+		deadline_ = std::min(deadline_, getMonotonicTime() + seconds);
+	}
+
+	bool hasDeadline() const {
+		return deadline_ != std::numeric_limits<double>::infinity();
+	}
+
+	double getDeadline() const {
+		return deadline_;
+	}
+
+	bool isTimeUp() const {
+		return hasDeadline() && getMonotonicTime() >= deadline_;
+	}
+
+	// The random numbers used while searching this state. The search
+	// algorithms install the stream for the duration of each search slice, so
+	// the result doesn't depend on how slices of different states are
+	// interleaved or distributed among threads.
+	RandomStream &getRandomStream() {
+		return randomStream_;
+	}
+
+	void setRandomStream(const RandomStream &stream) {
+		randomStream_ = stream;
+	}
+};
+
+// Divides a time limit for a whole testset among its documents in proportion
+// to their input length. The time not used by earlier documents is passed on
+// to later ones.
+class TestsetTimeBudget {
+private:
+	double deadline_;
+	Float remainingWords_;
+
+public:
+	TestsetTimeBudget(double seconds, Float totalWords)
+		: deadline_(getMonotonicTime() + seconds), remainingWords_(totalWords) {}
+
+	// returns the time limit in seconds for the next document
+	double allocate(Float words) {
+		double remainingTime = std::max(deadline_ - getMonotonicTime(), 0.0);
+		double share = remainingWords_ > 0 ? std::min(words / remainingWords_, Float(1)) : Float(1);
+		remainingWords_ -= words;
+		return remainingTime * share;
+	}
 };
 
 struct SearchAlgorithm {
+protected:
+	// Wall-clock limits in seconds from the search parameters document-time-limit
+	// and testset-time-limit. The testset limit is distributed by the decoder drivers.
+	double documentTimeLimit_;
+	double testsetTimeLimit_;
+
+	// Step allocation across the documents of a testset, see StepAllocator.
+	bool adaptiveStepAllocation_;
+	uint stepAllocationSlice_;
+	Float stepAllocationMinShare_;
+	unsigned long testsetMaxSteps_;
+
+	// Independent search chains per document, see MultiStartSearch.
+	uint chains_;
+	uint chainSlice_;
+	Float chainCancelMargin_;
+
+	SearchAlgorithm(const Parameters &params);
+
+	// to be called by createState in subclasses
+	void setupState(SearchState *state, const DocumentState &doc) const;
+
+public:
 	static SearchAlgorithm *createSearchAlgorithm(const std::string &algo, const DecoderConfiguration &config,
 		const Parameters &params);
 
 	virtual ~SearchAlgorithm() {}
 	virtual SearchState *createState(boost::shared_ptr<DocumentState> doc) const = 0;
+
+	bool hasTestsetTimeLimit() const {
+		return testsetTimeLimit_ != std::numeric_limits<double>::infinity();
+	}
+
+	double getTestsetTimeLimit() const {
+		return testsetTimeLimit_;
+	}
+
+	bool hasAdaptiveStepAllocation() const {
+		return adaptiveStepAllocation_;
+	}
+
+	uint getStepAllocationSlice() const {
+		return stepAllocationSlice_;
+	}
+
+	Float getStepAllocationMinShare() const {
+		return stepAllocationMinShare_;
+	}
+
+	unsigned long getTestsetMaxSteps() const {
+		return testsetMaxSteps_;
+	}
+
+	uint getNumberOfChains() const {
+		return chains_;
+	}
+
+	uint getChainSlice() const {
+		return chainSlice_;
+	}
+
+	Float getChainCancelMargin() const {
+		return chainCancelMargin_;
+	}
+
 	virtual void search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const = 0;
 
 	void search(SearchState *sstate, NbestStorage &nbest) const {
 		search(sstate, nbest, std::numeric_limits<uint>::max(), std::numeric_limits<uint>::max());
 	}
 
-	void search(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest) const {
-		SearchState *state = createState(doc);
-		search(state, nbest);
-		delete state;
-	}
+	// Searches a document from scratch, using several chains if configured.
+	void search(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest) const;
 };
 
 #endif
@@ -22,6 +22,8 @@
 
 #include "Docent.h"
 #include "DecoderConfiguration.h"
+#include "FeaturePipeline.h"
+#include "ProposalCache.h"
 #include "Random.h"
 #include "SearchStep.h"
 #include "SimulatedAnnealing.h"
@@ -34,13 +36,15 @@
 #include <boost/lambda/construct.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
+Logger SearchStep::logger_("SearchStep");
+
 SearchStep::SearchStep(const StateOperation *op, const DocumentState &doc, const std::vector<FeatureFunction::State *> &featureStates)
-		: logger_("SearchStep"),
-		  document_(doc), generation_(doc.getGeneration()), featureStates_(featureStates),
+		: document_(doc), generation_(doc.getGeneration()), featureStates_(featureStates),
 		  configuration_(*doc.getDecoderConfiguration()),
 		  stateModifications_(configuration_.getFeatureFunctions().size()), operation_(op),
-		  modificationsConsolidated_(true), scores_(doc.getScores().size()),
-		  scoreState_(NoScores) {}
+		  changedAspects_(op->getChangedAspects()), logProposalRatio_(0),
+		  modificationsConsolidated_(true), scores_(doc.getScores().size()), score_(0),
+		  initialEstimate_(0), scoreState_(NoScores), cascadePosition_(0) {}
 
 SearchStep::~SearchStep() {
 	using namespace boost::lambda;
@@ -83,17 +87,39 @@ void SearchStep::estimateScores() const {
 	if(scoreState_ != NoScores)
 		return;
 
-	Scores::const_iterator oldscoreit = document_.getScores().begin();
-	Scores::iterator scoreit = scores_.begin();
-	const DecoderConfiguration::FeatureFunctionList &ff = configuration_.getFeatureFunctions();
-	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), oldscoreit += ff[i].getNumberOfScores(), i++)
-		stateModifications_[i] = ff[i].estimateScoreUpdate(document_, *this, featureStates_[i], oldscoreit, scoreit);
+	score_ = document_.getScore();
+	computeSparseScores();
+	configuration_.getFeaturePipeline().estimateScores(*this);
 	
+	initialEstimate_ = score_;
 	scoreState_ = ScoresEstimated;
 }
 
+// Sparse scores are exact, so they're computed once with the estimates and
+// need no further updates. They're added to the current value of score_.
+void SearchStep::computeSparseScores() const {
+	sparseScores_.clear();
+	if(!configuration_.hasSparseFeatures())
+		return;
+
+	PerformanceCounters *perf = document_.getPerformanceCounters();
+	const DecoderConfiguration::FeatureFunctionList &ff = configuration_.getFeatureFunctions();
+	for(uint i = 0; i < ff.size(); i++)
+		if(ff[i].hasSparseScores() && ff[i].dependsOn(changedAspects_)) {
+			PerformanceCounters::Stopwatch watch(perf);
+			ff[i].computeSparseScoreUpdate(document_, *this, sparseScores_);
+			if(perf) {
+				watch.stop();
+				watch.record(perf->getFeature(i).sparse);
+			}
+		}
+	score_ += sparseScores_.getWeightedSum();
+}
+
 void SearchStep::computeScores() const {
 	switch(scoreState_) {
+	case ScoresCached:
+		scoreState_ = NoScores;
 	case NoScores:
 		estimateScores();
 	case ScoresEstimated:
@@ -102,18 +128,268 @@ void SearchStep::computeScores() const {
 		return;
 	}
 
-	Scores::const_iterator oldscoreit = document_.getScores().begin();
-	Scores::iterator scoreit = scores_.begin();
-	const DecoderConfiguration::FeatureFunctionList &ff = configuration_.getFeatureFunctions();
-	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), oldscoreit += ff[i].getNumberOfScores(), i++)
-		stateModifications_[i] = ff[i].updateScore(document_, *this, featureStates_[i], stateModifications_[i], oldscoreit, scoreit);
-	
+	if(!cascade_)
+		cascade_ = configuration_.getFeatureCascade();
+
+	configuration_.getFeaturePipeline().computeScores(*this, NULL);
+
+	finishScores();
+}
+
+// The incremental updates of score_ are summed in cascade order. Once all
+// exact scores are known, the total is recomputed so that it doesn't depend
+// on that order, not even through rounding.
+void SearchStep::finishScores() const {
+	score_ = std::inner_product(scores_.begin(), scores_.end(), configuration_.getFeatureWeights().begin(), static_cast<Float>(0)) +
+		document_.getSparseScore() + sparseScores_.getWeightedSum();
 	scoreState_ = ScoresComputed;
 }
 
+void SearchStep::estimateBatchScores(const std::vector<SearchStep *> &steps) {
+	std::vector<SearchStep *> pending;
+	for(std::vector<SearchStep *>::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+		assert(&(*it)->document_ == &steps.front()->document_ &&
+			(*it)->generation_ == steps.front()->generation_);
+		if((*it)->scoreState_ == ScoresCached)
+			(*it)->scoreState_ = NoScores;
+		if((*it)->scoreState_ == NoScores)
+			pending.push_back(*it);
+	}
+
+	if(pending.empty())
+		return;
+
+	const DocumentState &doc = pending.front()->document_;
+	const DecoderConfiguration::FeatureFunctionList &ff = pending.front()->configuration_.getFeatureFunctions();
+	PerformanceCounters *perf = doc.getPerformanceCounters();
+	for(std::vector<SearchStep *>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+		(*it)->score_ = doc.getScore();
+		(*it)->computeSparseScores();
+	}
+
+	std::vector<SearchStep *> batchSteps;
+	std::vector<const SearchStep *> batch;
+	std::vector<Scores::iterator> sbegins;
+	std::vector<FeatureFunction::StateModifications *> estmods;
+	for(uint i = 0; i < ff.size(); i++) {
+		uint idx = ff[i].getScoreIndex();
+		Scores::const_iterator oldscores = doc.getScores().begin() + idx;
+
+		batchSteps.clear();
+		batch.clear();
+		sbegins.clear();
+		for(std::vector<SearchStep *>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+			if(ff[i].dependsOn((*it)->changedAspects_)) {
+				batchSteps.push_back(*it);
+				batch.push_back(*it);
+				sbegins.push_back((*it)->scores_.begin() + idx);
+			} else
+				std::copy(oldscores, oldscores + ff[i].getNumberOfScores(), (*it)->scores_.begin() + idx);
+		}
+
+		if(batch.empty())
+			continue;
+
+		PerformanceCounters::Stopwatch watch(perf);
+		ff[i].estimateScoreUpdates(doc, batch, pending.front()->featureStates_[i], oldscores, sbegins, estmods);
+		if(perf) {
+			// the operations are charged an equal share of the batch each
+			watch.stop();
+			watch.record(perf->getFeature(i).estimate, batch.size());
+			for(uint j = 0; j < batchSteps.size(); j++)
+				watch.record(perf->getOperation(batchSteps[j]->operation_).estimate, 1, batch.size());
+		}
+		Float oldWeighted = batchSteps.front()->getWeightedFeatureScore(i, doc.getScores());
+		for(uint j = 0; j < batchSteps.size(); j++) {
+			batchSteps[j]->stateModifications_[i] = estmods[j];
+			batchSteps[j]->score_ += batchSteps[j]->getWeightedFeatureScore(i) - oldWeighted;
+		}
+	}
+
+	for(std::vector<SearchStep *>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+		(*it)->initialEstimate_ = (*it)->score_;
+		(*it)->scoreState_ = ScoresEstimated;
+	}
+}
+
+void SearchStep::computeBatchScores(const std::vector<SearchStep *> &steps) {
+	estimateBatchScores(steps);
+
+	// steps that have been partially computed by the cascade are finished individually
+	std::vector<SearchStep *> pending;
+	for(std::vector<SearchStep *>::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+		if((*it)->scoreState_ == ScoresComputed)
+			continue;
+		if((*it)->cascadePosition_ > 0)
+			(*it)->computeScores();
+		else
+			pending.push_back(*it);
+	}
+
+	if(pending.empty())
+		return;
+
+	const DocumentState &doc = pending.front()->document_;
+	const DecoderConfiguration &config = pending.front()->configuration_;
+	const DecoderConfiguration::FeatureFunctionList &ff = config.getFeatureFunctions();
+	PerformanceCounters *perf = doc.getPerformanceCounters();
+	std::vector<SearchStep *> batchSteps;
+	std::vector<const SearchStep *> batch;
+	std::vector<Scores::iterator> sbegins;
+	std::vector<FeatureFunction::StateModifications *> estmods;
+	std::vector<Float> estimates;
+	for(uint i = 0; i < ff.size(); i++) {
+		uint idx = ff[i].getScoreIndex();
+
+		batchSteps.clear();
+		batch.clear();
+		sbegins.clear();
+		estmods.clear();
+		estimates.clear();
+		for(std::vector<SearchStep *>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+			if(ff[i].dependsOn((*it)->changedAspects_)) {
+				batchSteps.push_back(*it);
+				batch.push_back(*it);
+				sbegins.push_back((*it)->scores_.begin() + idx);
+				estmods.push_back((*it)->stateModifications_[i]);
+				estimates.push_back((*it)->getWeightedFeatureScore(i));
+			}
+		}
+
+		if(batch.empty())
+			continue;
+
+		PerformanceCounters::Stopwatch watch(perf);
+		bool timed = config.sampleUpdateCost(i);
+		double start = timed ? getMonotonicTime() : .0;
+		ff[i].updateScores(doc, batch, pending.front()->featureStates_[i], estmods,
+			doc.getScores().begin() + idx, sbegins);
+		if(timed)
+			config.recordUpdateCost(i, getMonotonicTime() - start, batch.size());
+		if(perf) {
+			watch.stop();
+			watch.record(perf->getFeature(i).update, batch.size());
+		}
+		for(uint j = 0; j < batchSteps.size(); j++) {
+			batchSteps[j]->stateModifications_[i] = estmods[j];
+			Float exact = batchSteps[j]->getWeightedFeatureScore(i);
+			batchSteps[j]->score_ += exact - estimates[j];
+			if(perf) {
+				watch.record(perf->getOperation(batchSteps[j]->operation_).update, 1, batch.size());
+				perf->recordScoreGap(i, estimates[j], exact);
+			}
+		}
+	}
+
+	boost::shared_ptr<const std::vector<uint> > cascade = config.getFeatureCascade();
+	for(std::vector<SearchStep *>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+		(*it)->cascade_ = cascade;
+		(*it)->cascadePosition_ = cascade->size();
+		(*it)->finishScores();
+	}
+}
+
+Float SearchStep::getWeightedFeatureScore(uint i) const {
+	return getWeightedFeatureScore(i, scores_);
+}
+
+Float SearchStep::getWeightedFeatureScore(uint i, const Scores &scores) const {
+	const FeatureFunctionInstantiation &ff = configuration_.getFeatureFunctions()[i];
+	Scores::const_iterator sbegin = scores.begin() + ff.getScoreIndex();
+	return std::inner_product(sbegin, sbegin + ff.getNumberOfScores(),
+		configuration_.getFeatureWeights().begin() + ff.getScoreIndex(), static_cast<Float>(0));
+}
+
+// Returns false if the step is rejected on the basis of scores found in the
+// document's proposal cache. Cached scores come without state modifications,
+// so they're discarded if the step can't be rejected right away.
+bool SearchStep::checkProposalCache(const AcceptanceDecision &accept) const {
+	if(scoreState_ == NoScores &&
+			document_.getProposalCache().lookup(document_, *this, scores_, sparseScores_, initialEstimate_)) {
+		score_ = std::inner_product(scores_.begin(), scores_.end(), configuration_.getFeatureWeights().begin(), static_cast<Float>(0)) +
+			document_.getSparseScore() + sparseScores_.getWeightedSum();
+		scoreState_ = ScoresCached;
+		countOperationEvent(&PerformanceCounters::OperationCounters::cacheHits);
+	}
+
+	if(scoreState_ != ScoresCached)
+		return true;
+
+	if(!accept(getScoreEstimate(), logProposalRatio_)) {
+		LOG(logger_, debug, "Rejected from proposal cache.");
+		countOperationEvent(&PerformanceCounters::OperationCounters::cacheRejections);
+		return false;
+	}
+
+	scoreState_ = NoScores;
+	return true;
+}
+
 bool SearchStep::isProvisionallyAcceptable(const AcceptanceDecision &accept) const {
-	estimateScores();
-	Float estScore = std::inner_product(scores_.begin(), scores_.end(), configuration_.getFeatureWeights().begin(), static_cast<Float>(0));
-	return accept(estScore);
+	if(!checkProposalCache(accept))
+		return false;
+	if(!accept(getScoreEstimate(), logProposalRatio_)) {
+		document_.getProposalCache().store(document_, *this, scores_, sparseScores_, initialEstimate_);
+		countOperationEvent(&PerformanceCounters::OperationCounters::estimateRejections);
+		return false;
+	}
+	return true;
 }
 
+void SearchStep::countOperationEvent(unsigned long PerformanceCounters::OperationCounters::*counter) const {
+	PerformanceCounters *perf = document_.getPerformanceCounters();
+	if(perf)
+		(perf->getOperation(operation_).*counter)++;
+}
+
+// Computes the exact scores feature by feature, cheapest first, and stops as soon
+// as the step can no longer be accepted. This relies on the same assumption as
+// isProvisionallyAcceptable: the weighted score estimate of each feature is an
+// upper bound of its exact weighted score. If the step is rejected, the scores
+// of the remaining features stay at their estimates.
+// Since the scores of a rejected step are an upper bound of its true score,
+// they're kept in the document's proposal cache and reused to reject the same
+// proposal again without calling the feature functions.
+bool SearchStep::isAcceptable(const AcceptanceDecision &accept) const {
+	if(scoreState_ == ScoresComputed) {
+		if(accept(getScore(), logProposalRatio_))
+			return true;
+		countOperationEvent(&PerformanceCounters::OperationCounters::exactRejections);
+		return false;
+	}
+
+	if(!checkProposalCache(accept))
+		return false;
+
+	ProposalCache &cache = document_.getProposalCache();
+
+	if(!accept(getScoreEstimate(), logProposalRatio_)) {
+		cache.store(document_, *this, scores_, sparseScores_, initialEstimate_);
+		countOperationEvent(&PerformanceCounters::OperationCounters::estimateRejections);
+		return false;
+	}
+
+	if(!cascade_)
+		cascade_ = configuration_.getFeatureCascade();
+
+	// score_ remains an upper bound of the exact score while the cascade runs
+	if(!configuration_.getFeaturePipeline().computeScores(*this, &accept)) {
+		uint feature = (*cascade_)[cascadePosition_ - 1];
+		LOG(logger_, debug, "Early rejection after " << cascadePosition_ << " of "
+			<< cascade_->size() << " features.");
+		cache.store(document_, *this, scores_, sparseScores_, initialEstimate_);
+		countOperationEvent(&PerformanceCounters::OperationCounters::exactRejections);
+		PerformanceCounters *perf = document_.getPerformanceCounters();
+		if(perf)
+			perf->getFeature(feature).cascadeRejections++;
+		return false;
+	}
+
+	finishScores();
+	if(!accept(getScore(), logProposalRatio_)) {
+		cache.store(document_, *this, scores_, sparseScores_, initialEstimate_);
+		countOperationEvent(&PerformanceCounters::OperationCounters::exactRejections);
+		return false;
+	}
+	return true;
+}
@@ -26,15 +26,20 @@
 #include "Docent.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "PerformanceCounters.h"
 #include "PhrasePair.h"
 #include "StateGenerator.h"
 
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 class AcceptanceDecision;
 class DecoderConfiguration;
 
 class SearchStep {
+	template<class Dispatch> friend class DispatchingFeaturePipeline;
+
 public:
 	struct Modification {
 		uint sentno;
@@ -53,7 +58,7 @@ public:
 	};
 	
 private:
-	Logger logger_;
+	static Logger logger_;
 	const DocumentState &document_;
 	DocumentGeneration generation_;
 	const std::vector<FeatureFunction::State *> &featureStates_;
@@ -64,15 +69,39 @@ private:
 	// to see our state before consolidation/score computation.
 	mutable std::vector<FeatureFunction::StateModifications *> stateModifications_;
 	const StateOperation *operation_;
+	uint changedAspects_;
+	// log q(old|new) - log q(new|old) for operations with asymmetric proposal distributions
+	Float logProposalRatio_;
 	mutable std::vector<Modification> modifications_; // mutable for consolidateModifications only!
 	mutable bool modificationsConsolidated_;
 	mutable Scores scores_;
-	mutable enum ScoreState { NoScores, ScoresEstimated, ScoresComputed } scoreState_;
+	// changes to the document's sparse feature values, computed along with
+	// the score estimates
+	mutable SparseScores sparseScores_;
+	// Weighted total of scores_, valid unless the state is NoScores. It starts
+	// from the document score and is updated feature by feature as the scores
+	// are estimated and computed, so only changed features are weighted.
+	mutable Float score_;
+	// Weighted total of the score estimates before any exact scores were
+	// computed, valid unless the state is NoScores.
+	mutable Float initialEstimate_;
+	// ScoresCached means the scores were taken from the document's proposal
+	// cache; there are no state modifications to go with them.
+	mutable enum ScoreState { NoScores, ScoresCached, ScoresEstimated, ScoresComputed } scoreState_;
+	// Order in which the exact scores are computed, and the number of features
+	// in that order that have already been updated.
+	mutable boost::shared_ptr<const std::vector<uint> > cascade_;
+	mutable uint cascadePosition_;
 	
 	void consolidateModifications() const;
 	static bool compareModifications(const Modification &a, const Modification &b);
 	void estimateScores() const;
+	void computeSparseScores() const;
 	void computeScores() const;
+	void finishScores() const;
+	Float getWeightedFeatureScore(uint i) const;
+	Float getWeightedFeatureScore(uint i, const Scores &scores) const;
+	void countOperationEvent(unsigned long PerformanceCounters::OperationCounters::*counter) const;
 
 public:
 	SearchStep(const StateOperation *op, const DocumentState &doc, const std::vector<FeatureFunction::State *> &featureStates);
@@ -85,6 +114,22 @@ public:
 	const std::string getDescription() const {
 	  return operation_->getDescription();
 	}
+
+	uint getChangedAspects() const {
+		return changedAspects_;
+	}
+
+	// Called by state operations that know more about a specific step than
+	// their getChangedAspects function can tell.
+	void restrictChangedAspects(uint aspects) {
+		changedAspects_ &= aspects;
+	}
+
+	// Set by state operations that want their proposal asymmetry corrected for
+	// in the acceptance decision (Metropolis-Hastings).
+	void setLogProposalRatio(Float logProposalRatio) {
+		logProposalRatio_ = logProposalRatio;
+	}
 	
 	const std::vector<Modification> &getModifications() const {
 		if(!modificationsConsolidated_)
@@ -109,16 +154,38 @@ public:
 		return scores_;
 	}
 	
+	// Estimate or compute the scores of several steps proposed on the same
+	// document state, calling each feature function once for all of them.
+	static void estimateBatchScores(const std::vector<SearchStep *> &steps);
+	static void computeBatchScores(const std::vector<SearchStep *> &steps);
+
+	// Only consults the proposal cache, e.g. to discard steps before their
+	// scores are estimated in a batch.
+	bool checkProposalCache(const AcceptanceDecision &accept) const;
 	bool isProvisionallyAcceptable(const AcceptanceDecision &accept) const;
+	bool isAcceptable(const AcceptanceDecision &accept) const;
 
 	Float getScore() const {
 		computeScores();
-		return std::inner_product(scores_.begin(), scores_.end(), configuration_.getFeatureWeights().begin(), static_cast<Float>(0));
+		return score_;
 	}
 	
+	const SparseScores &getSparseScoreChanges() const {
+		estimateScores();
+		return sparseScores_;
+	}
+
 	Float getScoreEstimate() const {
 		estimateScores();
-		return std::inner_product(scores_.begin(), scores_.end(), configuration_.getFeatureWeights().begin(), static_cast<Float>(0));
+		return score_;
+	}
+
+	// Unlike getScoreEstimate, this doesn't depend on how far the scoring
+	// cascade has got, and thus on the cascade order. Statistics that must be
+	// reproducible, like those of the cooling schedules, should use it.
+	Float getInitialScoreEstimate() const {
+		estimateScores();
+		return initialEstimate_;
 	}
 	
 	void setStateModifications(uint i, FeatureFunction::StateModifications *mod) {
@@ -36,6 +36,7 @@
 #include <iterator>
 #include <sstream>
 
+#include <boost/cast.hpp>
 #include <boost/foreach.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/numeric/ublas/matrix_expression.hpp>
@@ -323,7 +324,7 @@ FeatureFunction::State *SemanticSpaceLanguageModel::initDocument(const DocumentS
 	state->vectorCount = 0;
 	uint total_tgtwords = 0;
 	for(uint i = 0; i < segs.size(); i++) {
-		uint ntgtwords = countTargetWords(segs[i].begin(), segs[i].end());
+		uint ntgtwords = doc.getTargetSentence(i).size();
 		total_tgtwords += ntgtwords;
 		LOG(logger_, debug, "Sentence " << i << ": " << ntgtwords << " target words.");
 		state->wordcache[i].reserve(ntgtwords);
@@ -381,7 +382,7 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 		const SearchStep &step, const FeatureFunction::State *ffstate,
 		StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator sbegin) const {
 	LOG(logger_, debug, "SemanticSpaceLanguageModel::updateScore");
-	const SSLMDocumentState &state = dynamic_cast<const SSLMDocumentState &>(*ffstate);
+	const SSLMDocumentState &state = *boost::polymorphic_downcast<const SSLMDocumentState *>(ffstate);
 	Float &s = *sbegin;
 	s = *psbegin;
 
@@ -398,14 +399,12 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 	LOG(logger_, debug, "Chain creation pass");
 	for(uint i = 0; i < mods.size(); i++) {
 		uint sentno = mods[i].sentno;
-		PhraseSegmentation::const_iterator from_it = mods[i].from_it;
-		PhraseSegmentation::const_iterator to_it = mods[i].to_it;
 		const PhraseSegmentation &proposal = mods[i].proposal;
 
-		const PhraseSegmentation &current = doc.getPhraseSegmentation(sentno);
+		const TargetSentence &current = doc.getTargetSentence(sentno);
 
-		uint fromword = countTargetWords(current.begin(), from_it);
-		uint toword = fromword + countTargetWords(from_it, to_it);
+		uint fromword = current.getPhraseStart(mods[i].from);
+		uint toword = current.getPhraseStart(mods[i].to);
 
 		// find out what to replace in the semantic vector list
 		SemList::const_iterator oldsem_start;
@@ -486,11 +485,9 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 		SSLMModificationState modstate;
 
 		uint sentno = mods[i].sentno;
-		PhraseSegmentation::const_iterator from_it = mods[i].from_it;
-		PhraseSegmentation::const_iterator to_it = mods[i].to_it;
 
 		LOG(logger_, debug, "next modification, starting at target word " <<
-			countTargetWords(doc.getPhraseSegmentation(sentno).begin(), from_it));
+			modificationStates[i].old_from_word);
 
 		for(uint j = modificationStates[i].old_from_word; j < modificationStates[i].old_to_word; j++) {
 			LOG(logger_, debug, "(a) minus " << state.wordcache[sentno][j].score);
@@ -528,14 +525,14 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 		uint sentno = it1->sentno;
 		LOG(logger_, debug, "Starting in sentence " << sentno <<
 			", which has " <<
-			countTargetWords(doc.getPhraseSegmentation(sentno)) <<
+			doc.getTargetSentence(sentno).size() <<
 			" target words.");
 		std::vector<SearchStep::Modification>::const_iterator it2 = it1;
 		while(++it2 != mods.end())
 			if(it2->sentno != sentno)
 				break;
 
-		const PhraseSegmentation &current = doc.getPhraseSegmentation(sentno);
+		const TargetSentence &current = doc.getTargetSentence(sentno);
 
 		if(modif->wordcacheMods.empty() || modif->wordcacheMods.back().first != sentno)
 			modif->wordcacheMods.push_back(std::make_pair(sentno, SentenceState_()));
@@ -544,9 +541,7 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 		sntstate->reserve(state.wordcache[sentno].size()); // an approximation
 
 		SentenceState_::const_iterator oldstate1 = state.wordcache[sentno].begin();
-		PhraseSegmentation::const_iterator next_from_it = it1->from_it;
-		SentenceState_::const_iterator oldstate2 = oldstate1 +
-			countTargetWords(current.begin(), next_from_it);
+		SentenceState_::const_iterator oldstate2 = oldstate1 + current.getPhraseStart(it1->from);
 
 		if(sntstate->empty())
 			sntstate->insert(sntstate->end(), oldstate1, oldstate2);
@@ -554,26 +549,25 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 		for(std::vector<SearchStep::Modification>::const_iterator modit = it1; modit != it2;
 				++modit, ++modstateit, ++semmodit) {
 			uint sentno = modit->sentno;
-			PhraseSegmentation::const_iterator from_it = modit->from_it;
-			PhraseSegmentation::const_iterator to_it = modit->to_it;
 
 			LOG(logger_, debug, "next modification, starting at target word " <<
-				countTargetWords(doc.getPhraseSegmentation(sentno).begin(), from_it));
+				current.getPhraseStart(modit->from));
 
 			uint next_sentence;
-			PhraseSegmentation::const_iterator local_next_from_it;
+			uint next_from;
+			uint local_next_from;
 			std::vector<SearchStep::Modification>::const_iterator nextmod = modit + 1;
 			if(nextmod != mods.end()) {
 				next_sentence = nextmod->sentno;
-				next_from_it = (modit + 1)->from_it;
+				next_from = nextmod->from;
 				if(next_sentence == sentno)
-					local_next_from_it = next_from_it;
+					local_next_from = next_from;
 				else
-					local_next_from_it = current.end();
+					local_next_from = current.getNumberOfPhrases();
 			} else {
 				next_sentence = std::numeric_limits<uint>::max();
-				local_next_from_it = current.end();
-				next_from_it = doc.getPhraseSegmentations().back().end();
+				local_next_from = current.getNumberOfPhrases();
+				next_from = 0; // unused
 			}
 
 			PieceVector::const_iterator curpiece =
@@ -601,8 +595,8 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 			}
 			curpiece += 2;
 
-			oldstate1 = oldstate2 + countTargetWords(from_it, to_it);
-			oldstate2 = oldstate1 + countTargetWords(to_it, local_next_from_it);
+			oldstate1 = oldstate2 + current.countWords(modit->from, modit->to);
+			oldstate2 = oldstate1 + current.countWords(modit->to, local_next_from);
 
 			SemList::const_iterator last_semlink = state.semlist.end();
 			--last_semlink;
@@ -618,14 +612,13 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 
 					LOG(logger_, debug, "now in sentence " << sentno <<
 						", which has " <<
-						countTargetWords(doc.getPhraseSegmentation(sentno)) <<
+						doc.getTargetSentence(sentno).size() <<
 						" target words.");
 					modif->wordcacheMods.push_back(std::make_pair(sentno, SentenceState_()));
 					sntstate = &modif->wordcacheMods.back().second;
 					oldstate1 = state.wordcache[sentno].begin();
 					if(sentno == next_sentence)
-						oldstate2 = oldstate1 +
-							countTargetWords(doc.getPhraseSegmentation(sentno).begin(), next_from_it);
+						oldstate2 = oldstate1 + doc.getTargetSentence(sentno).getPhraseStart(next_from);
 					else
 						oldstate2 = state.wordcache[sentno].end();
 				}
@@ -675,8 +668,8 @@ FeatureFunction::StateModifications *SemanticSpaceLanguageModel::updateScore(con
 
 FeatureFunction::State *SemanticSpaceLanguageModel::applyStateModifications(FeatureFunction::State *oldState,
 		FeatureFunction::StateModifications *modif) const {
-	SSLMDocumentState &state = dynamic_cast<SSLMDocumentState &>(*oldState);
-	SSLMDocumentModifications *mod = dynamic_cast<SSLMDocumentModifications *>(modif);
+	SSLMDocumentState &state = *boost::polymorphic_downcast<SSLMDocumentState *>(oldState);
+	SSLMDocumentModifications *mod = boost::polymorphic_downcast<SSLMDocumentModifications *>(modif);
 	for(std::vector<std::pair<uint,SentenceState_> >::iterator it = mod->wordcacheMods.begin();
 			it != mod->wordcacheMods.end(); ++it)
 		state.wordcache[it->first].swap(it->second);
@@ -26,23 +26,19 @@
 #include "SearchStep.h"
 #include "SentenceParityModel.h"
 
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
+#include <boost/cast.hpp>
 
+// Only the number of sentences with an even output length is kept. The
+// lengths themselves are available from the document state, so a step costs
+// time proportional to the number of sentences it modifies.
 struct SentenceParityModelState : public FeatureFunction::State, public FeatureFunction::StateModifications {
-	SentenceParityModelState(uint nsents) : outputLength(nsents) {}
+	SentenceParityModelState(uint nsents) : nsentences(nsents), neven(0) {}
 
-	std::vector<uint> outputLength;
+	uint nsentences;
+	uint neven;
 
 	Float score() const {
-		uint neven = 0;
-		uint nodd = 0;
-		for(uint i = 0; i < outputLength.size(); i++)
-			if(outputLength[i] % 2 == 0)
-				neven++;
-			else
-				nodd++;
-
+		uint nodd = nsentences - neven;
 		if(neven > nodd)
 			return -Float(nodd);
 		else
@@ -54,18 +50,13 @@ struct SentenceParityModelState : public FeatureFunction::State, public FeatureF
 	}
 };
 
-struct WordPenaltyCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
-	Float operator()(const AnchoredPhrasePair &ppair) const {
-		return Float(-ppair.second.get().getTargetPhrase().get().size());
-	};
-};
-
 FeatureFunction::State *SentenceParityModel::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
+	uint nsents = doc.getPhraseSegmentations().size();
 
-	SentenceParityModelState *s = new SentenceParityModelState(segs.size());
-	for(uint i = 0; i < segs.size(); i++)
-		s->outputLength[i] = countTargetWords(segs[i]);
+	SentenceParityModelState *s = new SentenceParityModelState(nsents);
+	for(uint i = 0; i < nsents; i++)
+		if(doc.getTargetSentence(i).size() % 2 == 0)
+			s->neven++;
 
 	*sbegin = s->score();
 	return s;
@@ -77,21 +68,24 @@ void SentenceParityModel::computeSentenceScores(const DocumentState &doc, uint s
 
 FeatureFunction::StateModifications *SentenceParityModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 		Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const SentenceParityModelState *prevstate = dynamic_cast<const SentenceParityModelState *>(state);
+	const SentenceParityModelState *prevstate = boost::polymorphic_downcast<const SentenceParityModelState *>(state);
 	SentenceParityModelState *s = prevstate->clone();
 
-	WordPenaltyCounter counter;
-
+	// the modifications are sorted by sentence number
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+	std::vector<SearchStep::Modification>::const_iterator it = mods.begin();
+	while(it != mods.end()) {
 		uint sentno = it->sentno;
-		PhraseSegmentation::const_iterator from_it = it->from_it;
-		PhraseSegmentation::const_iterator to_it = it->to_it;
-		const PhraseSegmentation &proposal = it->proposal;
-		
-		using namespace boost::lambda;
-		std::for_each(from_it, to_it, s->outputLength[sentno] -= bind(counter, _1));
-		std::for_each(proposal.begin(), proposal.end(), s->outputLength[sentno] += bind(counter, _1));
+		const TargetSentence &current = doc.getTargetSentence(sentno);
+		uint oldlen = current.size();
+		uint newlen = oldlen;
+		for(; it != mods.end() && it->sentno == sentno; ++it)
+			newlen += countTargetWords(it->proposal) - current.countWords(it->from, it->to);
+
+		if(oldlen % 2 == 0)
+			s->neven--;
+		if(newlen % 2 == 0)
+			s->neven++;
 	}
 
 	*sbegin = s->score();
@@ -104,8 +98,8 @@ FeatureFunction::StateModifications *SentenceParityModel::updateScore(const Docu
 }
 
 FeatureFunction::State *SentenceParityModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	SentenceParityModelState *os = dynamic_cast<SentenceParityModelState *>(oldState);
-	SentenceParityModelState *ms = dynamic_cast<SentenceParityModelState *>(modif);
-	os->outputLength.swap(ms->outputLength);
+	SentenceParityModelState *os = boost::polymorphic_downcast<SentenceParityModelState *>(oldState);
+	SentenceParityModelState *ms = boost::polymorphic_downcast<SentenceParityModelState *>(modif);
+	os->neven = ms->neven;
 	return oldState;
 }
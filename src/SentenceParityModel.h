@@ -38,6 +38,10 @@ public:
 		return 1;
 	}
 
+	virtual uint getDependencies() const {
+		return TargetLength;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
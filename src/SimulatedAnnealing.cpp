@@ -24,6 +24,7 @@
 
 #include "CoolingSchedule.h"
 #include "NbestStorage.h"
+#include "ProposalCache.h"
 #include "Random.h"
 #include "SearchStep.h"
 #include "SimulatedAnnealing.h"
@@ -33,6 +34,9 @@
 
 #include <limits>
 
+// number of steps between adjustments of the cooling schedule to a time limit
+static const uint SCHEDULE_ADJUSTMENT_INTERVAL = 256;
+
 struct SimulatedAnnealingSearchState : public SearchState {
 	boost::shared_ptr<DocumentState> document;
 	CoolingSchedule *schedule;
@@ -40,31 +44,38 @@ struct SimulatedAnnealingSearchState : public SearchState {
 
 	SimulatedAnnealingSearchState(boost::shared_ptr<DocumentState> doc, const Parameters &params)
 			: document(doc), nsteps(0) {
-		schedule = CoolingSchedule::createCoolingSchedule(params);
+		schedule = CoolingSchedule::createCoolingSchedule(params, doc->getInputWordCount());
 	}
 
 	~SimulatedAnnealingSearchState() {
 		delete schedule;
 	}
 	
+	uint getNumberOfSteps() const {
+		return nsteps;
+	}
+
 	const boost::shared_ptr<DocumentState>& getLastDocumentState() {
 		return document;
 	}
 };
 
 SimulatedAnnealing::SimulatedAnnealing(const DecoderConfiguration &config, const Parameters &params)
-		: logger_("SimulatedAnnealing"), random_(config.getRandom()),
+		: SearchAlgorithm(params), logger_("SimulatedAnnealing"), random_(config.getRandom()),
 		  generator_(config.getStateGenerator()), parameters_(params) {
 	totalMaxSteps_ = params.get<uint>("max-steps");
 	targetScore_ = params.get<Float>("target-score", std::numeric_limits<Float>::infinity());
 }
 
 SearchState *SimulatedAnnealing::createState(boost::shared_ptr<DocumentState> doc) const {
-	return new SimulatedAnnealingSearchState(doc, parameters_);
+	SearchState *state = new SimulatedAnnealingSearchState(doc, parameters_);
+	setupState(state, *doc);
+	return state;
 }
 
 void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {
 	SimulatedAnnealingSearchState &state = dynamic_cast<SimulatedAnnealingSearchState &>(*sstate);
+	Random::ScopedStream stream(random_, state.getRandomStream());
 
 	LOG(logger_, debug, *state.document);
 
@@ -72,27 +83,44 @@ void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint m
 
 	uint accepted = 0;
 	uint i = 0;
+	double sliceStart = getMonotonicTime();
+	bool timed = generator_.needsOutcomeTiming();
 	while(!state.schedule->isDone() && i < maxSteps && state.nsteps < totalMaxSteps_ &&
-			accepted < maxAccepted && nbest.getBestScore() < targetScore_) {
-		AcceptanceDecision accept(random_, state.schedule->getTemperature(), state.document->getScore());
+			accepted < maxAccepted && nbest.getBestScore() < targetScore_ && !state.isTimeUp()) {
+		// compress the cooling schedule to what we can do in the time that's left
+		if(state.hasDeadline() && i > 0 && i % SCHEDULE_ADJUSTMENT_INTERVAL == 0) {
+			double now = getMonotonicTime();
+			Float stepsPerSecond = i / (now - sliceStart);
+			state.schedule->setRemainingSteps(stepsPerSecond * (state.getDeadline() - now));
+		}
+
+		double start = timed ? getMonotonicTime() : .0;
+		Float oldScore = state.document->getScore();
+		Float temperature = state.schedule->getTemperature();
+		AcceptanceDecision accept(random_, temperature, oldScore);
+		state.document->setSearchTemperature(temperature);
 		SearchStep *step = generator_.createSearchStep(*state.document);
 		state.document->registerAttemptedMove(step);
 		if(step->isProvisionallyAcceptable(accept)) {
-			if(accept(step->getScore())) {
+			if(step->isAcceptable(accept)) {
 				LOG(logger_, debug, "Accepting.");
-				state.schedule->step(step->getScore(), true);
+				state.schedule->step(*step, step->getScore(), true);
+				generator_.registerOutcome(*state.document, step, true, step->getScore() - oldScore,
+					timed ? getMonotonicTime() - start : .0);
 				state.document->applyModifications(step);
 				LOG(logger_, debug, *state.document);
 				nbest.offer(state.document);
 				accepted++;
 			} else {
 				LOG(logger_, debug, "Discarding.");
-				state.schedule->step(step->getScore(), false);
+				state.schedule->step(*step, step->getInitialScoreEstimate(), false);
+				generator_.registerOutcome(*state.document, step, false, 0, timed ? getMonotonicTime() - start : .0);
 				delete step;
 			}
 		} else {
-			state.schedule->step(step->getScoreEstimate(), false);
+			state.schedule->step(*step, step->getInitialScoreEstimate(), false);
 			LOG(logger_, debug, "Discarding.");
+			generator_.registerOutcome(*state.document, step, false, 0, timed ? getMonotonicTime() - start : .0);
 			delete step;
 		}
 		i++;
@@ -114,10 +142,17 @@ void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint m
 	if(nbest.getBestScore() > targetScore_)
 		LOG(logger_, normal, "Found solution with better than target score.");
 
+	if(state.isTimeUp())
+		LOG(logger_, normal, "Time limit reached after " << state.nsteps << " steps.");
+
 	DocumentState::MoveCounts::const_iterator it = state.document->getMoveCounts().begin();
 	while(it != state.document->getMoveCounts().end()) {
 		LOG(logger_, normal, it->second.first << '\t' << it->second.second << '\t'
 			<< it->first->getDescription());
 		++it;
 	}
+
+	const ProposalCache &cache = state.document->getProposalCache();
+	LOG(logger_, verbose, "Proposal cache: " << cache.getHits() << " hits in "
+		<< cache.getLookups() << " lookups");
 }
@@ -0,0 +1,77 @@
+/*
+ *  SparseFeatureRegistry.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "SparseFeatureRegistry.h"
+
+#include <fstream>
+#include <sstream>
+
+SparseFeatureRegistry::Feature *SparseFeatureRegistry::registerFeature(const std::string &name) {
+	FeatureMap_::const_iterator it = featureMap_.find(name);
+	if(it != featureMap_.end())
+		return it->second;
+
+	Feature *f = new Feature();
+	f->id = features_.size();
+	f->name = name;
+	f->weight = Float(0);
+	features_.push_back(f);
+	featureMap_.insert(std::make_pair(name, f));
+	return f;
+}
+
+const SparseFeatureRegistry::Feature *SparseFeatureRegistry::getFeature(const std::string &name) {
+	boost::mutex::scoped_lock lock(mutex_);
+	return registerFeature(name);
+}
+
+void SparseFeatureRegistry::setWeight(const std::string &name, Float weight) {
+	boost::mutex::scoped_lock lock(mutex_);
+	registerFeature(name)->weight = weight;
+}
+
+void SparseFeatureRegistry::loadWeights(const std::string &file) {
+	std::ifstream in(file.c_str());
+	if(!in.good()) {
+		LOG(logger_, error, "Can't open sparse weight file " << file);
+		BOOST_THROW_EXCEPTION(FileFormatException());
+	}
+
+	uint nweights = 0;
+	std::string line;
+	for(uint lineno = 1; getline(in, line); lineno++) {
+		std::istringstream ls(line);
+		std::string name;
+		Float weight;
+		if(!(ls >> name))
+			continue; // empty line
+		if(!(ls >> weight)) {
+			LOG(logger_, error, "Malformed line " << lineno << " in sparse weight file " << file);
+			BOOST_THROW_EXCEPTION(FileFormatException());
+		}
+		setWeight(name, weight);
+		nweights++;
+	}
+
+	LOG(logger_, verbose, "Loaded " << nweights << " sparse feature weights from " << file);
+}
@@ -0,0 +1,72 @@
+/*
+ *  SparseFeatureRegistry.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_SparseFeatureRegistry_h
+#define docent_SparseFeatureRegistry_h
+
+#include "Docent.h"
+
+#include <string>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility.hpp>
+
+// Named sparse features and their weights. Feature functions fire sparse
+// features by name while the search is running, so features are registered
+// on first use; those without a configured weight get weight 0. Features are
+// never removed, and the pointers handed out stay valid for the lifetime of
+// the registry.
+class SparseFeatureRegistry : boost::noncopyable {
+public:
+	struct Feature {
+		// ids are assigned in order of registration and determine the order
+		// in which sparse scores are stored and summed
+		uint id;
+		std::string name;
+		Float weight;
+	};
+
+private:
+	typedef boost::unordered_map<std::string,Feature *> FeatureMap_;
+
+	Logger logger_;
+	boost::mutex mutex_;
+	boost::ptr_vector<Feature> features_;
+	FeatureMap_ featureMap_;
+
+	Feature *registerFeature(const std::string &name);
+
+public:
+	SparseFeatureRegistry() : logger_("SparseFeatureRegistry") {}
+
+	// thread-safe
+	const Feature *getFeature(const std::string &name);
+
+	// Weights may only be set during configuration, before the search starts.
+	void setWeight(const std::string &name, Float weight);
+	// reads lines of the form "name weight"
+	void loadWeights(const std::string &file);
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ *  SparseScores.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_SparseScores_h
+#define docent_SparseScores_h
+
+#include "Docent.h"
+#include "SparseFeatureRegistry.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Values of the sparse features of a document or the changes made to them
+// by a search step. Only non-zero values are stored, sorted by feature id,
+// so the cost of all operations depends on the number of features that
+// fire rather than the number of features known.
+class SparseScores {
+public:
+	typedef SparseFeatureRegistry::Feature Feature;
+	typedef std::pair<const Feature *,Float> Entry;
+	typedef std::vector<Entry>::const_iterator const_iterator;
+
+private:
+	std::vector<Entry> entries_;
+
+	static bool compareIds(const Entry &a, const Entry &b) {
+		return a.first->id < b.first->id;
+	}
+
+public:
+	bool empty() const {
+		return entries_.empty();
+	}
+
+	uint size() const {
+		return entries_.size();
+	}
+
+	const_iterator begin() const {
+		return entries_.begin();
+	}
+
+	const_iterator end() const {
+		return entries_.end();
+	}
+
+	void clear() {
+		entries_.clear();
+	}
+
+	void add(const Feature *feature, Float value) {
+		if(value == Float(0))
+			return;
+		Entry e(feature, value);
+		std::vector<Entry>::iterator it = std::lower_bound(entries_.begin(), entries_.end(), e, compareIds);
+		if(it == entries_.end() || it->first != feature)
+			entries_.insert(it, e);
+		else if((it->second += value) == Float(0))
+			entries_.erase(it);
+	}
+
+	SparseScores &operator+=(const SparseScores &o) {
+		if(o.empty())
+			return *this;
+
+		std::vector<Entry> merged;
+		merged.reserve(entries_.size() + o.entries_.size());
+		const_iterator a = entries_.begin();
+		const_iterator b = o.entries_.begin();
+		while(a != entries_.end() || b != o.entries_.end()) {
+			if(b == o.entries_.end() || (a != entries_.end() && compareIds(*a, *b)))
+				merged.push_back(*a++);
+			else if(a == entries_.end() || compareIds(*b, *a))
+				merged.push_back(*b++);
+			else {
+				Float sum = a->second + b->second;
+				if(sum != Float(0))
+					merged.push_back(Entry(a->first, sum));
+				++a;
+				++b;
+			}
+		}
+		entries_.swap(merged);
+		return *this;
+	}
+
+	Float getWeightedSum() const {
+		Float s = 0;
+		for(const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+			s += it->first->weight * it->second;
+		return s;
+	}
+
+	bool operator==(const SparseScores &o) const {
+		return entries_ == o.entries_;
+	}
+
+	bool operator!=(const SparseScores &o) const {
+		return entries_ != o.entries_;
+	}
+};
+
+// n-best list format: space-separated name=value pairs
+inline std::ostream &operator<<(std::ostream &os, const SparseScores &s) {
+	for(SparseScores::const_iterator it = s.begin(); it != s.end(); ++it) {
+		if(it != s.begin())
+			os << ' ';
+		os << it->first->name << '=' << it->second;
+	}
+	return os;
+}
+
+#endif
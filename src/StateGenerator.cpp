@@ -25,16 +25,21 @@
 #include "DocumentState.h"
 #include "DecoderConfiguration.h"
 #include "FeatureFunction.h"
+#include "PerformanceCounters.h"
 #include "PhrasePair.h"
 #include "PhrasePairCollection.h"
 #include "PhraseTable.h"
 #include "Random.h"
+#include "SearchAlgorithm.h"
 #include "SearchStep.h"
 #include "StateGenerator.h"
 
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <fstream>
+#include <functional>
+#include <limits>
 
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
@@ -43,16 +48,119 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 
+// Optional score-weighted proposal distribution for the operations that pick
+// phrase pairs from the phrase table, configured by the parameters
+// proposal-distribution (uniform or weighted) and proposal-temperature.
+// Phrase pairs are proposed with probability proportional to
+// exp(weighted phrase table score / temperature).
+class PhraseProposalDistribution {
+private:
+	bool weighted_;
+	Float temperature_;
+
+public:
+	PhraseProposalDistribution(Logger &logger, const Parameters &params) {
+		std::string type = params.get<std::string>("proposal-distribution", "uniform");
+		if(type == "uniform")
+			weighted_ = false;
+		else if(type == "weighted")
+			weighted_ = true;
+		else {
+			LOG(logger, error, "Unknown proposal distribution: " << type);
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		temperature_ = params.get<Float>("proposal-temperature", Float(1));
+		if(weighted_ && temperature_ <= 0) {
+			LOG(logger, error, "proposal-temperature must be positive.");
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+	}
+
+	bool isWeighted() const {
+		return weighted_;
+	}
+
+	Float getTemperature() const {
+		return temperature_;
+	}
+
+	const std::vector<Float> &getWeights(const DocumentState &doc) const {
+		return doc.getDecoderConfiguration()->getPhraseTableWeights();
+	}
+
+	void describe(std::ostream &os) const {
+		if(weighted_)
+			os << "proposal-temperature=" << temperature_;
+		else
+			os << "uniform";
+	}
+};
+
 struct ChangePhraseTranslationOperation : public StateOperation {
 private:
 	mutable Logger logger_;
+	PhraseProposalDistribution proposal_;
+	bool metropolisHastings_;
 
 public:
 	ChangePhraseTranslationOperation(const Parameters &params) :
-		logger_("ChangePhraseTranslationOperation") {}
+		logger_("ChangePhraseTranslationOperation"), proposal_(logger_, params),
+		metropolisHastings_(params.get<bool>("metropolis-hastings", false)) {}
+
+	virtual std::string getDescription() const {
+		if(!proposal_.isWeighted())
+			return "ChangePhraseTranslation";
+		std::ostringstream os;
+		os << "ChangePhraseTranslation(";
+		proposal_.describe(os);
+		if(metropolisHastings_)
+			os << ",metropolis-hastings";
+		os << ")";
+		return os.str();
+	}
+
+	virtual uint getChangedAspects() const {
+		return PhrasePairs | TargetWords | TargetLength | TargetSequence;
+	}
+
+	virtual Float getProposalTemperature() const {
+		return proposal_.isWeighted() ? proposal_.getTemperature() : Float(0);
+	}
+
+	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
+};
+
+// Scores all alternative translations of a randomly chosen phrase and
+// proposes the best one (steepest ascent), the best one only if it improves
+// on the current document (hill climbing) or one drawn from the Boltzmann
+// distribution of their scores at the temperature of the search.
+class ExhaustivePhraseTranslationOperation : public StateOperation {
+private:
+	enum Selection { Best, HillClimbing, Boltzmann };
+
+	mutable Logger logger_;
+	Selection selection_;
+	// fixed Boltzmann temperature, 0 to use the temperature of the search
+	Float temperature_;
+
+public:
+	ExhaustivePhraseTranslationOperation(const Parameters &params);
 
 	virtual std::string getDescription() const {
-		return "ChangePhraseTranslation";
+		std::ostringstream os;
+		if(selection_ == Boltzmann && temperature_ > 0)
+			os << "ExhaustivePhraseTranslation(temperature=" << temperature_ << ")";
+		else if(selection_ == Boltzmann)
+			os << "ExhaustivePhraseTranslation(boltzmann)";
+		else if(selection_ == HillClimbing)
+			os << "ExhaustivePhraseTranslation(hill-climbing)";
+		else
+			os << "ExhaustivePhraseTranslation(best)";
+		return os.str();
+	}
+
+	virtual uint getChangedAspects() const {
+		return PhrasePairs | TargetWords | TargetLength | TargetSequence;
 	}
 
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
@@ -72,6 +180,10 @@ public:
 		return os.str();
 	}
 
+	virtual uint getChangedAspects() const {
+		return SourceOrder | TargetSequence;
+	}
+
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
 };
 
@@ -89,6 +201,10 @@ public:
 		return os.str();
 	}
 
+	virtual uint getChangedAspects() const {
+		return SourceOrder | TargetSequence;
+	}
+
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
 };
 
@@ -106,6 +222,10 @@ public:
 		return os.str();
 	}
 
+	virtual uint getChangedAspects() const {
+		return SourceOrder | TargetSequence;
+	}
+
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
 };
 
@@ -129,26 +249,49 @@ public:
 		return os.str();
 	}
 
+	virtual uint getChangedAspects() const {
+		return SourceOrder | TargetSequence;
+	}
+
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
 };
 
+// The weighted proposal distribution isn't corrected for in the acceptance
+// decision because the probability of proposing a given segmentation, with
+// backtracking, can't be computed cheaply.
 class ResegmentOperation : public StateOperation {
 private:
 	mutable Logger logger_;
 	Float phraseResegmentationDecay_;
+	PhraseProposalDistribution proposal_;
 
 public:
 	ResegmentOperation(const Parameters &params);
 
 	virtual std::string getDescription() const {
 		std::ostringstream os;
-		os << "Resegment(decay=" << phraseResegmentationDecay_ << ")";
+		os << "Resegment(decay=" << phraseResegmentationDecay_;
+		if(proposal_.isWeighted()) {
+			os << ",";
+			proposal_.describe(os);
+		}
+		os << ")";
 		return os.str();
 	}
 
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const;
 };
 
+// Tells a step replacing one phrase pair with another what it doesn't change.
+static void restrictTranslationChange(SearchStep *step, const AnchoredPhrasePair &oldpp, const AnchoredPhrasePair &newpp) {
+	const Phrase &oldTarget = oldpp.second.get().getTargetPhrase();
+	const Phrase &newTarget = newpp.second.get().getTargetPhrase();
+	if(oldTarget == newTarget)
+		step->restrictChangedAspects(PhrasePairs);
+	else if(oldTarget.get().size() == newTarget.get().size())
+		step->restrictChangedAspects(PhrasePairs | TargetWords | TargetSequence);
+}
+
 SearchStep *ChangePhraseTranslationOperation::createSearchStep(const DocumentState &doc) const {
 	const std::vector<boost::shared_ptr<const PhrasePairCollection> > &phraseTranslations = getPhraseTranslations(doc);
 	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
@@ -167,7 +310,10 @@ SearchStep *ChangePhraseTranslationOperation::createSearchStep(const DocumentSta
 	for(uint i = 0; i < ph; i++)
 		++it;
 		
-	AnchoredPhrasePair pp = pcoll.proposeAlternativeTranslation(*it);
+	Float logProposalRatio = Float(0);
+	AnchoredPhrasePair pp = proposal_.isWeighted() ?
+		pcoll.proposeWeightedAlternativeTranslation(*it, proposal_.getTemperature(), logProposalRatio) :
+		pcoll.proposeAlternativeTranslation(*it);
 	
 	if(*it == pp)
 		return NULL;
@@ -176,10 +322,137 @@ SearchStep *ChangePhraseTranslationOperation::createSearchStep(const DocumentSta
 	SearchStep *step = new SearchStep(this, doc, featureStates);
 	PhraseSegmentation::const_iterator endit = it;
 	step->addModification(sentno, ph, ph+1, it, ++endit, PhraseSegmentation(1, pp));
+	if(metropolisHastings_)
+		step->setLogProposalRatio(logProposalRatio);
+
+	restrictTranslationChange(step, *it, pp);
 	
 	return step;
 }
 
+// Candidates scoring more than this many units of temperature below the best
+// one have a relative Boltzmann weight below 1e-8 and aren't scored completely.
+static const Float BOLTZMANN_CUTOFF = 20;
+
+ExhaustivePhraseTranslationOperation::ExhaustivePhraseTranslationOperation(const Parameters &params) :
+		logger_("ExhaustivePhraseTranslationOperation") {
+	std::string selection = params.get<std::string>("selection", "best");
+	if(selection == "best")
+		selection_ = Best;
+	else if(selection == "hill-climbing")
+		selection_ = HillClimbing;
+	else if(selection == "boltzmann")
+		selection_ = Boltzmann;
+	else {
+		LOG(logger_, error, "Unknown selection method for exhaustive phrase translation: " << selection);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+	temperature_ = params.get<Float>("temperature", Float(0));
+}
+
+SearchStep *ExhaustivePhraseTranslationOperation::createSearchStep(const DocumentState &doc) const {
+	const std::vector<boost::shared_ptr<const PhrasePairCollection> > &phraseTranslations = getPhraseTranslations(doc);
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+
+	Random rnd = doc.getDecoderConfiguration()->getRandom();
+
+	uint sentno = doc.drawSentence(rnd);
+	const PhraseSegmentation &sent = sentences[sentno];
+	const PhrasePairCollection &pcoll = *phraseTranslations[sentno];
+
+	uint ph = rnd.drawFromRange(sent.size());
+	PhraseSegmentation::const_iterator it = sent.begin();
+	for(uint i = 0; i < ph; i++)
+		++it;
+	PhraseSegmentation::const_iterator endit = it;
+	++endit;
+
+	std::vector<const AnchoredPhrasePair *> alternatives;
+	pcoll.getAlternativeTranslations(*it, alternatives);
+
+	const std::vector<FeatureFunction::State *> &featureStates = getFeatureStates(doc);
+	std::vector<SearchStep *> steps;
+	steps.reserve(alternatives.size());
+	for(uint i = 0; i < alternatives.size(); i++) {
+		if(*alternatives[i] == *it)
+			continue;
+		SearchStep *step = new SearchStep(this, doc, featureStates);
+		step->addModification(sentno, ph, ph+1, it, endit, PhraseSegmentation(1, *alternatives[i]));
+		restrictTranslationChange(step, *it, *alternatives[i]);
+		steps.push_back(step);
+	}
+
+	LOG(logger_, verbose, "exhaustivePhraseTranslation " << sentno << " " << ph << ": "
+		<< steps.size() << " alternatives");
+
+	if(steps.empty())
+		return NULL;
+
+	Float temperature = temperature_ > 0 ? temperature_ : doc.getSearchTemperature();
+	bool sample = selection_ == Boltzmann && temperature > 0;
+
+	// In hill-climbing mode, candidates that can't improve on the current
+	// document are discarded, straight from the proposal cache if possible.
+	Float threshold = -std::numeric_limits<Float>::infinity();
+	std::vector<SearchStep *> candidates;
+	candidates.reserve(steps.size());
+	if(selection_ == HillClimbing) {
+		threshold = doc.getScore();
+		for(uint i = 0; i < steps.size(); i++)
+			if(steps[i]->checkProposalCache(AcceptanceDecision(threshold)))
+				candidates.push_back(steps[i]);
+	} else
+		candidates = steps;
+
+	SearchStep::estimateBatchScores(candidates);
+
+	// The estimates are upper bounds of the exact scores. The candidates are
+	// therefore scored through the feature cascade in order of decreasing
+	// estimates, and scoring stops as soon as no remaining candidate can beat
+	// the threshold: the best exact score found, or for Boltzmann selection the
+	// score below which a candidate's weight relative to the best is negligible.
+	std::vector<std::pair<Float,uint> > order;
+	order.reserve(candidates.size());
+	for(uint i = 0; i < candidates.size(); i++)
+		order.push_back(std::make_pair(candidates[i]->getScoreEstimate(), i));
+	std::sort(order.begin(), order.end(), std::greater<std::pair<Float,uint> >());
+
+	std::vector<SearchStep *> scored;
+	SearchStep *best = NULL;
+	for(uint i = 0; i < order.size() && order[i].first > threshold; i++) {
+		SearchStep *step = candidates[order[i].second];
+		if(!step->isAcceptable(AcceptanceDecision(threshold)))
+			continue;
+		scored.push_back(step);
+		if(best == NULL || step->getScore() > best->getScore()) {
+			best = step;
+			threshold = std::max(threshold, sample ? best->getScore() - BOLTZMANN_CUTOFF * temperature : best->getScore());
+		}
+	}
+
+	LOG(logger_, verbose, "exhaustivePhraseTranslation: " << scored.size() << " of "
+		<< steps.size() << " alternatives scored completely");
+
+	SearchStep *chosen;
+	if(best == NULL)
+		// Nothing improves on the current document. The most promising
+		// candidate is proposed anyway and will be rejected by the search.
+		chosen = order.empty() ? steps.front() : candidates[order.front().second];
+	else if(sample) {
+		std::vector<Float> weights(scored.size());
+		for(uint i = 0; i < scored.size(); i++)
+			weights[i] = std::exp((scored[i]->getScore() - best->getScore()) / temperature);
+		chosen = scored[rnd.drawFromDiscreteDistribution(weights)];
+	} else
+		chosen = best;
+
+	for(uint i = 0; i < steps.size(); i++)
+		if(steps[i] != chosen)
+			delete steps[i];
+
+	return chosen;
+}
+
 PermutePhrasesOperation::PermutePhrasesOperation(const Parameters &params) :
 		logger_("PermutePhrasesOperation") {
 	phrasePermutationDecay_ = params.get<Float>("phrase-permutation-decay");
@@ -215,9 +488,10 @@ SearchStep *PermutePhrasesOperation::createSearchStep(const DocumentState &doc)
 	std::vector<AnchoredPhrasePair> pg(os, oe);
 	std::pair<PhraseSegmentation::const_iterator,std::vector<AnchoredPhrasePair>::iterator> m1;
 	std::pair<PhraseSegmentation::const_reverse_iterator,std::vector<AnchoredPhrasePair>::reverse_iterator> m2;
+	Random::UintGenerator shuffleGenerator = rnd.getUintGenerator();
 	trials = 0;
 	do {
-		std::random_shuffle(pg.begin(), pg.end(), rnd.getUintGenerator());
+		std::random_shuffle(pg.begin(), pg.end(), shuffleGenerator);
 		m1 = std::mismatch(os, oe, pg.begin());
 	} while(m1.first == oe && trials++ < 10);
 	if(m1.first == oe)
@@ -444,7 +718,7 @@ SearchStep *MovePhrasesOperation::createSearchStep(const DocumentState &doc) con
 }
 
 ResegmentOperation::ResegmentOperation(const Parameters &params) :
-		logger_("ResegmentOperation") {
+		logger_("ResegmentOperation"), proposal_(logger_, params) {
 	phraseResegmentationDecay_ = params.get<Float>("phrase-resegmentation-decay");
 }
 
@@ -476,7 +750,9 @@ SearchStep *ResegmentOperation::createSearchStep(const DocumentState &doc) const
 
 	LOG(logger_, debug, "Resegmenting " << tgt);
 
-	PhraseSegmentation newseg = pcoll.proposeSegmentation(tgt);
+	PhraseSegmentation newseg = proposal_.isWeighted() ?
+		pcoll.proposeSegmentation(tgt, proposal_.getWeights(doc), proposal_.getTemperature()) :
+		pcoll.proposeSegmentation(tgt);
 
 	std::pair<PhraseSegmentation::const_iterator,PhraseSegmentation::const_iterator> m1;
 	std::pair<PhraseSegmentation::const_reverse_iterator,PhraseSegmentation::const_reverse_iterator> m2;
@@ -575,7 +851,8 @@ PhraseSegmentation FileReadStateInitialiser::initSegmentation(boost::shared_ptr<
 
 
 StateGenerator::StateGenerator(const std::string &initMethod, const Parameters &params, Random(random)) :
-		logger_("StateGenerator"), random_(random) {
+		logger_("StateGenerator"), random_(random),
+		adaptive_(false), adaptiveMinShare_(1), adaptiveDecay_(1), adaptiveWarmup_(0) {
 	if(initMethod == "monotonic")
 		initialiser_ = new MonotonicStateInitialiser(params);
 	else if(initMethod == "beam-search")
@@ -595,6 +872,8 @@ StateGenerator::~StateGenerator() {
 void StateGenerator::addOperation(Float weight, const std::string &type, const Parameters &params) {
 	if(type == "change-phrase-translation")
 		operations_.push_back(new ChangePhraseTranslationOperation(params));
+	else if(type == "exhaustive-phrase-translation")
+		operations_.push_back(new ExhaustivePhraseTranslationOperation(params));
 	else if(type == "permute-phrases")
 		operations_.push_back(new PermutePhrasesOperation(params));
 	else if(type == "linearise-phrases")
@@ -610,23 +889,157 @@ void StateGenerator::addOperation(Float weight, const std::string &type, const P
 		BOOST_THROW_EXCEPTION(ConfigurationException());
 	}
 	
+	Float temperature = operations_.back().getProposalTemperature();
+	if(temperature > 0 && std::find(proposalTemperatures_.begin(), proposalTemperatures_.end(), temperature) == proposalTemperatures_.end())
+		proposalTemperatures_.push_back(temperature);
+
 	if(!cumulativeOperationDistribution_.empty())
 		weight += cumulativeOperationDistribution_.back();
 	cumulativeOperationDistribution_.push_back(weight);
 }
 
+void StateGenerator::setupOperationSelection(const Parameters &params) {
+	std::string selection = params.get<std::string>("operation-selection", "static");
+	if(selection == "static")
+		adaptive_ = false;
+	else if(selection == "adaptive")
+		adaptive_ = true;
+	else {
+		LOG(logger_, error, "Unknown operation selection method: " << selection);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	adaptiveMinShare_ = params.get<Float>("adaptive-min-share", Float(.2));
+	adaptiveDecay_ = params.get<Float>("adaptive-decay", Float(.999));
+	adaptiveWarmup_ = params.get<uint>("adaptive-warmup", 50);
+
+	if(adaptiveMinShare_ < 0 || adaptiveMinShare_ > 1) {
+		LOG(logger_, error, "adaptive-min-share must be between 0 and 1.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	selection = params.get<std::string>("sentence-selection", "length");
+	if(selection == "length")
+		sentenceSelection_.adaptive = false;
+	else if(selection == "adaptive")
+		sentenceSelection_.adaptive = true;
+	else {
+		LOG(logger_, error, "Unknown sentence selection method: " << selection);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	sentenceSelection_.activityBoost = params.get<Float>("sentence-activity-boost", sentenceSelection_.activityBoost);
+	sentenceSelection_.decay = params.get<Float>("sentence-activity-decay", sentenceSelection_.decay);
+	sentenceSelection_.freezeRejections = params.get<Float>("sentence-freeze-rejections", sentenceSelection_.freezeRejections);
+	sentenceSelection_.freezeSteps = params.get<DocumentGeneration>("sentence-freeze-steps", sentenceSelection_.freezeSteps);
+}
+
+void StateGenerator::registerOutcome(DocumentState &doc, const SearchStep *step, bool accepted, Float gain, double seconds) const {
+	if(adaptive_)
+		doc.registerOperationPayoff(getOperationIndex(step->getOperation()), std::max(gain, Float(0)), seconds, adaptiveDecay_);
+
+	if(!sentenceSelection_.adaptive)
+		return;
+
+	doc.registerSentenceOutcome(step, accepted, sentenceSelection_);
+
+	if(!accepted)
+		return;
+
+	// A change in a document-level feature can open up new improvements in
+	// sentences that weren't touched by the step, so frozen sentences get another chance.
+	const DecoderConfiguration::FeatureFunctionList &ff = doc.getDecoderConfiguration()->getFeatureFunctions();
+	const Scores &oldScores = doc.getScores();
+	const Scores &newScores = step->getScores();
+	for(uint i = 0; i < ff.size(); i++) {
+		if(ff[i].isSentenceLocal())
+			continue;
+		uint idx = ff[i].getScoreIndex();
+		if(!std::equal(oldScores.begin() + idx, oldScores.begin() + idx + ff[i].getNumberOfScores(), newScores.begin() + idx)) {
+			doc.unfreezeSentences(sentenceSelection_);
+			break;
+		}
+	}
+}
+
+uint StateGenerator::getOperationIndex(const StateOperation *op) const {
+	uint i = 0;
+	while(&operations_[i] != op)
+		i++;
+	return i;
+}
+
+// Until every operation has been tried a few times, and as long as none of
+// them has achieved any improvement, the configured distribution is used.
+// The rates are accumulated in cumulative before it's turned into a
+// distribution, so the document's buffer is reused without allocating.
+void StateGenerator::computeAdaptiveDistribution(const DocumentState &doc, std::vector<Float> &cumulative) const {
+	const DocumentState::OperationPayoffs &payoffs = doc.getOperationPayoffs();
+	uint nops = operations_.size();
+
+	if(payoffs.size() < nops) {
+		cumulative = cumulativeOperationDistribution_;
+		return;
+	}
+
+	cumulative.resize(nops);
+	Float totalRate = 0;
+	for(uint i = 0; i < nops; i++) {
+		const DocumentState::OperationPayoff &p = payoffs[i];
+		if(p.attempts < adaptiveWarmup_) {
+			cumulative = cumulativeOperationDistribution_;
+			return;
+		}
+		cumulative[i] = p.seconds > 0 ? p.gain / p.seconds : Float(0);
+		totalRate += cumulative[i];
+	}
+
+	if(totalRate <= 0) {
+		cumulative = cumulativeOperationDistribution_;
+		return;
+	}
+
+	Float totalWeight = cumulativeOperationDistribution_.back();
+	Float sum = 0;
+	for(uint i = 0; i < nops; i++) {
+		Float prior = cumulativeOperationDistribution_[i] - (i > 0 ? cumulativeOperationDistribution_[i - 1] : Float(0));
+		sum += adaptiveMinShare_ * prior / totalWeight + (1 - adaptiveMinShare_) * cumulative[i] / totalRate;
+		cumulative[i] = sum;
+	}
+}
+
+// The adaptive distribution is cached in the document until registerOutcome
+// changes the payoffs.
+const std::vector<Float> &StateGenerator::getOperationDistribution(const DocumentState &doc) const {
+	if(!adaptive_)
+		return cumulativeOperationDistribution_;
+
+	if(doc.operationDistribution_.empty())
+		computeAdaptiveDistribution(doc, doc.operationDistribution_);
+	return doc.operationDistribution_;
+}
+
 SearchStep *StateGenerator::createSearchStep(const DocumentState &doc) const {
+	const std::vector<Float> &distribution = getOperationDistribution(doc);
+
+	PerformanceCounters *perf = doc.getPerformanceCounters();
 	SearchStep *nextStep;
 	for(;;) {
-		uint next_op = random_.drawFromCumulativeDistribution(cumulativeOperationDistribution_);
+		uint next_op = random_.drawFromCumulativeDistribution(distribution);
+		PerformanceCounters::Stopwatch watch(perf);
 		nextStep = operations_[next_op].createSearchStep(doc);
+		bool failed = nextStep == NULL || nextStep->getModifications().empty();
+		if(perf) {
+			watch.stop();
+			PerformanceCounters::OperationCounters &oc = perf->getOperation(next_op);
+			watch.record(oc.propose);
+			if(failed)
+				oc.failedProposals++;
+		}
 		
 		// NULL just indicates that our operator wasn't able to produce a reasonable set of changes
 		// for some reason.
-		if(nextStep == NULL)
-			continue;
-
-		if(!nextStep->getModifications().empty())
+		if(!failed)
 			break;
 		
 		delete nextStep;
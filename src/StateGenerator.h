@@ -51,6 +51,18 @@ public:
 	virtual ~StateOperation() {}
 	virtual std::string getDescription() const = 0;
 	virtual SearchStep *createSearchStep(const DocumentState &doc) const = 0;
+
+	// Bitwise OR of the StateAspects the steps created by this operation may change.
+	virtual uint getChangedAspects() const {
+		return AllAspects;
+	}
+
+	// Temperature of the weighted alternative translations drawn by the
+	// operation from the distributions precomputed in the phrase pair
+	// collections, 0 if it doesn't use them.
+	virtual Float getProposalTemperature() const {
+		return 0;
+	}
 };
 
 struct StateInitialiser {
@@ -67,11 +79,62 @@ private:
 	boost::ptr_vector<StateOperation> operations_;
 	std::vector<Float> cumulativeOperationDistribution_;
 	StateInitialiser *initialiser_;
+	// distinct non-zero proposal temperatures of the operations
+	std::vector<Float> proposalTemperatures_;
+
+	// Adaptive operation selection shifts probability mass from the configured
+	// operation weights towards the operations with the highest recent score
+	// gain per second in the current document. At least a fraction
+	// adaptiveMinShare_ of the mass is always distributed according to the
+	// configured weights.
+	bool adaptive_;
+	Float adaptiveMinShare_;
+	Float adaptiveDecay_;
+	uint adaptiveWarmup_;
+
+	DocumentState::SentenceSelectionPolicy sentenceSelection_;
+
+	void computeAdaptiveDistribution(const DocumentState &doc, std::vector<Float> &cumulative) const;
 
 public:
 	StateGenerator(const std::string &initMethod, const Parameters &params, Random random);
 	~StateGenerator();
 	void addOperation(Float weight, const std::string &type, const Parameters &params);
+	void setupOperationSelection(const Parameters &params);
+
+	// Called by the search algorithms after deciding on a step and before applying it.
+	// gain is the score improvement achieved by the step (0 if it was rejected) and
+	// seconds the time spent creating and evaluating it.
+	void registerOutcome(DocumentState &doc, const SearchStep *step, bool accepted, Float gain, double seconds) const;
+
+	// Only adaptive operation selection uses the seconds passed to
+	// registerOutcome. Without it, the search algorithms needn't read the clock.
+	bool needsOutcomeTiming() const {
+		return adaptive_;
+	}
+
+	// the cumulative distribution from which the next operation for the
+	// document is drawn, not necessarily normalised
+	const std::vector<Float> &getOperationDistribution(const DocumentState &doc) const;
+
+	uint getNumberOfOperations() const {
+		return operations_.size();
+	}
+
+	const StateOperation &getOperation(uint i) const {
+		return operations_[i];
+	}
+
+	// position of the operation in the configuration
+	uint getOperationIndex(const StateOperation *op) const;
+
+	const std::vector<Float> &getProposalTemperatures() const {
+		return proposalTemperatures_;
+	}
+
+	const DocumentState::SentenceSelectionPolicy &getSentenceSelectionPolicy() const {
+		return sentenceSelection_;
+	}
 	
 	PhraseSegmentation initSegmentation(
 			boost::shared_ptr<const PhrasePairCollection> phraseTranslations,
@@ -0,0 +1,117 @@
+/*
+ *  StepAllocator.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "NbestStorage.h"
+#include "SearchAlgorithm.h"
+#include "StepAllocator.h"
+
+#include <algorithm>
+#include <limits>
+
+StepAllocator::StepAllocator(const SearchAlgorithm &algorithm, uint sliceSteps, Float minShare) :
+		logger_("StepAllocator"), algorithm_(algorithm), sliceSteps_(sliceSteps), minShare_(minShare) {}
+
+void StepAllocator::addDocument(SearchState *state, NbestStorage &nbest) {
+	Document_ d;
+	d.state = state;
+	d.nbest = &nbest;
+	d.gainPerStep = 0;
+	d.steps = 0;
+	d.finished = false;
+	documents_.push_back(d);
+}
+
+// Documents that haven't had a slice yet come first, then documents that fall
+// short of their minimum share, fewest steps first. Among documents that
+// haven't improved recently, the one with the fewest steps is chosen, so the
+// allocation degrades gracefully to round-robin.
+int StepAllocator::pickDocument() const {
+	unsigned long totalSteps = 0;
+	uint active = 0;
+	for(uint i = 0; i < documents_.size(); i++) {
+		const Document_ &d = documents_[i];
+		if(d.finished)
+			continue;
+		if(d.steps == 0)
+			return i;
+		totalSteps += d.steps;
+		active++;
+	}
+	if(active == 0)
+		return -1;
+
+	Float minSteps = minShare_ * totalSteps / active;
+	int best = -1;
+	int starved = -1;
+	for(uint i = 0; i < documents_.size(); i++) {
+		const Document_ &d = documents_[i];
+		if(d.finished)
+			continue;
+		if(d.steps < minSteps && (starved == -1 || d.steps < documents_[starved].steps))
+			starved = i;
+		if(best == -1)
+			best = i;
+		else {
+			const Document_ &b = documents_[best];
+			if(d.gainPerStep > b.gainPerStep || (d.gainPerStep == b.gainPerStep && d.steps < b.steps))
+				best = i;
+		}
+	}
+	return starved != -1 ? starved : best;
+}
+
+void StepAllocator::run(unsigned long steps) {
+	while(steps > 0) {
+		int i = pickDocument();
+		if(i == -1) {
+			LOG(logger_, normal, "All documents finished.");
+			return;
+		}
+
+		Document_ &d = documents_[i];
+		uint slice = static_cast<uint>(std::min<unsigned long>(sliceSteps_, steps));
+		Float before = d.nbest->getBestScore();
+		if(before == -std::numeric_limits<Float>::infinity())
+			before = d.state->getLastDocumentState()->getScore();
+		uint stepsBefore = d.state->getNumberOfSteps();
+
+		algorithm_.search(d.state, *d.nbest, slice, std::numeric_limits<uint>::max());
+
+		uint done = d.state->getNumberOfSteps() - stepsBefore;
+		registerSlice(i, slice, done, d.nbest->getBestScore() - before);
+
+		steps -= std::min<unsigned long>(done, steps);
+	}
+}
+
+void StepAllocator::registerSlice(uint i, uint slice, uint done, Float gain) {
+	Document_ &d = documents_[i];
+	d.steps += done;
+	d.gainPerStep = done > 0 ? gain / done : Float(0);
+	if(done < slice) {
+		LOG(logger_, verbose, "Document " << i << " finished after " << d.steps << " steps.");
+		d.finished = true;
+	}
+	LOG(logger_, verbose, "Document " << i << ": " << done << " steps, gain per step " << d.gainPerStep);
+}
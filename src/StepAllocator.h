@@ -0,0 +1,80 @@
+/*
+ *  StepAllocator.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_StepAllocator_h
+#define docent_StepAllocator_h
+
+#include "Docent.h"
+
+#include <vector>
+
+class NbestStorage;
+struct SearchAlgorithm;
+struct SearchState;
+
+// Distributes a step budget for a whole testset among its documents. The
+// documents are searched in interleaved slices, and each slice goes to the
+// document whose best score improved most per step in its last slice. Since
+// that gain is only remeasured when a document gets another slice, a document
+// that had one bad slice would never be searched again. To keep exploring,
+// documents that have had less than minShare times the average number of
+// steps of the unfinished documents are served first. A document is finished
+// when a slice ends before its steps are used up, i.e. when the search
+// algorithm has stopped on its own.
+class StepAllocator {
+private:
+	struct Document_ {
+		SearchState *state;
+		NbestStorage *nbest;
+		Float gainPerStep;
+		unsigned long steps;
+		bool finished;
+	};
+
+	Logger logger_;
+	const SearchAlgorithm &algorithm_;
+	uint sliceSteps_;
+	Float minShare_;
+	std::vector<Document_> documents_;
+
+public:
+	StepAllocator(const SearchAlgorithm &algorithm, uint sliceSteps, Float minShare);
+
+	void addDocument(SearchState *state, NbestStorage &nbest);
+
+	// the document that gets the next slice, or -1 if all documents are finished
+	int pickDocument() const;
+
+	// Records that a slice of slice steps on document i took done steps and
+	// improved its best score by gain.
+	void registerSlice(uint i, uint slice, uint done, Float gain);
+
+	// Runs search slices until the given number of steps has been spent or all
+	// documents are finished. Can be called repeatedly to hand out more steps.
+	void run(unsigned long steps);
+
+	unsigned long getStepsForDocument(uint i) const {
+		return documents_[i].steps;
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  TargetSentence.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "SearchStep.h"
+#include "TargetSentence.h"
+
+#include <algorithm>
+
+TargetSentence::TargetSentence(const PhraseSegmentation &seg) : phraseStarts_(1, 0) {
+	phraseStarts_.reserve(seg.size() + 1);
+	appendPhrases(seg.begin(), seg.end());
+}
+
+TargetSentence::TargetSentence(const TargetSentence &base, const SearchStep &step, uint sentno) : phraseStarts_(1, 0) {
+	words_.reserve(base.words_.size());
+	phraseStarts_.reserve(base.phraseStarts_.size());
+
+	// the modifications are sorted by sentence number and position
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	uint next = 0;
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		if(it->sentno != sentno)
+			continue;
+		appendPhrases(base, next, it->from);
+		appendPhrases(it->proposal.begin(), it->proposal.end());
+		next = it->to;
+	}
+	appendPhrases(base, next, base.getNumberOfPhrases());
+}
+
+void TargetSentence::appendPhrases(PhraseSegmentation::const_iterator from_it, PhraseSegmentation::const_iterator to_it) {
+	for(PhraseSegmentation::const_iterator it = from_it; it != to_it; ++it) {
+		const PhraseData &phrase = it->second.get().getTargetPhrase().get();
+		for(PhraseData::const_iterator wit = phrase.begin(); wit != phrase.end(); ++wit)
+			words_.push_back(&*wit);
+		phraseStarts_.push_back(words_.size());
+	}
+}
+
+void TargetSentence::appendPhrases(const TargetSentence &o, uint from, uint to) {
+	if(from == to)
+		return;
+
+	uint offset = words_.size() - o.phraseStarts_[from];
+	words_.insert(words_.end(), o.words_.begin() + o.phraseStarts_[from], o.words_.begin() + o.phraseStarts_[to]);
+	for(uint i = from + 1; i <= to; i++)
+		phraseStarts_.push_back(o.phraseStarts_[i] + offset);
+}
+
+SplicedTargetSentence::SplicedTargetSentence(const TargetSentence &base, const SearchStep &step, uint sentno) {
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	uint next = 0;
+	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+		if(it->sentno != sentno)
+			continue;
+		addOldPiece(base, next, it->from);
+		for(PhraseSegmentation::const_iterator pit = it->proposal.begin(); pit != it->proposal.end(); ++pit)
+			addNewPiece(pit->second.get().getTargetPhrase().get());
+		next = it->to;
+	}
+	addOldPiece(base, next, base.getNumberOfPhrases());
+}
+
+void SplicedTargetSentence::addOldPiece(const TargetSentence &base, uint from, uint to) {
+	uint start = base.getPhraseStart(from);
+	uint length = base.countWords(from, to);
+	if(length == 0)
+		return;
+
+	Piece_ p;
+	p.end = size() + length;
+	p.oldWords = &base.words_[start];
+	p.newWords = NULL;
+	pieces_.push_back(p);
+}
+
+void SplicedTargetSentence::addNewPiece(const PhraseData &words) {
+	if(words.empty())
+		return;
+
+	Piece_ p;
+	p.end = size() + words.size();
+	p.oldWords = NULL;
+	p.newWords = &words[0];
+	pieces_.push_back(p);
+}
+
+const Word &SplicedTargetSentence::operator[](uint i) const {
+	assert(i < size());
+
+	// pieces are few, so a linear search beats bisection
+	std::vector<Piece_>::const_iterator it = pieces_.begin();
+	uint start = 0;
+	while(it->end <= i) {
+		start = it->end;
+		++it;
+	}
+
+	if(it->oldWords != NULL)
+		return *it->oldWords[i - start];
+	else
+		return it->newWords[i - start];
+}
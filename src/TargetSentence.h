@@ -0,0 +1,108 @@
+/*
+ *  TargetSentence.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_TargetSentence_h
+#define docent_TargetSentence_h
+
+#include "Docent.h"
+#include "PhrasePair.h"
+
+#include <cassert>
+#include <vector>
+
+class SearchStep;
+
+// The target words of a translated sentence as a flat array, together with
+// the position of the first word of each phrase. Word positions can thus be
+// found from phrase indices without walking the phrase segmentation. The
+// words point into the flyweight phrase data, which never moves.
+class TargetSentence {
+	friend class SplicedTargetSentence;
+
+private:
+	std::vector<const Word *> words_;
+	// one entry per phrase plus a final one holding the word count
+	std::vector<uint> phraseStarts_;
+
+	void appendPhrases(PhraseSegmentation::const_iterator from_it, PhraseSegmentation::const_iterator to_it);
+	void appendPhrases(const TargetSentence &o, uint from, uint to);
+
+public:
+	TargetSentence() : phraseStarts_(1, 0) {}
+	explicit TargetSentence(const PhraseSegmentation &seg);
+
+	// the sentence that results from applying the modifications of a step to sentence sentno
+	TargetSentence(const TargetSentence &base, const SearchStep &step, uint sentno);
+
+	uint size() const {
+		return words_.size();
+	}
+
+	const Word &operator[](uint i) const {
+		assert(i < words_.size());
+		return *words_[i];
+	}
+
+	uint getNumberOfPhrases() const {
+		return phraseStarts_.size() - 1;
+	}
+
+	// position of the first word of a phrase, or the word count for getNumberOfPhrases()
+	uint getPhraseStart(uint phrase) const {
+		assert(phrase < phraseStarts_.size());
+		return phraseStarts_[phrase];
+	}
+
+	// number of words in phrases [from, to)
+	uint countWords(uint from, uint to) const {
+		return getPhraseStart(to) - getPhraseStart(from);
+	}
+};
+
+// Read-only view of the target words a sentence will have after a search
+// step, made up of pieces of the current sentence and the phrases of the
+// proposals without copying anything. It remains valid as long as the step
+// and the sentence it was created from.
+class SplicedTargetSentence {
+private:
+	struct Piece_ {
+		uint end;
+		const Word * const *oldWords;
+		const Word *newWords;
+	};
+
+	std::vector<Piece_> pieces_;
+
+	void addOldPiece(const TargetSentence &base, uint from, uint to);
+	void addNewPiece(const PhraseData &words);
+
+public:
+	SplicedTargetSentence(const TargetSentence &base, const SearchStep &step, uint sentno);
+
+	uint size() const {
+		return pieces_.empty() ? 0 : pieces_.back().end;
+	}
+
+	const Word &operator[](uint i) const;
+};
+
+#endif
@@ -26,8 +26,9 @@
 #include "SearchStep.h"
 #include "TypeTokenRateModel.h"
 
-#include <boost/lambda/lambda.hpp>
+#include <boost/cast.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/lambda/lambda.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <iostream>
@@ -103,28 +104,21 @@ void TypeTokenRateModel::computeSentenceScores(const DocumentState &doc, uint se
 
 FeatureFunction::StateModifications *TypeTokenRateModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																			 Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const TypeTokenRateModelState *prevstate = dynamic_cast<const TypeTokenRateModelState *>(state);
+	const TypeTokenRateModelState *prevstate = boost::polymorphic_downcast<const TypeTokenRateModelState *>(state);
 	TypeTokenRateModelState *s = prevstate->clone();
 
 	const std::vector<SearchStep::Modification> &mods = step.getModifications();
 	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-
-		// Do Nothing if it is a swap,s ince that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
-
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-		
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
+		PhraseSegmentation::const_iterator from_it = it->from_it;
+		PhraseSegmentation::const_iterator to_it = it->to_it;
 	
+		for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
+			s->removePhrasePair(*pit);	  
 		}
 	
+		BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
+			s->addPhrasePair(app);
+		}
 	}
 	
 	*sbegin = s->score();
@@ -137,8 +131,8 @@ FeatureFunction::StateModifications *TypeTokenRateModel::updateScore(const Docum
 }
 
 FeatureFunction::State *TypeTokenRateModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	TypeTokenRateModelState *os = dynamic_cast<TypeTokenRateModelState *>(oldState);
-	TypeTokenRateModelState *ms = dynamic_cast<TypeTokenRateModelState *>(modif);
+	TypeTokenRateModelState *os = boost::polymorphic_downcast<TypeTokenRateModelState *>(oldState);
+	TypeTokenRateModelState *ms = boost::polymorphic_downcast<TypeTokenRateModelState *>(modif);
 
 	os->types.swap(ms->types);
 	os->tokens = ms->tokens;
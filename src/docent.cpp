@@ -21,6 +21,7 @@
  */
 
 #include <algorithm>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <iterator>
@@ -28,6 +29,8 @@
 
 #include <boost/foreach.hpp>
 #include <boost/lambda/lambda.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/unordered_map.hpp>
 
@@ -35,23 +38,33 @@
 #include "DecoderConfiguration.h"
 #include "DocumentState.h"
 #include "MMAXDocument.h"
+#include "MultiStartSearch.h"
 #include "NbestStorage.h"
 #include "NistXmlTestset.h"
+#include "PerformanceCounters.h"
 #include "Random.h"
 #include "SimulatedAnnealing.h"
+#include "StepAllocator.h"
 
-template<class Testset> void processTestset(const DecoderConfiguration &config, Testset &testset);
+template<class Testset> void processTestset(const DecoderConfiguration &config, Testset &testset,
+	std::ostream *perfOut);
+template<class Testset> void processTestsetWithStepAllocation(const DecoderConfiguration &config, Testset &testset,
+	std::ostream *perfOut);
+static void writePerformanceCounters(std::ostream &os, const DocumentState &doc, PerformanceCounters &total);
 
 int main(int argc, char **argv) {
 	bool showUsage = false;
 	std::vector<std::string> args;
+	std::string perfFile;
 	for(int i = 1; i < argc; i++) {
-		if(!strcmp(argv[i], "-d")) {
+		if(!strcmp(argv[i], "-d") || !strcmp(argv[i], "-p")) {
 			if(i + 1 >= argc) {
 				showUsage = true;
 				break;
-			} else
+			} else if(argv[i][1] == 'd')
 				Logger::setLogLevel(argv[i+1], debug);
+			else
+				perfFile = argv[i+1];
 
 			i++;
 		} else
@@ -59,7 +72,7 @@ int main(int argc, char **argv) {
 	}
 
 	if(showUsage || args.size() < 1 || args.size() > 3) {
-		std::cerr << "Usage: docent config.xml [[input.mmax-dir] input.xml]" << std::endl;
+		std::cerr << "Usage: docent [-p perf.json] config.xml [[input.mmax-dir] input.xml]" << std::endl;
 		return 1;
 	}
 
@@ -75,10 +88,24 @@ int main(int argc, char **argv) {
 	ConfigurationFile cf(configFile);
 	DecoderConfiguration config(cf);
 
+	// performance counters are written as one line of JSON per document and per testset
+	boost::scoped_ptr<std::ofstream> perfOut;
+	if(!perfFile.empty()) {
+		perfOut.reset(new std::ofstream(perfFile.c_str()));
+		if(!perfOut->good()) {
+			std::cerr << "Can't open performance counter file " << perfFile << std::endl;
+			return 1;
+		}
+		config.setCollectPerformanceCounters(true);
+	}
+
 	if(inputMMAX.empty() && inputXML.empty()) {
 		boost::char_separator<char> sep(" ");
 		std::string line;
 		uint docNum = 0;
+		boost::scoped_ptr<PerformanceCounters> totalPerf;
+		if(perfOut)
+			totalPerf.reset(new PerformanceCounters(config));
 		while(getline(std::cin, line)) {
 			boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>();
 			boost::tokenizer<boost::char_separator<char> > tok(line, sep);
@@ -99,32 +126,135 @@ int main(int argc, char **argv) {
 			std::cout << "N-best list size: " << nbestList.size() << std::endl;
 			std::transform(nbestList.begin(), nbestList.end(),
 				std::ostream_iterator<DocumentState>(std::cout, "\n\n"), *boost::lambda::_1);
+			if(perfOut)
+				writePerformanceCounters(*perfOut, *doc, *totalPerf);
 			docNum++;
 		}
+		if(perfOut)
+			totalPerf->writeJson(*perfOut, "testset");
 	} else if(inputMMAX.empty()) {
 		NistXmlTestset testset(inputXML);
-		processTestset(config, testset);
+		processTestset(config, testset, perfOut.get());
 	} else {
 		MMAXTestset testset(inputMMAX, inputXML);
-		processTestset(config, testset);
+		processTestset(config, testset, perfOut.get());
 	}
 
 	return 0;
 }
 
+static uint countInputWords(const MMAXDocument &doc) {
+	uint words = 0;
+	for(uint i = 0; i < doc.getNumberOfSentences(); i++)
+		words += doc.sentence_size(i);
+	return words;
+}
+
+static uint countInputWords(const NistXmlDocument &doc) {
+	return countInputWords(*doc.asMMAXDocument());
+}
+
+static void writePerformanceCounters(std::ostream &os, const DocumentState &doc, PerformanceCounters &total) {
+	const PerformanceCounters &perf = *doc.getPerformanceCounters();
+	perf.writeJson(os, "document", doc.getDocumentNumber());
+	total += perf;
+}
+
 template<class Testset>
-void processTestset(const DecoderConfiguration &config, Testset &testset) {
+void processTestset(const DecoderConfiguration &config, Testset &testset, std::ostream *perfOut) {
+	// The scores go through the log, so they stay in order with the messages
+	// written by the log writer thread.
+	Logger logger("docent");
+	const SearchAlgorithm &algo = config.getSearchAlgorithm();
+
+	if(algo.hasAdaptiveStepAllocation()) {
+		processTestsetWithStepAllocation(config, testset, perfOut);
+		return;
+	}
+
+	boost::scoped_ptr<PerformanceCounters> totalPerf;
+	if(perfOut)
+		totalPerf.reset(new PerformanceCounters(config));
+
+	boost::scoped_ptr<TestsetTimeBudget> budget;
+	if(algo.hasTestsetTimeLimit()) {
+		uint totalWords = 0;
+		BOOST_FOREACH(typename Testset::value_type inputdoc, testset)
+			totalWords += countInputWords(*inputdoc);
+		budget.reset(new TestsetTimeBudget(algo.getTestsetTimeLimit(), totalWords));
+	}
+
 	uint docNum = 0;
 	BOOST_FOREACH(typename Testset::value_type inputdoc, testset) {
 		boost::shared_ptr<DocumentState> doc = boost::make_shared<DocumentState>(config, inputdoc, docNum);
 		NbestStorage nbest(1);
-		std::cerr << "Initial score: " << doc->getScore() << std::endl;
-		config.getSearchAlgorithm().search(doc, nbest);
-		std::cerr << "Final score: " << doc->getScore() << std::endl;
-		inputdoc->setTranslation(doc->asPlainTextDocument());
+		LOG(logger, normal, "Initial score: " << doc->getScore());
+		if(algo.getNumberOfChains() > 1) {
+			MultiStartSearch multi(algo, doc, algo.getNumberOfChains(), nbest.getMaxSize());
+			if(budget)
+				multi.restrictTimeLimit(budget->allocate(doc->getInputWordCount()));
+			multi.search();
+			multi.collectNbest(nbest);
+		} else {
+			SearchState *state = algo.createState(doc);
+			if(budget)
+				state->restrictTimeLimit(budget->allocate(doc->getInputWordCount()));
+			algo.search(state, nbest);
+			delete state;
+		}
+		// with a time limit, the search may have stopped while wandering off the best state
+		const boost::shared_ptr<DocumentState> &best = nbest.getBestDocumentState();
+		LOG(logger, normal, "Final score: " << best->getScore());
+		inputdoc->setTranslation(best->asPlainTextDocument());
+		if(perfOut)
+			writePerformanceCounters(*perfOut, *doc, *totalPerf);
 		docNum++;
 	}
 	testset.outputTranslation(std::cout);
+	if(perfOut)
+		totalPerf->writeJson(*perfOut, "testset");
+}
+
+// Keeps all documents in memory and searches them in interleaved slices
+// handed out by the StepAllocator.
+template<class Testset>
+void processTestsetWithStepAllocation(const DecoderConfiguration &config, Testset &testset, std::ostream *perfOut) {
+	Logger logger("docent");
+	const SearchAlgorithm &algo = config.getSearchAlgorithm();
+
+	std::vector<typename Testset::value_type> inputdocs(testset.begin(), testset.end());
+	std::vector<boost::shared_ptr<DocumentState> > docs;
+	std::vector<SearchState *> states;
+	boost::ptr_vector<NbestStorage> nbest;
+	StepAllocator allocator(algo, algo.getStepAllocationSlice(), algo.getStepAllocationMinShare());
+	for(uint i = 0; i < inputdocs.size(); i++) {
+		boost::shared_ptr<DocumentState> doc = boost::make_shared<DocumentState>(config, inputdocs[i], i);
+		LOG(logger, normal, "Initial score: " << doc->getScore());
+		docs.push_back(doc);
+		states.push_back(algo.createState(doc));
+		if(algo.hasTestsetTimeLimit())
+			states.back()->restrictTimeLimit(algo.getTestsetTimeLimit());
+		nbest.push_back(new NbestStorage(1));
+		allocator.addDocument(states.back(), nbest.back());
+	}
+
+	allocator.run(algo.getTestsetMaxSteps());
+
+	boost::scoped_ptr<PerformanceCounters> totalPerf;
+	if(perfOut)
+		totalPerf.reset(new PerformanceCounters(config));
+	for(uint i = 0; i < inputdocs.size(); i++) {
+		const boost::shared_ptr<DocumentState> &best = nbest[i].getBestDocumentState();
+		LOG(logger, normal, "Final score: " << best->getScore() << " after "
+			<< allocator.getStepsForDocument(i) << " steps");
+		inputdocs[i]->setTranslation(best->asPlainTextDocument());
+		if(perfOut)
+			writePerformanceCounters(*perfOut, *docs[i], *totalPerf);
+		delete states[i];
+	}
+	testset.outputTranslation(std::cout);
+	if(perfOut)
+		totalPerf->writeJson(*perfOut, "testset");
 }
 
 std::ostream &operator<<(std::ostream &os, const std::vector<Word> &phrase) {
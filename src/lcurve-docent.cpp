@@ -32,6 +32,7 @@
 #include <boost/foreach.hpp>
 #include <boost/lambda/lambda.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/archive/tmpdir.hpp>
@@ -45,6 +46,7 @@
 #include "NistXmlTestset.h"
 #include "Random.h"
 #include "SimulatedAnnealing.h"
+#include "StepAllocator.h"
 
 void usage();
 
@@ -161,6 +163,8 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 			}
 			std::ostringstream tos;
 			tos << doc->getScore() << " - " << doc->getScores();
+			if(!doc->getSparseScores().empty())
+				tos << " " << doc->getSparseScores();
 			inputdocs[docNum]->annotateDocument(tos.str());
 			inputdocs[docNum]->setTranslation(ptout);
 
@@ -181,14 +185,33 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 		}
 
 
+		// The documents are searched in interleaved slices of equal numbers of steps,
+		// so they all share the deadline of the testset.
+		if(algo.hasTestsetTimeLimit())
+			for(uint i = 0; i < states.size(); i++)
+				states[i]->restrictTimeLimit(algo.getTestsetTimeLimit());
+
 		uint steps_done = 0;
 		std::vector<NbestStorage> nbest(inputdocs.size(), NbestStorage(1));		
 
+		// With adaptive step allocation, the steps of each round are distributed
+		// among the documents instead of giving each document the same number.
+		boost::scoped_ptr<StepAllocator> allocator;
+		if(algo.hasAdaptiveStepAllocation()) {
+			allocator.reset(new StepAllocator(algo, algo.getStepAllocationSlice(), algo.getStepAllocationMinShare()));
+			for(uint i = 0; i < inputdocs.size(); i++)
+				allocator->addDocument(states[i], nbest[i]);
+		}
+
 		for(uint steps = 256; steps <= 134217728; steps *= 2) {
+			if(allocator)
+				allocator->run(static_cast<unsigned long>(steps - steps_done) * inputdocs.size());
 			for(uint i = 0; i < inputdocs.size(); i++) {
-				std::cerr << "Document " << i << ", approaching " << steps << " steps." << std::endl;
-				//std::cerr << "Initial score: " << docs[i]->getScore() << std::endl;
-				algo.search(states[i], nbest[i], steps - steps_done, std::numeric_limits<uint>::max());
+				if(!allocator) {
+					std::cerr << "Document " << i << ", approaching " << steps << " steps." << std::endl;
+					//std::cerr << "Initial score: " << docs[i]->getScore() << std::endl;
+					algo.search(states[i], nbest[i], steps - steps_done, std::numeric_limits<uint>::max());
+				}
 				std::vector<boost::shared_ptr<const DocumentState> > out(1);
 				nbest[i].copyNbestList(out);
 				std::cerr << "Final score: " << out[0]->getScore() << std::endl;
@@ -204,6 +227,8 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 				}
 				std::ostringstream tos;
 				tos << out[0]->getScore() << " - " << out[0]->getScores();
+				if(!out[0]->getSparseScores().empty())
+					tos << " " << out[0]->getSparseScores();
 				inputdocs[i]->annotateDocument(tos.str());
 				inputdocs[i]->setTranslation(ptout);
 				if(dumpStates)
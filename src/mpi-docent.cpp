@@ -187,8 +187,9 @@ PlainTextDocument DocumentDecoder::runDecoder(const NumberedInputDocument &input
 	NbestStorage nbest(1);
 	std::cerr << "Initial score: " << doc->getScore() << std::endl;
 	configuration_.getSearchAlgorithm().search(doc, nbest);
-	std::cerr << "Final score: " << doc->getScore() << std::endl;
-	return doc->asPlainTextDocument();
+	const boost::shared_ptr<DocumentState> &best = nbest.getBestDocumentState();
+	std::cerr << "Final score: " << best->getScore() << std::endl;
+	return best->asPlainTextDocument();
 }
 
 std::ostream &operator<<(std::ostream &os, const std::vector<Word> &phrase) {
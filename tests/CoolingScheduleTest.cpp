@@ -0,0 +1,116 @@
+/*
+ *  CoolingScheduleTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define BOOST_TEST_MODULE CoolingSchedule
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "CoolingSchedule.h"
+#include "DecoderConfiguration.h"
+
+#include <fstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+// Creates a hill-climbing schedule from a search section with the given
+// parameters and drives it with made-up proposal hashes.
+class HillclimbingTest {
+private:
+	Logger logger_;
+	ConfigurationFile *config_;
+	HillclimbingSchedule *schedule_;
+
+	static ConfigurationFile *writeConfiguration(const std::string &params) {
+		boost::filesystem::path file = boost::filesystem::temp_directory_path() /
+			boost::filesystem::unique_path("docent-test-%%%%-%%%%-%%%%.xml");
+		std::ofstream(file.string().c_str()) << "<?xml version=\"1.0\" ?>\n<search>\n" << params << "</search>\n";
+		ConfigurationFile *config = new ConfigurationFile(file.string());
+		boost::filesystem::remove(file);
+		return config;
+	}
+
+public:
+	HillclimbingTest(const std::string &params, uint inputWords) :
+			logger_("CoolingScheduleTest"), config_(writeConfiguration(params)) {
+		schedule_ = new HillclimbingSchedule(Parameters(logger_, config_->getXMLDocument().getDocumentElement()), inputWords);
+	}
+
+	~HillclimbingTest() {
+		delete schedule_;
+		delete config_;
+	}
+
+	// Rejects proposals with hashes drawn in turn from a neighbourhood of the
+	// given size until the schedule is done, and returns the number of steps.
+	uint rejectUntilDone(uint neighbourhood, uint limit) {
+		uint steps = 0;
+		while(!schedule_->isDone() && steps < limit) {
+			schedule_->step(std::size_t(steps % neighbourhood), Float(0), false);
+			steps++;
+		}
+		return steps;
+	}
+
+	void accept() {
+		schedule_->step(std::size_t(12345), Float(1), true);
+	}
+};
+
+static const char *EXHAUSTION = "\t<p name=\"hill-climbing:termination\">exhaustion</p>\n";
+
+// With a neighbourhood of 50 proposals drawn in turn, every proposal has been
+// seen twice after 100 rejections and no singletons are left. That's also the
+// minimum number of rejections.
+BOOST_AUTO_TEST_CASE(exhaustedNeighbourhood) {
+	HillclimbingTest test(EXHAUSTION, 100);
+	BOOST_CHECK_EQUAL(test.rejectUntilDone(50, 100000), 100u);
+
+	// an acceptance starts a new neighbourhood
+	test.accept();
+	BOOST_CHECK_EQUAL(test.rejectUntilDone(50, 100000), 100u);
+
+	// In a neighbourhood of 80, one singleton is left after 159 rejections,
+	// which is below the unseen mass of 1%.
+	test.accept();
+	BOOST_CHECK_EQUAL(test.rejectUntilDone(80, 100000), 159u);
+}
+
+// If every proposal is new, the neighbourhood is never exhausted, and the
+// safety limit depends on the length of the document.
+BOOST_AUTO_TEST_CASE(exhaustionSafetyLimit) {
+	HillclimbingTest shortDoc(EXHAUSTION, 10);
+	BOOST_CHECK_EQUAL(shortDoc.rejectUntilDone(100000, 100000), 1001u);
+
+	HillclimbingTest longDoc(EXHAUSTION, 200);
+	BOOST_CHECK_EQUAL(longDoc.rejectUntilDone(100000, 100000), 4001u);
+
+	HillclimbingTest explicitLimit(std::string(EXHAUSTION) + "\t<p name=\"hill-climbing:max-rejected\">500</p>\n", 200);
+	BOOST_CHECK_EQUAL(explicitLimit.rejectUntilDone(100000, 100000), 501u);
+}
+
+// By default, only the number of rejections counts.
+BOOST_AUTO_TEST_CASE(rejectionTermination) {
+	HillclimbingTest test("", 200);
+	BOOST_CHECK_EQUAL(test.rejectUntilDone(50, 100000), 1001u);
+}
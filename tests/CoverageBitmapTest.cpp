@@ -0,0 +1,196 @@
+/*
+ *  CoverageBitmapTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE CoverageBitmap
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "CoverageBitmap.h"
+
+#include <sstream>
+
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/dynamic_bitset.hpp>
+
+typedef CoverageBitmap::size_type size_type;
+
+// The checks bind their arguments to references, and the class constant has
+// no out-of-line definition.
+static const size_type npos = CoverageBitmap::npos;
+
+// sizes on both sides of the boundary between inline and heap storage
+static const size_type sizes[] = {
+	0, 1, 63, 64, 65,
+	CoverageBitmap::INLINE_BITS - 1, CoverageBitmap::INLINE_BITS, CoverageBitmap::INLINE_BITS + 1,
+	2 * CoverageBitmap::INLINE_BITS + 3
+};
+static const uint nSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+// every third bit and the last one
+static CoverageBitmap pattern(size_type size) {
+	CoverageBitmap bm(size);
+	for(size_type i = 0; i < size; i += 3)
+		bm.set(i);
+	if(size > 0)
+		bm.set(size - 1);
+	return bm;
+}
+
+static boost::dynamic_bitset<> toDynamicBitset(const CoverageBitmap &bm) {
+	boost::dynamic_bitset<> d(bm.size());
+	for(size_type i = 0; i < bm.size(); i++)
+		d[i] = bm.test(i);
+	return d;
+}
+
+BOOST_AUTO_TEST_SUITE(CoverageBitmapTests)
+
+BOOST_AUTO_TEST_CASE(inlineBoundary) {
+	BOOST_CHECK_EQUAL(size_type(CoverageBitmap::INLINE_BITS), size_type(256));
+	for(uint k = 0; k < nSizes; k++) {
+		size_type size = sizes[k];
+		CoverageBitmap bm(size);
+		BOOST_CHECK_EQUAL(bm.size(), size);
+		BOOST_CHECK(bm.none());
+		BOOST_CHECK_EQUAL(bm.find_first(), npos);
+		BOOST_CHECK_EQUAL(bm.find_last(), npos);
+		if(size == 0)
+			continue;
+
+		bm.set();
+		BOOST_CHECK_EQUAL(bm.count(), size);
+		BOOST_CHECK_EQUAL(bm.find_last(), size - 1);
+		bm.flip();
+		BOOST_CHECK(bm.none());
+
+		bm = pattern(size);
+		boost::dynamic_bitset<> d = toDynamicBitset(bm);
+		BOOST_CHECK_EQUAL(bm.count(), d.count());
+		BOOST_CHECK_EQUAL(bm.find_last(), size - 1);
+		size_type i = bm.find_first();
+		for(size_type j = d.find_first(); j != d.npos; j = d.find_next(j)) {
+			BOOST_REQUIRE_EQUAL(i, j);
+			i = bm.find_next(i);
+		}
+		BOOST_CHECK_EQUAL(i, npos);
+
+		// flipping mustn't set the unused bits of the last block
+		CoverageBitmap f = ~bm;
+		BOOST_CHECK_EQUAL(f.count(), size - bm.count());
+		BOOST_CHECK(!f.intersects(bm));
+		BOOST_CHECK_EQUAL((f | bm).count(), size);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(copyAndAssign) {
+	for(uint k = 0; k < nSizes; k++) {
+		CoverageBitmap a = pattern(sizes[k]);
+		CoverageBitmap copy(a);
+		BOOST_CHECK(copy == a);
+
+		// between all combinations of inline and heap storage
+		for(uint l = 0; l < nSizes; l++) {
+			CoverageBitmap b = pattern(sizes[l]);
+			b = a;
+			BOOST_REQUIRE_EQUAL(b.size(), a.size());
+			BOOST_REQUIRE(b == a);
+			if(sizes[k] > 0) {
+				// the copies mustn't share their blocks
+				b.flip(sizes[k] - 1);
+				BOOST_REQUIRE(b != a);
+			}
+		}
+
+		CoverageBitmap &self = a;
+		a = self;
+		BOOST_CHECK(a == copy);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(resizeKeepsBits) {
+	for(uint k = 0; k < nSizes; k++) {
+		for(uint l = 0; l < nSizes; l++) {
+			CoverageBitmap bm = pattern(sizes[k]);
+			CoverageBitmap old(bm);
+			bm.resize(sizes[l], true);
+			BOOST_REQUIRE_EQUAL(bm.size(), sizes[l]);
+			size_type expected = 0;
+			for(size_type i = 0; i < sizes[l]; i++) {
+				bool bit = i < sizes[k] ? old.test(i) : true;
+				BOOST_REQUIRE_EQUAL(bm.test(i), bit);
+				expected += bit;
+			}
+			// no bits left over beyond the new size
+			BOOST_REQUIRE_EQUAL(bm.count(), expected);
+		}
+	}
+}
+
+// The archive format is that of dynamic_bitset, so binarised phrase tables
+// written before CoverageBitmap was introduced stay readable.
+BOOST_AUTO_TEST_CASE(serializationRoundTrip) {
+	for(uint k = 0; k < nSizes; k++) {
+		CoverageBitmap bm = pattern(sizes[k]);
+
+		std::ostringstream os;
+		{
+			boost::archive::text_oarchive oa(os);
+			oa << const_cast<const CoverageBitmap &>(bm);
+		}
+
+		// into bitmaps of different storage
+		for(uint l = 0; l < nSizes; l++) {
+			CoverageBitmap loaded = pattern(sizes[l]);
+			std::istringstream is(os.str());
+			boost::archive::text_iarchive ia(is);
+			ia >> loaded;
+			BOOST_REQUIRE(loaded == bm);
+		}
+
+		std::istringstream is(os.str());
+		boost::archive::text_iarchive ia(is);
+		boost::dynamic_bitset<> d;
+		ia >> d;
+		BOOST_CHECK(d == toDynamicBitset(bm));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(readsDynamicBitset) {
+	for(uint k = 0; k < nSizes; k++) {
+		boost::dynamic_bitset<> d = toDynamicBitset(pattern(sizes[k]));
+
+		std::ostringstream os;
+		{
+			boost::archive::text_oarchive oa(os);
+			oa << const_cast<const boost::dynamic_bitset<> &>(d);
+		}
+
+		std::istringstream is(os.str());
+		boost::archive::text_iarchive ia(is);
+		CoverageBitmap bm;
+		ia >> bm;
+		BOOST_CHECK(bm == pattern(sizes[k]));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,81 @@
+/*
+ *  FeatureFunctionTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define BOOST_TEST_MODULE FeatureFunction
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "SearchStep.h"
+#include "TestDocument.h"
+
+#include <string>
+
+// Both models depend on the output lengths of the sentences, which the two
+// translations of every word in the test document change by one.
+static const char *LENGTH_MODELS =
+	"\t<model type=\"sentence-parity-model\" id=\"sp\"/>\n"
+	"\t<model type=\"sentence-length-model\" id=\"sl\">\n"
+	"\t\t<p name=\"prob-identical\">0.5</p>\n"
+	"\t\t<p name=\"prob-short\">0.25</p>\n"
+	"\t\t<p name=\"decay-short\">0.5</p>\n"
+	"\t\t<p name=\"decay-long\">0.3</p>\n"
+	"\t</model>\n";
+
+static const char *LENGTH_WEIGHTS =
+	"\t<weight model=\"sp\">0.3</weight>\n"
+	"\t<weight model=\"sl\">0.2</weight>\n";
+
+// The scores of steps with several modifications, in the same sentence and
+// in different sentences, must match those of the modified document scored
+// from scratch.
+BOOST_AUTO_TEST_CASE(lengthModelsAfterMultipleModifications) {
+	TestDocument test(LENGTH_MODELS, LENGTH_WEIGHTS);
+	TestOperation op;
+	DocumentState &doc = test.getDocument();
+	const DecoderConfiguration::FeatureFunctionList &ff = test.getConfiguration().getFeatureFunctions();
+
+	for(uint round = 0; round < 4; round++) {
+		SearchStep *step = op.createSearchStep(doc);
+		op.changeTranslations(*step, 0, 0, 1);
+		op.changeTranslations(*step, 0, 2, 3);
+		op.changeTranslations(*step, 1, round % 2, round % 2 + 1);
+		Scores stepScores = step->getScores();
+		doc.applyModifications(step);
+
+		uint checked = 0;
+		for(uint i = 0; i < ff.size(); i++) {
+			if(ff[i].getId() != "sp" && ff[i].getId() != "sl")
+				continue;
+			uint idx = ff[i].getScoreIndex();
+			Scores scratch(ff[i].getNumberOfScores());
+			delete ff[i].initDocument(doc, scratch.begin());
+			BOOST_CHECK_EQUAL(stepScores[idx], scratch[0]);
+			BOOST_CHECK_EQUAL(doc.getScores()[idx], scratch[0]);
+			checked++;
+		}
+		BOOST_CHECK_EQUAL(checked, 2u);
+	}
+}
@@ -0,0 +1,129 @@
+/*
+ *  PhrasePairCollectionTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE PhrasePairCollection
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "PhrasePairCollection.h"
+#include "Random.h"
+#include "TestDocument.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The last phrase of the first sentence, "c", has four translations. At a
+// low proposal temperature, the one with the best phrase table scores has
+// most of the mass, so both ways of leaving out the current translation
+// are exercised.
+struct ProposalFixture {
+	static const Float TEMPERATURE;
+
+	TestDocument test;
+	TestOperation op;
+	std::vector<const AnchoredPhrasePair *> translations;
+	std::vector<Float> weights;
+	Float total;
+
+	ProposalFixture() :
+			test("", "",
+				"c ||| r ||| 0.1 0.1 0.1 0.1 2.718\n"
+				"c ||| y ||| 0.3 0.3 0.3 0.3 2.718\n",
+				"\t<operation type=\"change-phrase-translation\" weight=\"1\">\n"
+				"\t\t<p name=\"proposal-distribution\">weighted</p>\n"
+				"\t\t<p name=\"proposal-temperature\">.2</p>\n"
+				"\t\t<p name=\"metropolis-hastings\">1</p>\n"
+				"\t</operation>\n"), total(0) {
+		const DocumentState &doc = test.getDocument();
+		op.getAlternatives(doc, 0, doc.getPhraseSegmentation(0).back(), translations);
+		for(uint i = 0; i < translations.size(); i++) {
+			weights.push_back(std::exp(PhrasePairCollection::computeProposalLogWeight(translations[i]->second,
+				test.getConfiguration().getPhraseTableWeights(), TEMPERATURE)));
+			total += weights[i];
+		}
+	}
+
+	const PhrasePairCollection &getCollection() {
+		return op.getPhrasePairCollection(test.getDocument(), 0);
+	}
+
+	uint find(const AnchoredPhrasePair &app) const {
+		uint i = 0;
+		while(i < translations.size() && !(*translations[i] == app))
+			i++;
+		return i;
+	}
+};
+
+const Float ProposalFixture::TEMPERATURE = .2;
+
+BOOST_FIXTURE_TEST_SUITE(PhrasePairCollectionTests, ProposalFixture)
+
+// The current translation is never proposed, and the others are proposed in
+// proportion to their weights, q(new|old) = w_new / (Z - w_old).
+BOOST_AUTO_TEST_CASE(proposalFrequencies) {
+	const uint N = 20000;
+	BOOST_REQUIRE_EQUAL(translations.size(), 4u);
+	BOOST_REQUIRE(*std::max_element(weights.begin(), weights.end()) > total / 2);
+
+	for(uint old = 0; old < translations.size(); old++) {
+		std::vector<uint> counts(translations.size());
+		for(uint i = 0; i < N; i++) {
+			Float logProposalRatio;
+			uint proposal = find(getCollection().proposeWeightedAlternativeTranslation(*translations[old],
+				TEMPERATURE, logProposalRatio));
+			BOOST_REQUIRE(proposal < translations.size());
+			counts[proposal]++;
+			BOOST_CHECK_CLOSE(logProposalRatio,
+				std::log(weights[old] / (total - weights[proposal])) - std::log(weights[proposal] / (total - weights[old])),
+				Float(.01));
+		}
+		BOOST_CHECK_EQUAL(counts[old], 0u);
+		for(uint i = 0; i < translations.size(); i++)
+			if(i != old)
+				BOOST_CHECK_SMALL(Float(counts[i]) / N - weights[i] / (total - weights[old]), Float(.02));
+	}
+}
+
+// With the proposal ratio, a Metropolis-Hastings chain with a uniform target
+// distribution visits all translations equally often, however skewed the
+// proposal distribution is.
+BOOST_AUTO_TEST_CASE(metropolisHastingsFrequencies) {
+	const uint N = 40000;
+	Random random = test.getConfiguration().getRandom();
+	std::vector<uint> counts(translations.size());
+	uint current = 0;
+	for(uint i = 0; i < N; i++) {
+		Float logProposalRatio;
+		uint proposal = find(getCollection().proposeWeightedAlternativeTranslation(*translations[current],
+			TEMPERATURE, logProposalRatio));
+		if(std::log(random.draw01()) < logProposalRatio)
+			current = proposal;
+		counts[current]++;
+	}
+	for(uint i = 0; i < translations.size(); i++)
+		BOOST_CHECK_SMALL(Float(counts[i]) / N - Float(1) / translations.size(), Float(.02));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
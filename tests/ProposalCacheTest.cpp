@@ -0,0 +1,125 @@
+/*
+ *  ProposalCacheTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE ProposalCache
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "ProposalCache.h"
+#include "SearchStep.h"
+#include "SparseScores.h"
+#include "TestDocument.h"
+
+struct ProposalCacheFixture {
+	TestOperation op;
+
+	// a step changing the translation of a single phrase
+	SearchStep *createStep(const DocumentState &doc, uint sentno, uint phrase) const {
+		SearchStep *step = op.createSearchStep(doc);
+		op.changeTranslations(*step, sentno, phrase, phrase + 1);
+		return step;
+	}
+
+	void store(const DocumentState &doc, uint sentno, uint phrase) const {
+		SearchStep *step = createStep(doc, sentno, phrase);
+		doc.getProposalCache().store(doc, *step, step->getScores(), step->getSparseScoreChanges(),
+			step->getInitialScoreEstimate());
+		delete step;
+	}
+
+	bool isCached(const DocumentState &doc, uint sentno, uint phrase) const {
+		SearchStep *step = createStep(doc, sentno, phrase);
+		Scores scores;
+		SparseScores sparse;
+		Float estimate;
+		bool hit = doc.getProposalCache().lookup(doc, *step, scores, sparse, estimate);
+		if(hit) {
+			// the cached differences are added back to the current document scores
+			const Scores &exact = step->getScores();
+			BOOST_REQUIRE_EQUAL(scores.size(), exact.size());
+			for(uint i = 0; i < exact.size(); i++)
+				BOOST_CHECK_SMALL(scores[i] - exact[i], Float(1e-4));
+			BOOST_CHECK_SMALL(estimate - step->getInitialScoreEstimate(), Float(1e-4));
+		}
+		delete step;
+		return hit;
+	}
+
+	void apply(DocumentState &doc, uint sentno, uint phrase) const {
+		doc.applyModifications(createStep(doc, sentno, phrase));
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(ProposalCacheTests, ProposalCacheFixture)
+
+BOOST_AUTO_TEST_CASE(lookupAfterStore) {
+	TestDocument test;
+	DocumentState &doc = test.getDocument();
+	ProposalCache &cache = doc.getProposalCache();
+
+	BOOST_CHECK(!isCached(doc, 0, 0));
+	store(doc, 0, 0);
+	BOOST_CHECK(isCached(doc, 0, 0));
+	BOOST_CHECK(!isCached(doc, 0, 1));
+	BOOST_CHECK(!isCached(doc, 1, 0));
+	BOOST_CHECK_EQUAL(cache.getHits(), 1u);
+
+	cache.clear();
+	BOOST_CHECK(!isCached(doc, 0, 0));
+}
+
+// With only sentence-local features, changes to other sentences leave the
+// scores of a proposal valid.
+BOOST_AUTO_TEST_CASE(sentenceGenerations) {
+	TestDocument test;
+	DocumentState &doc = test.getDocument();
+	BOOST_REQUIRE(doc.getProposalCache().usesSentenceGenerations());
+
+	store(doc, 0, 0);
+	store(doc, 1, 0);
+	apply(doc, 1, 1);
+	BOOST_CHECK(isCached(doc, 0, 0));
+	BOOST_CHECK(!isCached(doc, 1, 0));
+
+	apply(doc, 0, 2);
+	BOOST_CHECK(!isCached(doc, 0, 0));
+}
+
+// A feature that isn't sentence-local makes any change invalidate the cache.
+BOOST_AUTO_TEST_CASE(documentGeneration) {
+	TestDocument test("\t<model type=\"sentence-parity-model\" id=\"sp\"/>\n",
+		"\t<weight model=\"sp\">0.1</weight>\n");
+	DocumentState &doc = test.getDocument();
+	BOOST_REQUIRE(!doc.getProposalCache().usesSentenceGenerations());
+
+	store(doc, 0, 0);
+	BOOST_CHECK(isCached(doc, 0, 0));
+	apply(doc, 1, 1);
+	BOOST_CHECK(!isCached(doc, 0, 0));
+
+	// entries stored in the new generation are valid again
+	store(doc, 0, 0);
+	BOOST_CHECK(isCached(doc, 0, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,244 @@
+/*
+ *  RandomTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE Random
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "CoverageBitmap.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+struct RandomFixture {
+	RandomImplementation impl;
+	Random random;
+
+	RandomFixture() : random(impl) {
+		random.seed(1234);
+	}
+};
+
+static std::vector<Float> partialSums(const std::vector<Float> &weights) {
+	std::vector<Float> cumulative(weights.size());
+	std::partial_sum(weights.begin(), weights.end(), cumulative.begin());
+	return cumulative;
+}
+
+BOOST_FIXTURE_TEST_SUITE(RandomTests, RandomFixture)
+
+// At low proposal temperatures, all but the best option get weight 0.
+// Once the best option has been rejected, the remaining options must be
+// drawn uniformly instead of looping forever.
+BOOST_AUTO_TEST_CASE(remainingOptionsWithZeroWeights) {
+	std::vector<Float> weights(5, Float(0));
+	weights[2] = Float(1);
+	std::vector<Float> cumulative = partialSums(weights);
+
+	CoverageBitmap excluded(weights.size());
+	Float remaining = cumulative.back();
+	BOOST_CHECK_EQUAL(random.drawFromRemainingOptions(weights, cumulative, excluded, remaining), 2u);
+	excluded.set(2);
+	remaining -= weights[2];
+
+	while(excluded.count() < weights.size()) {
+		uint choice = random.drawFromRemainingOptions(weights, cumulative, excluded, remaining);
+		BOOST_REQUIRE_LT(choice, weights.size());
+		BOOST_REQUIRE(!excluded.test(choice));
+		excluded.set(choice);
+		remaining -= weights[choice];
+	}
+}
+
+BOOST_AUTO_TEST_CASE(remainingOptionsAllZero) {
+	std::vector<Float> weights(4, Float(0));
+	std::vector<Float> cumulative = partialSums(weights);
+	CoverageBitmap excluded(weights.size());
+	excluded.set(0);
+	excluded.set(3);
+
+	std::vector<uint> counts(weights.size());
+	for(uint i = 0; i < 1000; i++) {
+		Float remaining = 0;
+		counts[random.drawFromRemainingOptions(weights, cumulative, excluded, remaining)]++;
+	}
+	BOOST_CHECK_EQUAL(counts[0], 0u);
+	BOOST_CHECK_EQUAL(counts[3], 0u);
+	BOOST_CHECK_GT(counts[1], 0u);
+	BOOST_CHECK_GT(counts[2], 0u);
+}
+
+// with little mass left, the options are found by walking the weights
+BOOST_AUTO_TEST_CASE(remainingOptionsProportional) {
+	std::vector<Float> weights(4);
+	weights[0] = Float(100);
+	weights[1] = Float(1);
+	weights[2] = Float(0);
+	weights[3] = Float(3);
+	std::vector<Float> cumulative = partialSums(weights);
+	CoverageBitmap excluded(weights.size());
+	excluded.set(0);
+
+	std::vector<uint> counts(weights.size());
+	for(uint i = 0; i < 4000; i++) {
+		Float remaining = weights[1] + weights[3];
+		counts[random.drawFromRemainingOptions(weights, cumulative, excluded, remaining)]++;
+	}
+	BOOST_CHECK_EQUAL(counts[0], 0u);
+	BOOST_CHECK_EQUAL(counts[2], 0u);
+	BOOST_CHECK_CLOSE(Float(counts[3]) / counts[1], Float(3), 20);
+}
+
+BOOST_AUTO_TEST_CASE(fenwickMatchesWeights) {
+	std::vector<Float> weights(37);
+	for(uint i = 0; i < weights.size(); i++)
+		weights[i] = Float(i % 5 == 0 ? 0 : i);
+	FenwickDistribution dist(weights);
+
+	// enough updates to trigger several rebuilds of the partial sums
+	for(uint step = 0; step < 1000; step++) {
+		uint i = random.drawFromRange(weights.size());
+		Float w = random.flipCoin(.25) ? Float(0) : Float(random.drawFromRange(100));
+		weights[i] = w;
+		dist.setWeight(i, w);
+
+		Float total = std::accumulate(weights.begin(), weights.end(), Float(0));
+		BOOST_REQUIRE_EQUAL(dist.empty(), total == 0);
+		if(total > 0) {
+			BOOST_REQUIRE_CLOSE(dist.getTotal(), total, .01);
+			BOOST_REQUIRE_GT(weights[dist.draw(random)], 0);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fenwickProportional) {
+	std::vector<Float> weights(4);
+	weights[0] = Float(1);
+	weights[2] = Float(3);
+	FenwickDistribution dist(weights);
+
+	std::vector<uint> counts(weights.size());
+	for(uint i = 0; i < 8000; i++)
+		counts[dist.draw(random)]++;
+	BOOST_CHECK_EQUAL(counts[1], 0u);
+	BOOST_CHECK_EQUAL(counts[3], 0u);
+	BOOST_CHECK_CLOSE(Float(counts[2]) / counts[0], Float(3), 10);
+
+	// freezing and thawing an option, as done by sentence selection
+	dist.setWeight(2, 0);
+	for(uint i = 0; i < 100; i++)
+		BOOST_REQUIRE_EQUAL(dist.draw(random), 0u);
+	dist.setWeight(0, 0);
+	BOOST_CHECK(dist.empty());
+	dist.setWeight(3, 2);
+	for(uint i = 0; i < 100; i++)
+		BOOST_REQUIRE_EQUAL(dist.draw(random), 3u);
+}
+
+// known-answer test from the Random123 distribution
+BOOST_AUTO_TEST_CASE(philoxKnownAnswer) {
+	const boost::uint32_t expected[] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+	RandomStream stream(0, 0, 0);
+	for(uint i = 0; i < 4; i++)
+		BOOST_CHECK_EQUAL(stream.next(), expected[i]);
+}
+
+// The numbers of a stream only depend on its key, so results are
+// reproducible whatever the order in which documents and chains are searched.
+BOOST_AUTO_TEST_CASE(philoxFixedSeed) {
+	const boost::uint32_t expected[] = { 0x9f6f4d69, 0xa4c1e9a7, 0x24df0c8f, 0xd76a720a, 0x5fed01f8, 0xa9325be1 };
+	RandomStream stream(1234, 5, 6);
+	RandomStream otherChain(1234, 5, 7);
+	RandomStream otherDocument(1234, 6, 6);
+	bool chainDiffers = false, documentDiffers = false;
+	for(uint i = 0; i < 6; i++) {
+		boost::uint32_t x = stream.next();
+		BOOST_CHECK_EQUAL(x, expected[i]);
+		chainDiffers |= otherChain.next() != x;
+		documentDiffers |= otherDocument.next() != x;
+	}
+	BOOST_CHECK(chainDiffers);
+	BOOST_CHECK(documentDiffers);
+}
+
+BOOST_AUTO_TEST_CASE(draw01Open) {
+	for(uint i = 0; i < 10000; i++) {
+		Float x = random.draw01();
+		BOOST_REQUIRE_GT(x, Float(0));
+		BOOST_REQUIRE_LT(x, Float(1));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(drawFromRangeBounds) {
+	for(uint i = 0; i < 100; i++)
+		BOOST_REQUIRE_EQUAL(random.drawFromRange(1), 0u);
+
+	const uint sizes[] = { 2, 3, 7, 1000 };
+	for(uint k = 0; k < 4; k++) {
+		std::vector<uint> counts(sizes[k]);
+		for(uint i = 0; i < 20 * sizes[k]; i++) {
+			uint x = random.drawFromRange(sizes[k]);
+			BOOST_REQUIRE_LT(x, sizes[k]);
+			counts[x]++;
+		}
+		if(sizes[k] < 1000)
+			BOOST_CHECK(std::find(counts.begin(), counts.end(), 0u) == counts.end());
+	}
+
+	// a range for which almost half of the raw numbers are rejected
+	const uint large = (1u << 31) + 1;
+	for(uint i = 0; i < 1000; i++)
+		BOOST_REQUIRE_LT(random.drawFromRange(large), large);
+}
+
+BOOST_AUTO_TEST_CASE(aliasTableFixedSeed) {
+	std::vector<Float> weights(4);
+	for(uint i = 0; i < weights.size(); i++)
+		weights[i] = Float(i + 1);
+	AliasTable table(weights);
+	BOOST_REQUIRE_EQUAL(table.size(), 4u);
+
+	const uint expected[] = { 1, 2, 1, 0, 3, 1, 2, 3, 2, 3 };
+	for(uint i = 0; i < 10; i++)
+		BOOST_CHECK_EQUAL(table.draw(random), expected[i]);
+}
+
+BOOST_AUTO_TEST_CASE(aliasTableProportional) {
+	std::vector<Float> weights(5);
+	weights[0] = Float(1);
+	weights[1] = Float(0);
+	weights[2] = Float(2);
+	weights[3] = Float(.5);
+	weights[4] = Float(.5);
+	AliasTable table(weights);
+
+	std::vector<uint> counts(weights.size());
+	for(uint i = 0; i < 16000; i++)
+		counts[table.draw(random)]++;
+	BOOST_CHECK_EQUAL(counts[1], 0u);
+	BOOST_CHECK_CLOSE(Float(counts[2]) / counts[0], Float(2), 10);
+	BOOST_CHECK_CLOSE(Float(counts[3] + counts[4]) / counts[0], Float(1), 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
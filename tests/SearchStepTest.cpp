@@ -0,0 +1,121 @@
+/*
+ *  SearchStepTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE SearchStep
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "FeaturePipeline.h"
+#include "ProposalCache.h"
+#include "SearchAlgorithm.h"
+#include "SearchStep.h"
+#include "TestDocument.h"
+
+#include <string>
+#include <vector>
+
+// The document-level sentence parity model makes the cascade go through a
+// feature that isn't sentence-local.
+struct SearchStepFixture {
+	TestDocument test;
+	TestOperation op;
+
+	SearchStepFixture() :
+		test("\t<model type=\"sentence-parity-model\" id=\"sp\"/>\n", "\t<weight model=\"sp\">0.3</weight>\n") {}
+
+	SearchStep *createStep(uint sentno, uint from, uint to) {
+		SearchStep *step = op.createSearchStep(test.getDocument());
+		op.changeTranslations(*step, sentno, from, to);
+		return step;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(SearchStepTests, SearchStepFixture)
+
+// Rejecting a step as soon as the partially computed score falls below the
+// threshold must give the same decision as computing all scores first.
+BOOST_AUTO_TEST_CASE(cascadeKeepsDecisions) {
+	DocumentState &doc = test.getDocument();
+	const uint spans[][3] = {
+		{ 0, 0, 1 }, { 0, 1, 2 }, { 0, 2, 3 }, { 0, 0, 2 }, { 0, 1, 3 }, { 0, 0, 3 },
+		{ 1, 0, 1 }, { 1, 1, 2 }, { 1, 0, 2 }
+	};
+	const Float offsets[] = { -10, -.01f, .01f, 10 };
+
+	for(uint round = 0; round < 3; round++) {
+		for(uint i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+			SearchStep *exact = createStep(spans[i][0], spans[i][1], spans[i][2]);
+			Float score = exact->getScore();
+			delete exact;
+
+			for(uint j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+				Float threshold = score + offsets[j];
+				SearchStep *step = createStep(spans[i][0], spans[i][1], spans[i][2]);
+				AcceptanceDecision accept(threshold);
+				BOOST_CHECK_EQUAL(step->isProvisionallyAcceptable(accept) && step->isAcceptable(accept),
+					score > threshold);
+				delete step;
+			}
+		}
+
+		// the second round finds the rejected steps in the proposal cache,
+		// the third one is made on a modified document
+		if(round == 1)
+			doc.applyModifications(createStep(1, 0, 1));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// The pipeline specialised for the standard models must compute the same
+// scores as the generic one.
+BOOST_AUTO_TEST_CASE(pipelinesAgree) {
+	const std::string models =
+		"\t<model type=\"oov-penalty\" id=\"oov\"/>\n"
+		"\t<model type=\"geometric-distortion-model\" id=\"d\"/>\n";
+	const std::string weights =
+		"\t<weight model=\"oov\">0.2</weight>\n"
+		"\t<weight model=\"d\" score=\"0\">0.1</weight>\n"
+		"\t<weight model=\"d\" score=\"1\">0.1</weight>\n";
+	TestDocument standard(models, weights);
+	TestDocument generic(models, weights, "",
+		"\t<operation type=\"change-phrase-translation\" weight=\"1\"/>\n", " pipeline=\"generic\"");
+	BOOST_CHECK_NE(standard.getConfiguration().getFeaturePipeline().getDescription(), "generic");
+	BOOST_CHECK_EQUAL(generic.getConfiguration().getFeaturePipeline().getDescription(), "generic");
+
+	TestOperation op;
+	const uint spans[][3] = { { 0, 0, 1 }, { 0, 1, 3 }, { 0, 0, 3 }, { 1, 0, 2 } };
+	for(uint i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+		SearchStep *s1 = op.createSearchStep(standard.getDocument());
+		SearchStep *s2 = op.createSearchStep(generic.getDocument());
+		op.changeTranslations(*s1, spans[i][0], spans[i][1], spans[i][2]);
+		op.changeTranslations(*s2, spans[i][0], spans[i][1], spans[i][2]);
+		BOOST_CHECK_EQUAL(s1->getScoreEstimate(), s2->getScoreEstimate());
+		const Scores &scores1 = s1->getScores();
+		const Scores &scores2 = s2->getScores();
+		BOOST_CHECK_EQUAL_COLLECTIONS(scores1.begin(), scores1.end(), scores2.begin(), scores2.end());
+		standard.getDocument().applyModifications(s1);
+		generic.getDocument().applyModifications(s2);
+		BOOST_CHECK_EQUAL(standard.getDocument().getScore(), generic.getDocument().getScore());
+	}
+}
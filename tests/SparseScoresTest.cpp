@@ -0,0 +1,150 @@
+/*
+ *  SparseScoresTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE SparseScores
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "SparseFeatureRegistry.h"
+#include "SparseScores.h"
+
+#include <sstream>
+#include <vector>
+
+struct SparseScoresFixture {
+	typedef SparseScores::Feature Feature;
+
+	SparseFeatureRegistry registry;
+	std::vector<const Feature *> features;
+
+	// registered out of alphabetical order, since the ids determine the order
+	SparseScoresFixture() {
+		const char *names[] = { "d", "b", "a", "c", "e" };
+		for(uint i = 0; i < 5; i++) {
+			registry.setWeight(names[i], Float(i + 1));
+			features.push_back(registry.getFeature(names[i]));
+		}
+	}
+
+	static bool isCanonical(const SparseScores &s) {
+		for(SparseScores::const_iterator it = s.begin(); it != s.end(); ++it) {
+			if(it->second == Float(0))
+				return false;
+			if(it != s.begin() && !((it - 1)->first->id < it->first->id))
+				return false;
+		}
+		return true;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(SparseScoresTests, SparseScoresFixture)
+
+BOOST_AUTO_TEST_CASE(registryIds) {
+	for(uint i = 0; i < features.size(); i++)
+		BOOST_CHECK_EQUAL(features[i]->id, i);
+	BOOST_CHECK_EQUAL(registry.getFeature("a"), features[2]);
+	BOOST_CHECK_EQUAL(registry.getFeature("f")->weight, Float(0));
+}
+
+BOOST_AUTO_TEST_CASE(addMergesAndCancels) {
+	SparseScores s;
+	s.add(features[3], Float(1));
+	s.add(features[0], Float(2));
+	s.add(features[1], Float(0));
+	BOOST_CHECK_EQUAL(s.size(), 2u);
+	BOOST_CHECK(isCanonical(s));
+
+	s.add(features[3], Float(4));
+	BOOST_CHECK_EQUAL(s.size(), 2u);
+	BOOST_CHECK_EQUAL((s.begin() + 1)->second, Float(5));
+
+	s.add(features[0], Float(-2));
+	BOOST_CHECK_EQUAL(s.size(), 1u);
+	BOOST_CHECK_EQUAL(s.begin()->first, features[3]);
+	s.add(features[3], Float(-5));
+	BOOST_CHECK(s.empty());
+}
+
+BOOST_AUTO_TEST_CASE(sumMergesAndCancels) {
+	SparseScores a, b;
+	a.add(features[0], Float(1));
+	a.add(features[2], Float(2));
+	a.add(features[4], Float(3));
+	b.add(features[1], Float(4));
+	b.add(features[2], Float(-2));
+	b.add(features[4], Float(1));
+
+	SparseScores sum(a);
+	sum += b;
+	BOOST_CHECK(isCanonical(sum));
+	BOOST_REQUIRE_EQUAL(sum.size(), 3u);
+	BOOST_CHECK_EQUAL(sum.begin()->first, features[0]);
+	BOOST_CHECK_EQUAL((sum.begin() + 1)->first, features[1]);
+	BOOST_CHECK_EQUAL((sum.begin() + 2)->first, features[4]);
+	BOOST_CHECK_EQUAL((sum.begin() + 2)->second, Float(4));
+
+	// a step followed by its inverse leaves the document's scores unchanged
+	SparseScores inverse;
+	for(SparseScores::const_iterator it = b.begin(); it != b.end(); ++it)
+		inverse.add(it->first, -it->second);
+	sum += inverse;
+	BOOST_CHECK(sum == a);
+
+	sum += SparseScores();
+	BOOST_CHECK(sum == a);
+	SparseScores empty;
+	empty += a;
+	BOOST_CHECK(empty == a);
+}
+
+// the merge gives the same result as adding the values one by one
+BOOST_AUTO_TEST_CASE(sumAgreesWithAdd) {
+	for(uint n = 0; n < 200; n++) {
+		SparseScores a, b, expected;
+		for(uint i = 0; i < features.size(); i++) {
+			// small integers, so the sums are exact and often cancel
+			Float x = Float(int((n * 7 + i * 3) % 5) - 2);
+			Float y = Float(int((n * 3 + i * 11) % 5) - 2);
+			a.add(features[i], x);
+			b.add(features[(i + n) % features.size()], y);
+			expected.add(features[i], x);
+			expected.add(features[(i + n) % features.size()], y);
+		}
+		a += b;
+		BOOST_REQUIRE(isCanonical(a));
+		BOOST_REQUIRE(a == expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(weightedSumAndOutput) {
+	SparseScores s;
+	s.add(features[2], Float(2));
+	s.add(features[0], Float(-1));
+	// weights are 1 for d and 3 for a
+	BOOST_CHECK_EQUAL(s.getWeightedSum(), Float(5));
+
+	std::ostringstream os;
+	os << s;
+	BOOST_CHECK_EQUAL(os.str(), "d=-1 a=2");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,275 @@
+/*
+ *  StateGeneratorTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE StateGenerator
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "SearchAlgorithm.h"
+#include "SearchStep.h"
+#include "StateGenerator.h"
+#include "TestDocument.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Two more translations of "c", so the last phrase of the first sentence has
+// three alternatives with different scores.
+static const char *EXTRA_PHRASES =
+	"c ||| r ||| 0.1 0.1 0.1 0.1 2.718\n"
+	"c ||| y ||| 0.3 0.3 0.3 0.3 2.718\n";
+
+// A test document whose only operation is exhaustive phrase translation with
+// the given parameters.
+class ExhaustiveTest {
+private:
+	TestDocument test_;
+	TestOperation op_;
+	std::vector<const AnchoredPhrasePair *> translations_;
+
+	const AnchoredPhrasePair &getCurrent() {
+		return test_.getDocument().getPhraseSegmentation(0).back();
+	}
+
+public:
+	ExhaustiveTest(const std::string &params) :
+			test_("", "", EXTRA_PHRASES,
+				"\t<operation type=\"exhaustive-phrase-translation\" weight=\"1\">\n" + params + "\t</operation>\n") {
+		op_.getAlternatives(test_.getDocument(), 0, getCurrent(), translations_);
+	}
+
+	DocumentState &getDocument() {
+		return test_.getDocument();
+	}
+
+	uint getNumberOfTranslations() const {
+		return translations_.size();
+	}
+
+	uint getCurrentTranslation() {
+		return findTranslation(getCurrent());
+	}
+
+	uint findTranslation(const AnchoredPhrasePair &app) const {
+		uint i = 0;
+		while(i < translations_.size() && !(*translations_[i] == app))
+			i++;
+		return i;
+	}
+
+	// score of the document with "c" translated in the given way
+	Float getScore(uint translation) {
+		if(translation == getCurrentTranslation())
+			return getDocument().getScore();
+		SearchStep *step = op_.createSearchStep(getDocument());
+		op_.changeTranslation(*step, 0, 2, *translations_[translation]);
+		Float score = step->getScore();
+		delete step;
+		return score;
+	}
+
+	void setTranslation(uint translation) {
+		SearchStep *step = op_.createSearchStep(getDocument());
+		op_.changeTranslation(*step, 0, 2, *translations_[translation]);
+		getDocument().applyModifications(step);
+	}
+
+	// the best translation of "c" other than the current one
+	uint getBestAlternative() {
+		uint best = getNumberOfTranslations();
+		for(uint i = 0; i < getNumberOfTranslations(); i++)
+			if(i != getCurrentTranslation() && (best == getNumberOfTranslations() || getScore(i) > getScore(best)))
+				best = i;
+		return best;
+	}
+
+	// Proposes steps until one changes "c" and returns it. The operation
+	// only changes single phrases.
+	SearchStep *propose() {
+		const StateGenerator &generator = test_.getConfiguration().getStateGenerator();
+		for(;;) {
+			SearchStep *step = generator.createSearchStep(getDocument());
+			const SearchStep::Modification &mod = step->getModifications().front();
+			if(mod.sentno == 0 && mod.from == 2)
+				return step;
+			delete step;
+		}
+	}
+
+	uint proposeTranslation() {
+		SearchStep *step = propose();
+		uint translation = findTranslation(step->getModifications().front().proposal.front());
+		delete step;
+		return translation;
+	}
+
+	// Checks the frequencies of the proposed translations against the
+	// Boltzmann distribution of their scores.
+	void checkBoltzmannFrequencies(Float temperature) {
+		const uint N = 4000;
+		uint current = getCurrentTranslation();
+		std::vector<Float> weights(getNumberOfTranslations());
+		Float total = 0;
+		for(uint i = 0; i < weights.size(); i++)
+			if(i != current) {
+				weights[i] = std::exp((getScore(i) - getScore(current)) / temperature);
+				total += weights[i];
+			}
+
+		std::vector<uint> counts(getNumberOfTranslations());
+		for(uint i = 0; i < N; i++)
+			counts[proposeTranslation()]++;
+
+		BOOST_CHECK_EQUAL(counts[current], 0u);
+		for(uint i = 0; i < weights.size(); i++)
+			BOOST_CHECK_SMALL(Float(counts[i]) / N - weights[i] / total, Float(.03));
+	}
+};
+
+BOOST_AUTO_TEST_CASE(bestSelection) {
+	ExhaustiveTest test("\t\t<p name=\"selection\">best</p>\n");
+	BOOST_REQUIRE_EQUAL(test.getNumberOfTranslations(), 4u);
+
+	// the best alternative is proposed even if it's worse than the current translation
+	for(uint i = 0; i < test.getNumberOfTranslations(); i++) {
+		test.setTranslation(i);
+		uint best = test.getBestAlternative();
+		for(uint j = 0; j < 10; j++)
+			BOOST_CHECK_EQUAL(test.proposeTranslation(), best);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(hillClimbingSelection) {
+	ExhaustiveTest test("\t\t<p name=\"selection\">hill-climbing</p>\n");
+
+	for(uint i = 0; i < test.getNumberOfTranslations(); i++) {
+		test.setTranslation(i);
+		uint best = test.getBestAlternative();
+		bool improves = test.getScore(best) > test.getScore(i);
+		for(uint j = 0; j < 10; j++) {
+			SearchStep *step = test.propose();
+			AcceptanceDecision accept(test.getDocument().getScore());
+			bool acceptable = step->isProvisionallyAcceptable(accept) && step->isAcceptable(accept);
+			BOOST_CHECK_EQUAL(acceptable, improves);
+			if(improves)
+				BOOST_CHECK_EQUAL(test.findTranslation(step->getModifications().front().proposal.front()), best);
+			delete step;
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(boltzmannSelection) {
+	ExhaustiveTest test("\t\t<p name=\"selection\">boltzmann</p>\n\t\t<p name=\"temperature\">.5</p>\n");
+	test.checkBoltzmannFrequencies(.5);
+}
+
+// Without a temperature of its own, the operation samples at the temperature
+// of the search, which makes it greedy when the search is.
+BOOST_AUTO_TEST_CASE(boltzmannSelectionAtSearchTemperature) {
+	ExhaustiveTest test("\t\t<p name=\"selection\">boltzmann</p>\n");
+
+	test.getDocument().setSearchTemperature(1e-10);
+	uint best = test.getBestAlternative();
+	for(uint i = 0; i < 10; i++)
+		BOOST_CHECK_EQUAL(test.proposeTranslation(), best);
+
+	test.getDocument().setSearchTemperature(.5);
+	test.checkBoltzmannFrequencies(.5);
+}
+
+// Two change-phrase-translation operations with configured weights 3 and 1,
+// selected adaptively. The payoffs are registered directly in the document,
+// without running any steps.
+class AdaptiveTest {
+private:
+	TestDocument test_;
+
+public:
+	static const uint warmup = 5;
+	static const Float minShare;
+
+	AdaptiveTest() :
+		test_("", "", "",
+			"\t<operation type=\"change-phrase-translation\" weight=\"3\"/>\n"
+			"\t<operation type=\"change-phrase-translation\" weight=\"1\"/>\n"
+			"\t<p name=\"operation-selection\">adaptive</p>\n"
+			"\t<p name=\"adaptive-min-share\">0.2</p>\n"
+			"\t<p name=\"adaptive-warmup\">5</p>\n"
+			"\t<p name=\"adaptive-decay\">1</p>\n") {}
+
+	void registerPayoffs(uint op, uint n, Float gain) {
+		for(uint i = 0; i < n; i++)
+			test_.getDocument().registerOperationPayoff(op, gain, Float(.01), Float(1));
+	}
+
+	// probability of selecting operation i
+	Float getShare(uint i) {
+		const std::vector<Float> &cumulative =
+			test_.getConfiguration().getStateGenerator().getOperationDistribution(test_.getDocument());
+		BOOST_REQUIRE_EQUAL(cumulative.size(), 2u);
+		return (cumulative[i] - (i > 0 ? cumulative[i - 1] : Float(0))) / cumulative.back();
+	}
+};
+
+const uint AdaptiveTest::warmup;
+const Float AdaptiveTest::minShare = Float(.2);
+
+BOOST_AUTO_TEST_CASE(adaptiveWarmup) {
+	AdaptiveTest test;
+	BOOST_CHECK_CLOSE(test.getShare(0), Float(.75), Float(1e-4));
+
+	// the configured weights apply until every operation has been tried often enough
+	test.registerPayoffs(0, 10 * AdaptiveTest::warmup, Float(1));
+	test.registerPayoffs(1, AdaptiveTest::warmup - 1, Float(0));
+	BOOST_CHECK_CLOSE(test.getShare(0), Float(.75), Float(1e-4));
+
+	test.registerPayoffs(1, 1, Float(0));
+	BOOST_CHECK_GT(test.getShare(0), Float(.75));
+}
+
+BOOST_AUTO_TEST_CASE(adaptiveMinShare) {
+	AdaptiveTest test;
+	test.registerPayoffs(0, AdaptiveTest::warmup, Float(0));
+	test.registerPayoffs(1, AdaptiveTest::warmup, Float(1));
+
+	// the operation without any gain keeps its minimum share of the configured
+	// distribution, all the rest goes to the other one
+	BOOST_CHECK_CLOSE(test.getShare(0), AdaptiveTest::minShare * Float(.75), Float(1e-4));
+	BOOST_CHECK_CLOSE(test.getShare(1), AdaptiveTest::minShare * Float(.25) + 1 - AdaptiveTest::minShare, Float(1e-4));
+
+	// with equal rates, the shares are the mixture of the configured and the uniform distribution
+	test.registerPayoffs(0, AdaptiveTest::warmup, Float(1));
+	test.registerPayoffs(1, AdaptiveTest::warmup, Float(0));
+	BOOST_CHECK_CLOSE(test.getShare(0), AdaptiveTest::minShare * Float(.75) + (1 - AdaptiveTest::minShare) * Float(.5), Float(1e-4));
+}
+
+// If no operation has achieved anything yet, there's nothing to adapt to.
+BOOST_AUTO_TEST_CASE(adaptiveZeroRateFallback) {
+	AdaptiveTest test;
+	test.registerPayoffs(0, AdaptiveTest::warmup, Float(0));
+	test.registerPayoffs(1, AdaptiveTest::warmup, Float(0));
+	BOOST_CHECK_CLOSE(test.getShare(0), Float(.75), Float(1e-4));
+	BOOST_CHECK_CLOSE(test.getShare(1), Float(.25), Float(1e-4));
+}
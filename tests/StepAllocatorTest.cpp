@@ -0,0 +1,152 @@
+/*
+ *  StepAllocatorTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE StepAllocator
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "NbestStorage.h"
+#include "SearchAlgorithm.h"
+#include "StepAllocator.h"
+
+#include <fstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+// The allocator is driven with made-up gains through registerSlice, so the
+// search algorithm is never run and no search states are needed.
+class DummySearch : public SearchAlgorithm {
+public:
+	DummySearch(const Parameters &params) : SearchAlgorithm(params) {}
+
+	virtual SearchState *createState(boost::shared_ptr<DocumentState> doc) const {
+		return NULL;
+	}
+
+	virtual void search(SearchState *state, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {}
+};
+
+struct StepAllocatorFixture {
+	static const uint nDocuments = 3;
+	static const uint slice = 100;
+
+	Logger logger;
+	boost::scoped_ptr<DummySearch> search;
+	boost::scoped_ptr<StepAllocator> allocator;
+	NbestStorage nbest;
+
+	StepAllocatorFixture() : logger("StepAllocatorTest"), nbest(1) {
+		// a search section without parameters, so all defaults apply
+		boost::filesystem::path file = boost::filesystem::temp_directory_path() /
+			boost::filesystem::unique_path("docent-test-%%%%-%%%%-%%%%.xml");
+		std::ofstream(file.string().c_str()) << "<?xml version=\"1.0\" ?>\n<search/>\n";
+		ConfigurationFile config(file.string());
+		boost::filesystem::remove(file);
+
+		search.reset(new DummySearch(Parameters(logger, config.getXMLDocument().getDocumentElement())));
+		allocator.reset(new StepAllocator(*search, slice, search->getStepAllocationMinShare()));
+		for(uint i = 0; i < nDocuments; i++)
+			allocator->addDocument(NULL, nbest);
+	}
+};
+
+const uint StepAllocatorFixture::nDocuments;
+const uint StepAllocatorFixture::slice;
+
+BOOST_FIXTURE_TEST_SUITE(StepAllocatorTests, StepAllocatorFixture)
+
+BOOST_AUTO_TEST_CASE(unsearchedDocumentsFirst) {
+	for(uint i = 0; i < nDocuments; i++) {
+		BOOST_CHECK_EQUAL(allocator->pickDocument(), int(i));
+		allocator->registerSlice(i, slice, slice, Float(10 * (i + 1)));
+	}
+	for(uint i = 0; i < nDocuments; i++)
+		BOOST_CHECK_EQUAL(allocator->getStepsForDocument(i), slice);
+}
+
+BOOST_AUTO_TEST_CASE(highestGainPerStep) {
+	allocator->registerSlice(0, slice, slice, Float(10));
+	allocator->registerSlice(1, slice, slice, Float(50));
+	allocator->registerSlice(2, slice, slice, Float(20));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 1);
+
+	// the gain is counted per step actually taken, not per slice
+	allocator->registerSlice(1, slice, slice, Float(5));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 2);
+
+	allocator->registerSlice(2, slice, slice, Float(-1));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 0);
+}
+
+// Without any gains, the allocation is round-robin.
+BOOST_AUTO_TEST_CASE(tiesToFewestSteps) {
+	for(uint i = 0; i < nDocuments; i++)
+		allocator->registerSlice(i, slice, slice, Float(0));
+	allocator->registerSlice(0, slice, slice, Float(0));
+	allocator->registerSlice(2, slice, slice, Float(0));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 1);
+	allocator->registerSlice(1, slice, slice, Float(0));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(finishedDocumentsSkipped) {
+	allocator->registerSlice(0, slice, slice, Float(10));
+	allocator->registerSlice(1, slice, slice / 2, Float(100));
+	allocator->registerSlice(2, slice, slice, Float(1));
+	BOOST_CHECK_EQUAL(allocator->getStepsForDocument(1), slice / 2);
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 0);
+
+	// a slice in which no steps were taken finishes a document as well
+	allocator->registerSlice(0, slice, 0, Float(0));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), 2);
+	allocator->registerSlice(2, slice, slice - 1, Float(0));
+	BOOST_CHECK_EQUAL(allocator->pickDocument(), -1);
+}
+
+// A document with a high gain gets most of the steps, but the documents whose
+// last slices didn't improve are still searched now and then.
+BOOST_AUTO_TEST_CASE(noStarvation) {
+	Float minShare = search->getStepAllocationMinShare();
+	BOOST_REQUIRE_GT(minShare, Float(0));
+
+	unsigned long total = 0;
+	for(uint n = 0; n < 60; n++) {
+		int i = allocator->pickDocument();
+		BOOST_REQUIRE_NE(i, -1);
+		allocator->registerSlice(i, slice, slice, i == 0 ? Float(10) : Float(0));
+		total += slice;
+
+		// no document falls behind its minimum share by more than a slice
+		for(uint j = 0; j < nDocuments; j++)
+			BOOST_CHECK_GE(allocator->getStepsForDocument(j) + slice, minShare * total / nDocuments);
+	}
+
+	BOOST_CHECK_GT(allocator->getStepsForDocument(1), slice);
+	BOOST_CHECK_GT(allocator->getStepsForDocument(2), slice);
+	BOOST_CHECK_GT(allocator->getStepsForDocument(0),
+		allocator->getStepsForDocument(1) + allocator->getStepsForDocument(2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
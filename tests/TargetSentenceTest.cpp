@@ -0,0 +1,139 @@
+/*
+ *  TargetSentenceTest.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE TargetSentence
+#include <boost/test/included/unit_test.hpp>
+
+#include "Docent.h"
+#include "DocumentState.h"
+#include "SearchStep.h"
+#include "TargetSentence.h"
+#include "TestDocument.h"
+
+#include <iterator>
+
+#include <boost/scoped_ptr.hpp>
+
+struct TargetSentenceFixture {
+	TestDocument test;
+	TestOperation op;
+
+	// the segmentation of a sentence after the modifications of a step,
+	// built without any splicing
+	static PhraseSegmentation applyStep(const DocumentState &doc, const SearchStep &step, uint sentno) {
+		PhraseSegmentation out;
+		const PhraseSegmentation &sent = doc.getPhraseSegmentation(sentno);
+		const std::vector<SearchStep::Modification> &mods = step.getModifications();
+		PhraseSegmentation::const_iterator next = sent.begin();
+		for(uint i = 0; i < mods.size(); i++) {
+			if(mods[i].sentno != sentno)
+				continue;
+			out.insert(out.end(), next, mods[i].from_it);
+			out.insert(out.end(), mods[i].proposal.begin(), mods[i].proposal.end());
+			next = mods[i].to_it;
+		}
+		out.insert(out.end(), next, sent.end());
+		return out;
+	}
+
+	static void checkPhrases(const TargetSentence &sent, const PhraseSegmentation &seg) {
+		BOOST_REQUIRE_EQUAL(sent.getNumberOfPhrases(), seg.size());
+		uint pos = 0;
+		uint phrase = 0;
+		for(PhraseSegmentation::const_iterator it = seg.begin(); it != seg.end(); ++it, phrase++) {
+			const PhraseData &words = it->second.get().getTargetPhrase().get();
+			BOOST_CHECK_EQUAL(sent.getPhraseStart(phrase), pos);
+			BOOST_CHECK_EQUAL(sent.countWords(phrase, phrase + 1), words.size());
+			for(uint i = 0; i < words.size(); i++, pos++)
+				BOOST_CHECK_EQUAL(sent[pos], words[i]);
+		}
+		BOOST_CHECK_EQUAL(sent.size(), pos);
+		BOOST_CHECK_EQUAL(sent.getPhraseStart(phrase), pos);
+	}
+
+	template<class Sentence>
+	static void checkWords(const Sentence &sent, const TargetSentence &expected) {
+		BOOST_REQUIRE_EQUAL(sent.size(), expected.size());
+		for(uint i = 0; i < expected.size(); i++)
+			BOOST_CHECK_EQUAL(sent[i], expected[i]);
+	}
+
+	// Compares the step's version of the sentence, spliced in both ways, with
+	// one built from scratch, and then applies the step to the document.
+	void checkStep(SearchStep *step, uint sentno) {
+		DocumentState &doc = test.getDocument();
+		const TargetSentence &base = doc.getTargetSentence(sentno);
+		PhraseSegmentation expectedSeg = applyStep(doc, *step, sentno);
+		TargetSentence expected(expectedSeg);
+		checkPhrases(expected, expectedSeg);
+
+		TargetSentence spliced(base, *step, sentno);
+		checkPhrases(spliced, expectedSeg);
+		checkWords(SplicedTargetSentence(base, *step, sentno), expected);
+
+		doc.applyModifications(step);
+		checkPhrases(doc.getTargetSentence(sentno), expectedSeg);
+		BOOST_CHECK(doc.getPhraseSegmentation(sentno) == expectedSeg);
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(TargetSentenceTests, TargetSentenceFixture)
+
+BOOST_AUTO_TEST_CASE(initialState) {
+	const DocumentState &doc = test.getDocument();
+	for(uint i = 0; i < 2; i++)
+		checkPhrases(doc.getTargetSentence(i), doc.getPhraseSegmentation(i));
+}
+
+// Every word of the test phrase table has translations of one and two words,
+// so the replaced phrases change length and the positions after them move.
+BOOST_AUTO_TEST_CASE(firstAndLastPhrase) {
+	SearchStep *step = op.createSearchStep(test.getDocument());
+	op.changeTranslations(*step, 0, 2, 3);
+	op.changeTranslations(*step, 0, 0, 1);
+	checkStep(step, 0);
+}
+
+BOOST_AUTO_TEST_CASE(adjacentPhrases) {
+	SearchStep *step = op.createSearchStep(test.getDocument());
+	op.changeTranslations(*step, 0, 0, 2);
+	checkStep(step, 0);
+
+	step = op.createSearchStep(test.getDocument());
+	op.changeTranslations(*step, 0, 1, 2);
+	op.changeTranslations(*step, 0, 2, 3);
+	checkStep(step, 0);
+}
+
+BOOST_AUTO_TEST_CASE(otherSentences) {
+	DocumentState &doc = test.getDocument();
+	SearchStep *step = op.createSearchStep(doc);
+	op.changeTranslations(*step, 1, 1, 2);
+
+	const TargetSentence &base = doc.getTargetSentence(0);
+	checkWords(TargetSentence(base, *step, 0), base);
+	checkWords(SplicedTargetSentence(base, *step, 0), base);
+
+	checkStep(step, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
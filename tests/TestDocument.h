@@ -0,0 +1,214 @@
+/*
+ *  TestDocument.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_TestDocument_h
+#define docent_TestDocument_h
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "NistXmlTestset.h"
+#include "PhrasePairCollection.h"
+#include "SearchStep.h"
+#include "StateGenerator.h"
+
+#include "PhraseDictionaryTree.h" // from moses
+
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+// A document of two sentences, "a b c" and "b a", decoded with a phrase table
+// that has two translations of different lengths for every word. The phrase
+// table and the configuration are written to a temporary directory, which is
+// removed again by the destructor. Further models and their weights can be
+// added to the phrase table and the word penalty, further entries to the
+// phrase table, and the change-phrase-translation operation can be replaced.
+// Attributes can be given for the models element.
+class TestDocument {
+private:
+	boost::filesystem::path dir_;
+	boost::scoped_ptr<DecoderConfiguration> config_;
+	boost::scoped_ptr<NistXmlTestset> testset_;
+	boost::shared_ptr<DocumentState> doc_;
+
+	std::string writeFile(const std::string &name, const std::string &contents) const {
+		std::string file = (dir_ / name).string();
+		std::ofstream os(file.c_str());
+		os << contents;
+		return file;
+	}
+
+	void writePhraseTable(const std::string &extraPhrases) const {
+		// the binariser wants the entries sorted by source phrase
+		std::istringstream lines(
+			"a ||| p q ||| 0.2 0.2 0.2 0.2 2.718\n"
+			"a ||| x ||| 0.5 0.5 0.5 0.5 2.718\n"
+			"b ||| u ||| 0.5 0.5 0.5 0.5 2.718\n"
+			"b ||| v w ||| 0.2 0.2 0.2 0.2 2.718\n"
+			"c ||| s t ||| 0.2 0.2 0.2 0.2 2.718\n"
+			"c ||| z ||| 0.5 0.5 0.5 0.5 2.718\n"
+			+ extraPhrases);
+		std::set<std::string> entries;
+		for(std::string line; std::getline(lines, line); )
+			entries.insert(line);
+		std::ostringstream sorted;
+		std::copy(entries.begin(), entries.end(), std::ostream_iterator<std::string>(sorted, "\n"));
+		std::istringstream ptable(sorted.str());
+		Moses::PhraseDictionaryTree pdt(5);
+		pdt.Create(ptable, (dir_ / "phrase-table").string());
+	}
+
+public:
+	explicit TestDocument(const std::string &extraModels = "", const std::string &extraWeights = "",
+			const std::string &extraPhrases = "",
+			const std::string &operations = "\t<operation type=\"change-phrase-translation\" weight=\"1\"/>\n",
+			const std::string &modelsAttributes = "") {
+		dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("docent-test-%%%%-%%%%-%%%%");
+		boost::filesystem::create_directory(dir_);
+
+		writePhraseTable(extraPhrases);
+
+		std::string input = writeFile("input.xml",
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<mteval><srcset setid=\"test\" srclang=\"any\"><doc docid=\"test\">\n"
+			"<seg id=\"1\">a b c</seg>\n"
+			"<seg id=\"2\">b a</seg>\n"
+			"</doc></srcset></mteval>\n");
+
+		std::string config = writeFile("config.xml",
+			"<?xml version=\"1.0\" ?>\n"
+			"<docent>\n"
+			"<random>1</random>\n"
+			"<state-generator>\n"
+			"\t<initial-state type=\"monotonic\"/>\n"
+			+ operations +
+			"</state-generator>\n"
+			"<search algorithm=\"simulated-annealing\">\n"
+			"\t<p name=\"max-steps\">100</p>\n"
+			"\t<p name=\"schedule\">hill-climbing</p>\n"
+			"</search>\n"
+			"<models" + modelsAttributes + ">\n"
+			"\t<model type=\"phrase-table\" id=\"tm\">\n"
+			"\t\t<p name=\"file\">" + (dir_ / "phrase-table").string() + "</p>\n"
+			"\t</model>\n"
+			"\t<model type=\"word-penalty\" id=\"w\"/>\n"
+			+ extraModels +
+			"</models>\n"
+			"<weights>\n"
+			"\t<weight model=\"tm\" score=\"0\">0.1</weight>\n"
+			"\t<weight model=\"tm\" score=\"1\">0.1</weight>\n"
+			"\t<weight model=\"tm\" score=\"2\">0.1</weight>\n"
+			"\t<weight model=\"tm\" score=\"3\">0.1</weight>\n"
+			"\t<weight model=\"tm\" score=\"4\">0.1</weight>\n"
+			"\t<weight model=\"w\">-0.1</weight>\n"
+			+ extraWeights +
+			"</weights>\n"
+			"</docent>\n");
+
+		config_.reset(new DecoderConfiguration(ConfigurationFile(config)));
+		testset_.reset(new NistXmlTestset(input));
+		doc_.reset(new DocumentState(*config_, *testset_->begin(), 0));
+	}
+
+	~TestDocument() {
+		doc_.reset();
+		testset_.reset();
+		config_.reset();
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(dir_, ec);
+	}
+
+	DocumentState &getDocument() {
+		return *doc_;
+	}
+
+	const DecoderConfiguration &getConfiguration() const {
+		return *config_;
+	}
+};
+
+// Creates empty search steps, to which the tests add modifications of their
+// choice instead of random ones.
+class TestOperation : public StateOperation {
+public:
+	virtual std::string getDescription() const {
+		return "test";
+	}
+
+	virtual SearchStep *createSearchStep(const DocumentState &doc) const {
+		return new SearchStep(this, doc, getFeatureStates(doc));
+	}
+
+	// the other translation of the source words of a phrase pair
+	const AnchoredPhrasePair &getAlternative(const DocumentState &doc, uint sentno, const AnchoredPhrasePair &app) const {
+		std::vector<const AnchoredPhrasePair *> alternatives;
+		getPhraseTranslations(doc)[sentno]->getAlternativeTranslations(app, alternatives);
+		for(uint i = 0; i < alternatives.size(); i++)
+			if(!(*alternatives[i] == app))
+				return *alternatives[i];
+		return app;
+	}
+
+	const PhrasePairCollection &getPhrasePairCollection(const DocumentState &doc, uint sentno) const {
+		return *getPhraseTranslations(doc)[sentno];
+	}
+
+	// all translations of the source words of a phrase pair, itself included
+	void getAlternatives(const DocumentState &doc, uint sentno, const AnchoredPhrasePair &app,
+			std::vector<const AnchoredPhrasePair *> &alternatives) const {
+		getPhraseTranslations(doc)[sentno]->getAlternativeTranslations(app, alternatives);
+	}
+
+	// adds a modification replacing a phrase of a sentence with the given translation
+	void changeTranslation(SearchStep &step, uint sentno, uint phrase, const AnchoredPhrasePair &app) const {
+		const PhraseSegmentation &sent = step.getDocumentState().getPhraseSegmentation(sentno);
+		PhraseSegmentation::const_iterator from_it = sent.begin();
+		std::advance(from_it, phrase);
+		PhraseSegmentation::const_iterator to_it = from_it;
+		++to_it;
+		step.addModification(sentno, phrase, phrase + 1, from_it, to_it, PhraseSegmentation(1, app));
+	}
+
+	// adds a modification replacing phrases [from, to) of a sentence with
+	// their other translations
+	void changeTranslations(SearchStep &step, uint sentno, uint from, uint to) const {
+		const DocumentState &doc = step.getDocumentState();
+		const PhraseSegmentation &sent = doc.getPhraseSegmentation(sentno);
+		PhraseSegmentation::const_iterator from_it = sent.begin();
+		std::advance(from_it, from);
+		PhraseSegmentation::const_iterator to_it = from_it;
+		PhraseSegmentation proposal;
+		for(uint i = from; i < to; i++, ++to_it)
+			proposal.push_back(getAlternative(doc, sentno, *to_it));
+		step.addModification(sentno, from, to, from_it, to_it, proposal);
+	}
+};
+
+#endif